@@ -0,0 +1,91 @@
+// Writes a synthetic save.txt and loads it with loadFromFile, checking that every service and
+// account comes back and that the load time grows linearly with the number of lines.
+//
+//   legacy_load_stress [lines] [file]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "legacy_save.h"
+#include "secure_alloc.h"
+#include "vault.h"
+
+struct SyntheticSave {
+    size_t services = 0;
+    size_t accounts = 0;
+};
+
+// Accounts of a service are scattered across the file, and every 16th service has no accounts,
+// so both the dedup map and the service-only lines get exercised
+static SyntheticSave writeSyntheticSave(const std::string& filename, size_t lines) {
+    SyntheticSave save;
+    save.services = lines / 4 + 1;
+    std::vector<size_t> accountCounts(save.services, 0);
+    std::mt19937 rng(7);
+
+    std::ofstream out(filename, std::ios::binary);
+    for (size_t i = 0; i < lines; ++i) {
+        size_t service = i < save.services ? i : rng() % save.services;
+        if (service % 16 == 15) {
+            out << "service-" << service << ";;\n";
+            continue;
+        }
+        out << "service-" << service << ";user" << accountCounts[service] << "@example.com;pw" << rng() << "\n";
+        ++accountCounts[service];
+        ++save.accounts;
+    }
+    return save;
+}
+
+static double loadMs(const std::string& filename, Vault& vault) {
+    clearVault(vault);
+    auto start = std::chrono::steady_clock::now();
+    loadFromFile(vault, filename);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static size_t countAccounts(const Vault& vault) {
+    size_t accounts = 0;
+    for (size_t i = 0; i < vaultServiceCount(vault); ++i) {
+        accounts += vaultAccountCount(vault, i);
+    }
+    return accounts;
+}
+
+int main(int argc, char** argv) {
+    size_t lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    std::string filename = argc > 2 ? argv[2] : "legacy_load_stress.txt";
+
+    bool ok = true;
+    double previousMs = 0;
+    for (size_t size : { lines / 4, lines / 2, lines }) {
+        SyntheticSave save = writeSyntheticSave(filename, size);
+
+        Vault vault;
+        SecureAllocStats before = secureAllocStats();
+        double ms = loadMs(filename, vault);
+        SecureAllocStats after = secureAllocStats();
+
+        size_t services = vaultServiceCount(vault);
+        size_t accounts = countAccounts(vault);
+        std::cout << size << " lines: " << services << " services, " << accounts << " accounts in " << ms << " ms, "
+                  << after.allocations - before.allocations << " vault allocations";
+        if (previousMs > 0) std::cout << " (x" << ms / previousMs << " for x2 lines)";
+        std::cout << std::endl;
+        previousMs = ms;
+
+        if (services != save.services || accounts != save.accounts) {
+            std::cout << "  expected " << save.services << " services and " << save.accounts << " accounts" << std::endl;
+            ok = false;
+        }
+    }
+
+    std::remove(filename.c_str());
+    return ok ? 0 : 1;
+}
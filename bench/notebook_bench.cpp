@@ -0,0 +1,659 @@
+// Load, save, unlock, search, password transform, hit-testing and frame rendering costs, reported like Google Benchmark does so the
+// JSON can be tracked and compared across commits with the same tools.
+//
+//   notebook_bench [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>] [--benchmark_out=<file.json>]
+//
+// The hit-testing and frame cases need SDL and are only built along with the NoteBook target.
+// Frames go to an offscreen software renderer, so no window or GPU is involved
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "byte_map.h"
+#include "legacy_save.h"
+#include "password_transform.h"
+#include "sealed_vault.h"
+#include "search.h"
+#include "transform_recipes.h"
+#include "vault.h"
+#include "vault_file.h"
+#include "vault_store.h"
+
+#ifdef NOTEBOOK_BENCH_UI
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#include "label_cache.h"
+#include "text_atlas.h"
+#include "views.h"
+#include "virtual_list.h"
+#endif
+
+// Drives one benchmark: keepRunning() is true until the case has run for at least minTime
+class BenchState {
+public:
+    explicit BenchState(double minTime) : minTime(minTime) {}
+
+    bool keepRunning() {
+        auto now = std::chrono::steady_clock::now();
+        std::clock_t cpuNow = std::clock();
+        if (!started) {
+            started = true;
+            start = now;
+            cpuStart = cpuNow;
+            return true;
+        }
+        ++iterations;
+        if (realSeconds + std::chrono::duration<double>(now - start).count() >= minTime) {
+            stop(now, cpuNow);
+            return false;
+        }
+        return true;
+    }
+
+    // Excludes per-iteration setup from the measurement
+    void pauseTiming() {
+        stop(std::chrono::steady_clock::now(), std::clock());
+    }
+
+    void resumeTiming() {
+        start = std::chrono::steady_clock::now();
+        cpuStart = std::clock();
+    }
+
+    void setItemsProcessed(double items) { itemsProcessed = items; }
+    void setBytesProcessed(double bytes) { bytesProcessed = bytes; }
+
+    uint64_t iterations = 0;
+    double realSeconds = 0;
+    double cpuSeconds = 0;
+    double itemsProcessed = 0;
+    double bytesProcessed = 0;
+
+private:
+    void stop(std::chrono::steady_clock::time_point now, std::clock_t cpuNow) {
+        realSeconds += std::chrono::duration<double>(now - start).count();
+        cpuSeconds += static_cast<double>(cpuNow - cpuStart) / CLOCKS_PER_SEC;
+        start = now;
+        cpuStart = cpuNow;
+    }
+
+    double minTime;
+    bool started = false;
+    std::chrono::steady_clock::time_point start;
+    std::clock_t cpuStart = 0;
+};
+
+enum TimeUnit { UNIT_NS, UNIT_US, UNIT_MS };
+
+struct BenchCase {
+    std::string name;
+    TimeUnit unit;
+    std::function<void(BenchState&)> run;
+};
+
+struct BenchResult {
+    std::string name;
+    TimeUnit unit;
+    BenchState state;
+};
+
+static const char* unitName(TimeUnit unit) {
+    switch (unit) {
+    case UNIT_NS: return "ns";
+    case UNIT_US: return "us";
+    default: return "ms";
+    }
+}
+
+static double perIteration(double seconds, uint64_t iterations, TimeUnit unit) {
+    double scale = unit == UNIT_NS ? 1e9 : unit == UNIT_US ? 1e6 : 1e3;
+    return iterations ? seconds * scale / static_cast<double>(iterations) : 0;
+}
+
+// 1234567 -> "1.23457M/s", the way Google Benchmark prints its counters
+static std::string humanRate(double perSecond) {
+    const char* suffixes[] = { "", "k", "M", "G" };
+    int suffix = 0;
+    while (perSecond >= 1000 && suffix < 3) {
+        perSecond /= 1000;
+        ++suffix;
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.6g%s/s", perSecond, suffixes[suffix]);
+    return text;
+}
+
+// Keeps the compiler from dropping work whose result is otherwise unused
+static volatile size_t benchSink;
+
+static std::string tempPath(const char* name) {
+    return "notebook_bench_" + std::string(name);
+}
+
+static const char* VAULT_WORDS[] = { "Mail", "Bank", "Cloud", "Forum", "Shop", "Git", "Chat", "Game", "News", "Work" };
+
+// `entries` accounts spread over a quarter as many services, shaped like a real save.txt
+static void makeVault(Vault& vault, size_t entries) {
+    const char** words = VAULT_WORDS;
+    std::mt19937 rng(42);
+    size_t services = entries / 4 + 1;
+    clearVault(vault);
+    reserveVault(vault, services, entries, entries * 48);
+    for (size_t i = 0; i < services; ++i) {
+        vaultAddService(vault, std::string(words[rng() % 10]) + words[rng() % 10] + "-" + std::to_string(i));
+    }
+    for (size_t a = 0; a < entries; ++a) {
+        size_t service = a * services / entries;
+        vaultAddAccount(vault, service, "user" + std::to_string(rng() % 100000) + "@example.com",
+                        "pw" + std::to_string(rng()));
+    }
+}
+
+static size_t fileSize(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    return in ? static_cast<size_t>(in.tellg()) : 0;
+}
+
+static void benchSaveToFile(BenchState& state, size_t entries) {
+    Vault vault;
+    makeVault(vault, entries);
+    std::string filename = tempPath("save.txt");
+    while (state.keepRunning()) {
+        saveToFile(vault, filename);
+    }
+    state.setItemsProcessed(static_cast<double>(entries));
+    state.setBytesProcessed(static_cast<double>(fileSize(filename)));
+    std::remove(filename.c_str());
+}
+
+static void benchLoadFromFile(BenchState& state, size_t entries) {
+    Vault vault;
+    makeVault(vault, entries);
+    std::string filename = tempPath("load.txt");
+    saveToFile(vault, filename);
+    while (state.keepRunning()) {
+        state.pauseTiming();
+        clearVault(vault);
+        state.resumeTiming();
+        loadFromFile(vault, filename);
+    }
+    state.setItemsProcessed(static_cast<double>(entries));
+    state.setBytesProcessed(static_cast<double>(fileSize(filename)));
+    std::remove(filename.c_str());
+}
+
+static void benchWriteVault(BenchState& state, size_t entries) {
+    Vault vault;
+    makeVault(vault, entries);
+    std::string filename = tempPath("save.vault");
+    while (state.keepRunning()) {
+        writeVault(vault, filename, 0);
+    }
+    state.setItemsProcessed(static_cast<double>(entries));
+    state.setBytesProcessed(static_cast<double>(fileSize(filename)));
+    std::remove(filename.c_str());
+}
+
+static void benchLoadVault(BenchState& state, size_t entries) {
+    Vault vault;
+    makeVault(vault, entries);
+    std::string filename = tempPath("load.vault");
+    writeVault(vault, filename, 0);
+    uint64_t journalSeq = 0;
+    while (state.keepRunning()) {
+        state.pauseTiming();
+        clearVault(vault);
+        state.resumeTiming();
+        loadVault(vault, filename, journalSeq);
+    }
+    state.setItemsProcessed(static_cast<double>(entries));
+    state.setBytesProcessed(static_cast<double>(fileSize(filename)));
+    std::remove(filename.c_str());
+}
+
+// The store reports on std::cerr every time it opens and closes, which would drown the results
+struct QuietCerr {
+    std::streambuf* saved = std::cerr.rdbuf(nullptr);
+    ~QuietCerr() {
+        std::cerr.rdbuf(saved);
+        std::cerr.clear();
+    }
+};
+
+static const char BENCH_PASSPHRASE[] = "bench passphrase";
+// PBKDF2 costs the same at every vault size, so it is cut down to let what does depend on the size show
+const uint32_t BENCH_KDF_ITERATIONS = 1000;
+const size_t BENCH_FIRST_SCREEN_ROWS = 20;
+
+// A sealed vault in a directory of its own, since the store always uses the same file names
+static std::string makeSealedStore(size_t entries) {
+    std::string directory = tempPath("store");
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directory(directory);
+    Vault vault;
+    makeVault(vault, entries);
+    SealedKey key;
+    SealedVault sealed;
+    deriveSealedKey(key, BENCH_PASSPHRASE, BENCH_KDF_ITERATIONS);
+    createSealedVault(sealed, storePaths(directory).save, key, vault, 0);
+    closeSealedVault(sealed);
+    return directory;
+}
+
+// Passphrase to the rows of the first screen, which is all the app decrypts before drawing it
+static void benchUnlockVault(BenchState& state, size_t entries) {
+    std::string directory = makeSealedStore(entries);
+    QuietCerr quiet;
+    while (state.keepRunning()) {
+        VaultStore store;
+        openStore(store, BENCH_PASSPHRASE, directory);
+        for (size_t i = 0; i < BENCH_FIRST_SCREEN_ROWS && i < vaultServiceCount(store.vault); ++i) {
+            storeLoadService(store, i);
+        }
+        benchSink = vaultServiceLabel(store.vault, 0).size();
+        state.pauseTiming();
+        closeStore(store);
+        state.resumeTiming();
+    }
+    std::filesystem::remove_all(directory);
+}
+
+// Saving one edit, which seals the chunk it touched and a new directory, whatever the vault's size
+static void benchSaveEdit(BenchState& state, size_t entries) {
+    std::string directory = makeSealedStore(entries);
+    QuietCerr quiet;
+    while (state.keepRunning()) {
+        state.pauseTiming();
+        VaultStore store;
+        openStore(store, BENCH_PASSPHRASE, directory);
+        size_t service = vaultServiceCount(store.vault) / 2;
+        storeAddAccount(store, service, "bench@example.com", "bench password");
+        state.resumeTiming();
+        closeStore(store);
+    }
+    std::filesystem::remove_all(directory);
+}
+
+// One keystroke of the search box over `services` services with an account each, named like
+// makeVault's. The index is built once per size and shared by every query
+static void benchSearch(BenchState& state, const std::string& query, size_t services) {
+    static size_t indexedServices = 0;
+    static SearchIndex index;
+    if (indexedServices != services) {
+        Vault vault;
+        std::mt19937 rng(42);
+        reserveVault(vault, services, services, services * 48);
+        for (size_t i = 0; i < services; ++i) {
+            vaultAddService(vault, std::string(VAULT_WORDS[rng() % 10]) + VAULT_WORDS[rng() % 10] + "-" + std::to_string(i));
+            vaultAddAccount(vault, i, "user" + std::to_string(rng() % 100000) + "@example.com", "pw" + std::to_string(rng()));
+        }
+        buildSearchIndex(index, vault);
+        indexedServices = services;
+    }
+    std::vector<SearchResult> results;
+    while (state.keepRunning()) {
+        searchServices(index, query, results);
+        benchSink += results.size();
+    }
+    state.setItemsProcessed(1);
+}
+
+// A rule file of the size a user would write: a few subs and mixes (fused into one table), an insert and a rotation
+static const char BENCH_TRANSFORM_RULES[] =
+    "sub aeios 4310$\n"
+    "mix first key\n"
+    "insert 3 #!\n"
+    "sub !# ?%\n"
+    "mix second key\n"
+    "rotate 5\n";
+
+// What the Copy button does
+static void benchTransformPassword(BenchState& state) {
+    TransformProgram program;
+    std::string error;
+    compileTransform(program, BENCH_TRANSFORM_RULES, error);
+    SecureString out;
+    while (state.keepRunning()) {
+        transformPassword(program, "harioklGithub2024", out);
+        benchSink += out.size();
+    }
+    state.setItemsProcessed(1);
+}
+
+static void benchTransformBatch(BenchState& state, size_t entries) {
+    Vault vault;
+    makeVault(vault, entries);
+    std::vector<std::string_view> passwords;
+    for (size_t i = 0; i < vaultServiceCount(vault); ++i) {
+        for (size_t a = 0; a < vaultAccountCount(vault, i); ++a) {
+            passwords.push_back(vaultAccountPassword(vault, i, a));
+        }
+    }
+    TransformProgram program;
+    std::string error;
+    compileTransform(program, BENCH_TRANSFORM_RULES, error);
+    TransformBatch batch;
+    while (state.keepRunning()) {
+        transformPasswords(program, passwords.data(), passwords.size(), batch);
+        benchSink += batch.pool.size();
+    }
+    state.setItemsProcessed(static_cast<double>(passwords.size()));
+    state.setBytesProcessed(static_cast<double>(batch.pool.size()));
+}
+
+// A known recipe over every Account password, one password at a time like the Copy button does it,
+// either through the recipe's specialized code or with the same steps interpreted
+static void benchTransformRecipe(BenchState& state, const KnownRecipe& known, bool specialized, size_t entries) {
+    Vault vault;
+    makeVault(vault, entries);
+    std::vector<std::string_view> passwords;
+    for (size_t i = 0; i < vaultServiceCount(vault); ++i) {
+        for (size_t a = 0; a < vaultAccountCount(vault, i); ++a) {
+            passwords.push_back(vaultAccountPassword(vault, i, a));
+        }
+    }
+    TransformProgram program;
+    std::string error;
+    compileTransform(program, "recipe " + std::string(known.name), error);
+    if (!specialized) program.specialized = nullptr;
+    SecureString out;
+    while (state.keepRunning()) {
+        for (std::string_view password : passwords) {
+            transformPassword(program, password, out);
+            benchSink += out.size();
+        }
+    }
+    state.setItemsProcessed(static_cast<double>(passwords.size()));
+}
+
+// The table step of a bulk re-derivation: every stored password packed into one buffer and run
+// through a sub table with the given kernel. Reports passwords per second
+static void benchMapBytes(BenchState& state, ByteMapKernel kernel, size_t entries) {
+    if (!byteMapKernelSupported(kernel)) return;
+    Vault vault;
+    makeVault(vault, entries);
+    SecureString pool;
+    size_t passwords = 0;
+    for (size_t i = 0; i < vaultServiceCount(vault); ++i) {
+        for (size_t a = 0; a < vaultAccountCount(vault, i); ++a) {
+            pool += vaultAccountPassword(vault, i, a);
+            ++passwords;
+        }
+    }
+    TransformProgram program;
+    std::string error;
+    compileTransform(program, "sub aeios0123 4310$oizE\n", error);
+
+    ByteMapKernel previous = byteMapKernel();
+    setByteMapKernel(kernel);
+    while (state.keepRunning()) {
+        mapBytes(program.steps[0].tables.data(), &pool[0], pool.size());
+    }
+    setByteMapKernel(previous);
+    benchSink += static_cast<unsigned char>(pool[0]);
+    state.setItemsProcessed(static_cast<double>(passwords));
+    state.setBytesProcessed(static_cast<double>(pool.size()));
+}
+
+#ifdef NOTEBOOK_BENCH_UI
+
+// Every click position in the list band, scrolled all the way down a list of `rows` services
+static void benchHitTestRow(BenchState& state, size_t rows) {
+    VirtualList list = mainLayout().serviceList;
+    int scrollOffset = maxScrollOffset(list, rows);
+    size_t hits = 0;
+    int y = list.viewTop;
+    while (state.keepRunning()) {
+        hits += hitTestRow(list, rows, scrollOffset, list.x + 1, y);
+        y = y < list.viewBottom ? y + 1 : list.viewTop;
+    }
+    benchSink = hits;
+    state.setItemsProcessed(1);
+}
+
+// Offscreen renderer with the app's font and window size
+struct OffscreenView {
+    SDL_Surface* surface = nullptr;
+    SDL_Renderer* renderer = nullptr;
+    TTF_Font* font = nullptr;
+    GlyphAtlas atlas;
+    LabelCache labels;
+};
+
+static bool openOffscreenView(OffscreenView& view) {
+    view.surface = SDL_CreateRGBSurfaceWithFormat(0, WINDOW_WIDTH, WINDOW_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    view.renderer = view.surface ? SDL_CreateSoftwareRenderer(view.surface) : nullptr;
+    view.font = TTF_OpenFont(NOTEBOOK_FONT_PATH, 16);
+    if (!view.renderer || !view.font || !createGlyphAtlas(view.atlas, view.renderer, view.font)) {
+        std::cerr << "Offscreen renderer unavailable: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void closeOffscreenView(OffscreenView& view) {
+    clearLabelCache(view.labels);
+    destroyGlyphAtlas(view.atlas);
+    if (view.font) TTF_CloseFont(view.font);
+    if (view.renderer) SDL_DestroyRenderer(view.renderer);
+    if (view.surface) SDL_FreeSurface(view.surface);
+}
+
+// The main list scrolled deep into `services` services, moving one row per frame so labels
+// keep entering the cache the way they do while the user scrolls
+static void benchMainListFrame(BenchState& state, size_t services, bool scrolling) {
+    Vault vault;
+    makeVault(vault, services * 4);
+    OffscreenView view;
+    if (!openOffscreenView(view)) {
+        closeOffscreenView(view);
+        return;
+    }
+    MainLayout layout = mainLayout();
+    std::vector<SearchResult> noResults;
+    int stride = layout.serviceList.rowHeight + layout.serviceList.spacing;
+    int scrollOffset = maxScrollOffset(layout.serviceList, vaultServiceCount(vault)) / 2;
+    while (state.keepRunning()) {
+        drawMainFrame(view.renderer, view.atlas, view.labels, layout, vault, "", noResults, scrollOffset);
+        if (scrolling) scrollOffset += stride;
+    }
+    state.setItemsProcessed(1);
+    closeOffscreenView(view);
+}
+
+// The details popup of a service with `accounts` accounts, scrolled halfway down
+static void benchDetailsFrame(BenchState& state, size_t accounts) {
+    Vault vault;
+    vaultAddService(vault, "Mail");
+    for (size_t a = 0; a < accounts; ++a) {
+        vaultAddAccount(vault, 0, "user" + std::to_string(a) + "@example.com", "pw" + std::to_string(a * 7919));
+    }
+    OffscreenView view;
+    if (!openOffscreenView(view)) {
+        closeOffscreenView(view);
+        return;
+    }
+    DetailsLayout layout = detailsLayout();
+    int scrollOffset = maxScrollOffset(layout.accountList, accounts) / 2;
+    while (state.keepRunning()) {
+        drawDetailsFrame(view.renderer, view.atlas, view.labels, layout, vault, 0, scrollOffset, -1);
+    }
+    state.setItemsProcessed(1);
+    closeOffscreenView(view);
+}
+
+#endif
+
+static std::vector<BenchCase> registerCases() {
+    std::vector<BenchCase> cases;
+    for (size_t entries : { 1000, 100000, 1000000 }) {
+        std::string size = "/" + std::to_string(entries);
+        cases.push_back({ "BM_SaveToFile" + size, UNIT_MS, [=](BenchState& s) { benchSaveToFile(s, entries); } });
+        cases.push_back({ "BM_LoadFromFile" + size, UNIT_MS, [=](BenchState& s) { benchLoadFromFile(s, entries); } });
+        cases.push_back({ "BM_WriteVault" + size, UNIT_MS, [=](BenchState& s) { benchWriteVault(s, entries); } });
+        cases.push_back({ "BM_LoadVault" + size, UNIT_MS, [=](BenchState& s) { benchLoadVault(s, entries); } });
+        cases.push_back({ "BM_UnlockVault" + size, UNIT_MS, [=](BenchState& s) { benchUnlockVault(s, entries); } });
+        cases.push_back({ "BM_SaveEdit" + size, UNIT_MS, [=](BenchState& s) { benchSaveEdit(s, entries); } });
+    }
+    // Each prefix of a service name as it is typed, then a transposed one
+    for (const char* query : { "m", "ma", "mai", "mail", "mailbank", "mial", "qz" }) {
+        cases.push_back({ std::string("BM_Search/") + query + "/1000000", UNIT_US,
+                          [=](BenchState& s) { benchSearch(s, query, 1000000); } });
+    }
+    cases.push_back({ "BM_TransformPassword", UNIT_NS, [](BenchState& s) { benchTransformPassword(s); } });
+    for (size_t entries : { 1000, 100000 }) {
+        cases.push_back({ "BM_TransformBatch/" + std::to_string(entries), UNIT_US,
+                          [=](BenchState& s) { benchTransformBatch(s, entries); } });
+    }
+    for (size_t i = 0; i < knownRecipeCount(); ++i) {
+        const KnownRecipe& known = knownRecipe(i);
+        for (bool specialized : { true, false }) {
+            cases.push_back({ std::string("BM_TransformRecipe/") + known.name + (specialized ? "/specialized" : "/generic") + "/100000",
+                              UNIT_US, [=, &known](BenchState& s) { benchTransformRecipe(s, known, specialized, 100000); } });
+        }
+    }
+    // Kernels the CPU lacks run no iterations and are left out of the results
+    for (ByteMapKernel kernel : { ByteMapKernel::Scalar, ByteMapKernel::Ssse3, ByteMapKernel::Avx2, ByteMapKernel::Avx512Vbmi }) {
+        cases.push_back({ std::string("BM_MapBytes/") + byteMapKernelName(kernel) + "/1000000", UNIT_US,
+                          [=](BenchState& s) { benchMapBytes(s, kernel, 1000000); } });
+    }
+#ifdef NOTEBOOK_BENCH_UI
+    for (size_t rows : { 1000, 1000000 }) {
+        std::string size = "/" + std::to_string(rows);
+        cases.push_back({ "BM_HitTestRow" + size, UNIT_NS, [=](BenchState& s) { benchHitTestRow(s, rows); } });
+        cases.push_back({ "BM_MainListFrame" + size, UNIT_US, [=](BenchState& s) { benchMainListFrame(s, rows, false); } });
+        cases.push_back({ "BM_MainListScroll" + size, UNIT_US, [=](BenchState& s) { benchMainListFrame(s, rows, true); } });
+    }
+    cases.push_back({ "BM_DetailsFrame/1000", UNIT_US, [](BenchState& s) { benchDetailsFrame(s, 1000); } });
+#endif
+    return cases;
+}
+
+static std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Same layout as Google Benchmark's --benchmark_out, so its compare.py can diff two runs
+static void writeJson(std::ostream& out, const char* executable, const std::vector<BenchResult>& results) {
+    char date[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+#ifdef NDEBUG
+    const char* buildType = "release";
+#else
+    const char* buildType = "debug";
+#endif
+
+    out << std::setprecision(10);
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": " << jsonString(date) << ",\n"
+        << "    \"executable\": " << jsonString(executable) << ",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"library_build_type\": " << jsonString(buildType) << "\n"
+        << "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        const BenchState& state = result.state;
+        out << (i ? ",\n" : "\n") << "    {\n"
+            << "      \"name\": " << jsonString(result.name) << ",\n"
+            << "      \"run_name\": " << jsonString(result.name) << ",\n"
+            << "      \"run_type\": \"iteration\",\n"
+            << "      \"iterations\": " << state.iterations << ",\n"
+            << "      \"real_time\": " << perIteration(state.realSeconds, state.iterations, result.unit) << ",\n"
+            << "      \"cpu_time\": " << perIteration(state.cpuSeconds, state.iterations, result.unit) << ",\n"
+            << "      \"time_unit\": " << jsonString(unitName(result.unit));
+        if (state.realSeconds > 0 && state.bytesProcessed > 0) {
+            out << ",\n      \"bytes_per_second\": " << state.bytesProcessed * state.iterations / state.realSeconds;
+        }
+        if (state.realSeconds > 0 && state.itemsProcessed > 0) {
+            out << ",\n      \"items_per_second\": " << state.itemsProcessed * state.iterations / state.realSeconds;
+        }
+        out << "\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+static bool flagValue(const std::string& arg, const char* flag, std::string& value) {
+    std::string prefix = std::string(flag) + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string filter = ".";
+    std::string outPath;
+    double minTime = 0.5;
+    for (int i = 1; i < argc; ++i) {
+        std::string value;
+        if (flagValue(argv[i], "--benchmark_filter", value)) filter = value;
+        else if (flagValue(argv[i], "--benchmark_out", value)) outPath = value;
+        else if (flagValue(argv[i], "--benchmark_min_time", value)) minTime = std::atof(value.c_str());
+        else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+#ifdef NOTEBOOK_BENCH_UI
+    if (TTF_Init() != 0) {
+        std::cerr << "TTF_Init failed: " << TTF_GetError() << std::endl;
+        return 1;
+    }
+#endif
+
+    std::regex pattern(filter);
+    std::vector<BenchResult> results;
+    std::cout << std::left << std::setw(32) << "Benchmark" << std::right << std::setw(16) << "Time"
+              << std::setw(16) << "CPU" << std::setw(12) << "Iterations" << "\n"
+              << std::string(76, '-') << std::endl;
+    for (const BenchCase& benchCase : registerCases()) {
+        if (!std::regex_search(benchCase.name, pattern)) continue;
+        BenchState state(minTime);
+        benchCase.run(state);
+        if (state.iterations == 0) continue;
+
+        const char* unit = unitName(benchCase.unit);
+        std::cout << std::left << std::setw(32) << benchCase.name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(13) << perIteration(state.realSeconds, state.iterations, benchCase.unit) << " " << unit
+                  << std::setw(13) << perIteration(state.cpuSeconds, state.iterations, benchCase.unit) << " " << unit
+                  << std::setw(12) << state.iterations;
+        if (state.realSeconds > 0 && state.itemsProcessed > 0) {
+            std::cout << " items_per_second=" << humanRate(state.itemsProcessed * state.iterations / state.realSeconds);
+        }
+        std::cout << std::endl;
+        results.push_back({ benchCase.name, benchCase.unit, state });
+    }
+
+#ifdef NOTEBOOK_BENCH_UI
+    TTF_Quit();
+#endif
+
+    if (!outPath.empty()) {
+        std::ofstream out(outPath);
+        if (!out) {
+            std::cerr << "Failed to open " << outPath << std::endl;
+            return 1;
+        }
+        writeJson(out, argv[0], results);
+    }
+    return 0;
+}
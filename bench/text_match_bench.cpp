@@ -0,0 +1,133 @@
+// Compares findText over one contiguous block of labels against the obvious loop that lowercases
+// and std::string::find's every label and account name stored as a std::string of its own.
+//
+//   text_match_bench [services] [repeats]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "text_match.h"
+
+// The row-per-service model the vault used to have, one heap string per field
+struct NaiveAccount {
+    std::string accountName;
+    std::string password;
+};
+
+struct NaiveService {
+    std::string label;
+    std::vector<NaiveAccount> accounts;
+};
+
+static std::vector<NaiveService> makeServices(size_t count) {
+    static const char* words[] = { "Mail", "Bank", "Cloud", "Forum", "Shop", "Git", "Chat", "Game", "News", "Work" };
+    std::mt19937 rng(42);
+    std::vector<NaiveService> services;
+    services.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        NaiveService service;
+        service.label = std::string(words[rng() % 10]) + words[rng() % 10] + "-" + std::to_string(i);
+        size_t accounts = 1 + rng() % 3;
+        for (size_t a = 0; a < accounts; ++a) {
+            service.accounts.push_back({ "user" + std::to_string(rng() % 100000) + "@example.com", "secret" });
+        }
+        services.push_back(std::move(service));
+    }
+    return services;
+}
+
+// One field per line, the layout the search index keeps its text in
+static std::string packFields(const std::vector<NaiveService>& services) {
+    std::string text;
+    for (const NaiveService& service : services) {
+        text += service.label;
+        text += '\n';
+        for (const NaiveAccount& account : service.accounts) {
+            text += account.accountName;
+            text += '\n';
+        }
+    }
+    return text;
+}
+
+static std::string lowered(std::string_view text) {
+    std::string out(text);
+    for (char& c : out) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    return out;
+}
+
+static size_t naiveCount(const std::vector<NaiveService>& services, std::string_view query) {
+    std::string needle = lowered(query);
+    size_t fields = 0;
+    for (const NaiveService& service : services) {
+        if (lowered(service.label).find(needle) != std::string::npos) ++fields;
+        for (const NaiveAccount& account : service.accounts) {
+            if (lowered(account.accountName).find(needle) != std::string::npos) ++fields;
+        }
+    }
+    return fields;
+}
+
+// Counts matching fields, skipping to the next line after each hit
+template <typename Find>
+static size_t packedCount(std::string_view text, std::string_view query, Find find) {
+    size_t fields = 0;
+    size_t pos = find(text, query, 0);
+    while (pos != std::string_view::npos) {
+        ++fields;
+        size_t lineEnd = text.find('\n', pos);
+        if (lineEnd == std::string_view::npos) break;
+        pos = find(text, query, lineEnd + 1);
+    }
+    return fields;
+}
+
+template <typename Run>
+static double bestMs(int repeats, size_t& result, Run run) {
+    double best = 1e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        result = run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    std::vector<NaiveService> services = makeServices(count);
+    std::string text = packFields(services);
+    double megabytes = static_cast<double>(text.size()) / (1024.0 * 1024.0);
+
+    std::cout << count << " services, " << megabytes << " MB of labels, kernel " << textMatchKernel() << std::endl;
+
+    bool agree = true;
+    for (const char* query : { "g", "ma", "BANK", "cloudgit", "@example.com", "-99999", "nomatch" }) {
+        size_t naiveHits = 0, scalarHits = 0, simdHits = 0;
+        double naive = bestMs(repeats, naiveHits, [&] { return naiveCount(services, query); });
+        double scalar = bestMs(repeats, scalarHits, [&] { return packedCount(text, query, findTextScalar); });
+        double simd = bestMs(repeats, simdHits, [&] { return packedCount(text, query, findText); });
+
+        std::cout << "\"" << query << "\": " << simdHits << " fields"
+                  << "  naive " << naive << " ms"
+                  << "  scalar " << scalar << " ms"
+                  << "  " << textMatchKernel() << " " << simd << " ms (" << megabytes / (simd / 1000.0) << " MB/s)"
+                  << std::endl;
+        if (naiveHits != scalarHits || naiveHits != simdHits) {
+            std::cout << "  mismatch: naive " << naiveHits << ", scalar " << scalarHits << std::endl;
+            agree = false;
+        }
+    }
+    return agree ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+// Writes a synthetic vault as save.txt and/or a binary vault. The same flags and seed give
+// byte-identical files on every platform, so a slow case found on one machine can be rebuilt on
+// another from its command line alone.
+//
+//   vault_gen [--services=N] [--accounts=DIST] [--label_length=DIST] [--name_length=DIST]
+//             [--password_length=DIST] [--seed=N] [--save_txt=FILE] [--vault=FILE]
+//             [--passphrase=TEXT] [--kdf_iterations=N]
+//
+// DIST is N, MIN-MAX for a uniform pick, or MIN-MAX:short to favour the low end the way real
+// labels and account counts do. To replay a session against a generated vault:
+//
+//   vault_gen --services=100000 --vault=big/save.vault --passphrase=bench
+//   NOTEBOOK_DIR=big NOTEBOOK_PASSPHRASE=bench NOTEBOOK_REPLAY=scroll.log SDL_VIDEODRIVER=dummy NoteBook
+//
+// With --passphrase the vault is written sealed, see sealed_vault.h. Its salt and nonces are random,
+// so only the plaintext formats are byte-identical between runs; the vault inside is the same.
+// Without it the plaintext binary vault is written, which NoteBook encrypts on first open
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "legacy_save.h"
+#include "sealed_vault.h"
+#include "vault.h"
+#include "vault_file.h"
+
+// splitmix64: unlike the <random> distributions its output is pinned down exactly, so the
+// generated vault doesn't depend on the standard library it was built with
+struct GenRng {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [low, high]
+    size_t range(size_t low, size_t high) {
+        return low + static_cast<size_t>(next() % (high - low + 1));
+    }
+};
+
+struct Distribution {
+    size_t low = 0;
+    size_t high = 0;
+    bool shortBiased = false;
+};
+
+static bool parseDistribution(const std::string& text, Distribution& dist) {
+    std::string range = text;
+    dist.shortBiased = false;
+    size_t colon = range.find(':');
+    if (colon != std::string::npos) {
+        if (range.substr(colon + 1) != "short") return false;
+        dist.shortBiased = true;
+        range.resize(colon);
+    }
+
+    char* end = nullptr;
+    dist.low = std::strtoul(range.c_str(), &end, 10);
+    if (end == range.c_str()) return false;
+    dist.high = dist.low;
+    if (*end == '-') {
+        const char* highStart = end + 1;
+        dist.high = std::strtoul(highStart, &end, 10);
+        if (end == highStart) return false;
+    }
+    return *end == '\0' && dist.low <= dist.high;
+}
+
+static size_t sample(GenRng& rng, const Distribution& dist) {
+    if (!dist.shortBiased) return rng.range(dist.low, dist.high);
+    // The smaller of two picks: half of the values land in the lowest ~30% of the range
+    size_t a = rng.range(dist.low, dist.high);
+    size_t b = rng.range(dist.low, dist.high);
+    return a < b ? a : b;
+}
+
+// No ';' or newlines, save.txt has no way to escape them
+static const char LABEL_CHARS[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 .-";
+static const char NAME_CHARS[] = "abcdefghijklmnopqrstuvwxyz0123456789._@";
+static const char PASSWORD_CHARS[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789!#$%&()*+-=?@[]^_{}~";
+
+static void randomText(GenRng& rng, std::string& out, size_t length, std::string_view chars) {
+    out.clear();
+    for (size_t i = 0; i < length; ++i) {
+        out += chars[rng.next() % chars.size()];
+    }
+}
+
+struct GenOptions {
+    size_t services = 10000;
+    Distribution accounts{ 0, 8, true };
+    Distribution labelLength{ 4, 24, true };
+    Distribution nameLength{ 6, 24, false };
+    Distribution passwordLength{ 8, 32, false };
+    uint64_t seed = 1;
+    std::string saveTxt;
+    std::string vault;
+};
+
+// FNV-1a over everything generated, printed so two machines can confirm they built the same vault
+static uint64_t fingerprint(uint64_t hash, std::string_view text) {
+    for (char c : text) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    }
+    return (hash ^ 0xFF) * 0x100000001B3ull;
+}
+
+static uint64_t generateVault(Vault& vault, const GenOptions& options) {
+    GenRng rng{ options.seed };
+    uint64_t hash = 0xCBF29CE484222325ull;
+    clearVault(vault);
+
+    // loadFromFile merges services with the same label, so labels must be unique for save.txt to
+    // round-trip. A label that keeps colliding (short lengths, many services) gets its index appended
+    std::unordered_set<std::string> seen;
+    seen.reserve(options.services);
+    std::string label;
+    std::string name;
+    std::string password;
+    for (size_t service = 0; service < options.services; ++service) {
+        size_t length = std::max<size_t>(sample(rng, options.labelLength), 1);
+        randomText(rng, label, length, LABEL_CHARS);
+        for (int attempt = 0; attempt < 8 && seen.count(label); ++attempt) {
+            randomText(rng, label, length, LABEL_CHARS);
+        }
+        if (seen.count(label)) {
+            label += "#" + std::to_string(service);
+        }
+        seen.insert(label);
+        vaultAddService(vault, label);
+        hash = fingerprint(hash, label);
+
+        size_t accounts = sample(rng, options.accounts);
+        for (size_t account = 0; account < accounts; ++account) {
+            randomText(rng, name, std::max<size_t>(sample(rng, options.nameLength), 1), NAME_CHARS);
+            randomText(rng, password, std::max<size_t>(sample(rng, options.passwordLength), 1), PASSWORD_CHARS);
+            vaultAddAccount(vault, service, name, password);
+            hash = fingerprint(fingerprint(hash, name), password);
+        }
+    }
+    return hash;
+}
+
+static bool flagValue(const std::string& arg, const char* flag, std::string& value) {
+    std::string prefix = std::string(flag) + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    GenOptions options;
+    std::string passphrase;
+    bool sealed = false;
+    uint32_t kdfIterations = SEALED_KDF_ITERATIONS;
+    for (int i = 1; i < argc; ++i) {
+        std::string value;
+        bool ok = true;
+        if (flagValue(argv[i], "--services", value)) options.services = std::strtoul(value.c_str(), nullptr, 10);
+        else if (flagValue(argv[i], "--accounts", value)) ok = parseDistribution(value, options.accounts);
+        else if (flagValue(argv[i], "--label_length", value)) ok = parseDistribution(value, options.labelLength);
+        else if (flagValue(argv[i], "--name_length", value)) ok = parseDistribution(value, options.nameLength);
+        else if (flagValue(argv[i], "--password_length", value)) ok = parseDistribution(value, options.passwordLength);
+        else if (flagValue(argv[i], "--seed", value)) options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        else if (flagValue(argv[i], "--save_txt", value)) options.saveTxt = value;
+        else if (flagValue(argv[i], "--vault", value)) options.vault = value;
+        else if (flagValue(argv[i], "--passphrase", value)) { passphrase = value; sealed = true; }
+        else if (flagValue(argv[i], "--kdf_iterations", value)) kdfIterations = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+        else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            return 1;
+        }
+        if (!ok) {
+            std::cerr << "Bad distribution in " << argv[i] << ", expected N, MIN-MAX or MIN-MAX:short" << std::endl;
+            return 1;
+        }
+    }
+    if (options.saveTxt.empty() && options.vault.empty()) {
+        std::cerr << "Nothing to write, pass --save_txt=FILE and/or --vault=FILE" << std::endl;
+        return 1;
+    }
+
+    Vault vault;
+    uint64_t hash = generateVault(vault, options);
+
+    size_t accounts = 0;
+    for (size_t i = 0; i < vaultServiceCount(vault); ++i) {
+        accounts += vaultAccountCount(vault, i);
+    }
+    std::printf("%zu services, %zu accounts, %zu pool bytes, fingerprint %016llx\n", vaultServiceCount(vault),
+                accounts, vault.pool.size(), static_cast<unsigned long long>(hash));
+
+    if (!options.saveTxt.empty()) {
+        saveToFile(vault, options.saveTxt);
+    }
+    if (!options.vault.empty() && sealed) {
+        SealedKey key;
+        SealedVault written;
+        if (kdfIterations == 0 || !deriveSealedKey(key, passphrase, kdfIterations) ||
+            !createSealedVault(written, options.vault, key, vault, 0)) {
+            std::cerr << "Failed to write " << options.vault << std::endl;
+            return 1;
+        }
+        std::printf("%zu chunks sealed\n", written.chunks.size());
+        closeSealedVault(written);
+    } else if (!options.vault.empty() && !writeVault(vault, options.vault, 0)) {
+        std::cerr << "Failed to write " << options.vault << std::endl;
+        return 1;
+    }
+    return 0;
+}
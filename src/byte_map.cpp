@@ -0,0 +1,215 @@
+#include "byte_map.h"
+
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BYTE_MAP_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC compiles intrinsics for any instruction set without flags, GCC and Clang need the
+// functions using them marked with the target
+#if defined(BYTE_MAP_X86) && !defined(_MSC_VER)
+#define BYTE_MAP_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BYTE_MAP_TARGET(isa)
+#endif
+
+static void mapBytesScalar(const uint8_t* table, char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        data[i] = static_cast<char>(table[static_cast<uint8_t>(data[i])]);
+    }
+}
+
+#ifdef BYTE_MAP_X86
+
+// Rows (bytes with the same high nibble) the table doesn't leave as they are
+static int changedRows(const uint8_t* table, uint8_t rows[16]) {
+    int count = 0;
+    for (int row = 0; row < 16; ++row) {
+        for (int i = 0; i < 16; ++i) {
+            if (table[row * 16 + i] != row * 16 + i) {
+                rows[count++] = static_cast<uint8_t>(row);
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+BYTE_MAP_TARGET("ssse3")
+static void mapBytesSsse3(const uint8_t* table, char* data, size_t length) {
+    uint8_t rows[16];
+    int rowCount = changedRows(table, rows);
+    __m128i lookups[16];
+    __m128i rowIds[16];
+    for (int r = 0; r < rowCount; ++r) {
+        lookups[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table + rows[r] * 16));
+        rowIds[r] = _mm_set1_epi8(static_cast<char>(rows[r]));
+    }
+
+    const __m128i lowNibble = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i low = _mm_and_si128(bytes, lowNibble);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), lowNibble);
+        __m128i result = bytes;
+        for (int r = 0; r < rowCount; ++r) {
+            __m128i inRow = _mm_cmpeq_epi8(high, rowIds[r]);
+            __m128i mapped = _mm_shuffle_epi8(lookups[r], low);
+            result = _mm_or_si128(_mm_andnot_si128(inRow, result), _mm_and_si128(inRow, mapped));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), result);
+    }
+    mapBytesScalar(table, data + i, length - i);
+}
+
+BYTE_MAP_TARGET("avx2")
+static void mapBytesAvx2(const uint8_t* table, char* data, size_t length) {
+    uint8_t rows[16];
+    int rowCount = changedRows(table, rows);
+    // vpshufb looks up within each 128-bit half, so both halves get a copy of the row
+    __m256i lookups[16];
+    __m256i rowIds[16];
+    for (int r = 0; r < rowCount; ++r) {
+        lookups[r] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table + rows[r] * 16)));
+        rowIds[r] = _mm256_set1_epi8(static_cast<char>(rows[r]));
+    }
+
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i low = _mm256_and_si256(bytes, lowNibble);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), lowNibble);
+        __m256i result = bytes;
+        for (int r = 0; r < rowCount; ++r) {
+            __m256i inRow = _mm256_cmpeq_epi8(high, rowIds[r]);
+            result = _mm256_blendv_epi8(result, _mm256_shuffle_epi8(lookups[r], low), inRow);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), result);
+    }
+    mapBytesScalar(table, data + i, length - i);
+}
+
+// vpermi2b indexes 128 bytes with the low 7 bits, bit 7 picks which half of the table to use.
+// Masked loads and stores take the tail, so there is no scalar remainder
+BYTE_MAP_TARGET("avx512f,avx512bw,avx512vbmi")
+static void mapBytesAvx512Vbmi(const uint8_t* table, char* data, size_t length) {
+    const __m512i table0 = _mm512_loadu_si512(table);
+    const __m512i table1 = _mm512_loadu_si512(table + 64);
+    const __m512i table2 = _mm512_loadu_si512(table + 128);
+    const __m512i table3 = _mm512_loadu_si512(table + 192);
+
+    for (size_t i = 0; i < length; i += 64) {
+        size_t remaining = length - i;
+        __mmask64 lanes = remaining >= 64 ? ~__mmask64(0) : (__mmask64(1) << remaining) - 1;
+        __m512i bytes = _mm512_maskz_loadu_epi8(lanes, data + i);
+        __m512i lowHalf = _mm512_permutex2var_epi8(table0, bytes, table1);
+        __m512i highHalf = _mm512_permutex2var_epi8(table2, bytes, table3);
+        __m512i result = _mm512_mask_blend_epi8(_mm512_movepi8_mask(bytes), lowHalf, highHalf);
+        _mm512_mask_storeu_epi8(data + i, lanes, result);
+    }
+}
+
+#if defined(_MSC_VER)
+// cpuid says what the CPU has, xgetbv whether the OS saves the wider registers on a context switch
+static bool cpuSupports(ByteMapKernel kernel) {
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    bool osAvx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    bool osAvx512 = osAvx && (_xgetbv(0) & 0xE6) == 0xE6;
+    if (kernel == ByteMapKernel::Ssse3) return ssse3;
+    if (maxLeaf < 7) return false;
+    __cpuidex(info, 7, 0);
+    if (kernel == ByteMapKernel::Avx2) return osAvx && (info[1] & (1 << 5)) != 0;
+    bool avx512bw = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0;
+    bool vbmi = (info[2] & (1 << 1)) != 0;
+    return osAvx512 && avx512bw && vbmi;
+}
+#else
+static bool cpuSupports(ByteMapKernel kernel) {
+    __builtin_cpu_init();
+    switch (kernel) {
+    case ByteMapKernel::Ssse3: return __builtin_cpu_supports("ssse3");
+    case ByteMapKernel::Avx2: return __builtin_cpu_supports("avx2");
+    case ByteMapKernel::Avx512Vbmi:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+               __builtin_cpu_supports("avx512vbmi");
+    default: return true;
+    }
+}
+#endif
+
+#endif
+
+bool byteMapKernelSupported(ByteMapKernel kernel) {
+    if (kernel == ByteMapKernel::Scalar) return true;
+#ifdef BYTE_MAP_X86
+    return cpuSupports(kernel);
+#else
+    return false;
+#endif
+}
+
+static ByteMapKernel bestKernel() {
+    for (ByteMapKernel kernel : { ByteMapKernel::Avx512Vbmi, ByteMapKernel::Avx2, ByteMapKernel::Ssse3 }) {
+        if (byteMapKernelSupported(kernel)) return kernel;
+    }
+    return ByteMapKernel::Scalar;
+}
+
+static ByteMapKernel& selectedKernel() {
+    static ByteMapKernel kernel = bestKernel();
+    return kernel;
+}
+
+ByteMapKernel byteMapKernel() {
+    return selectedKernel();
+}
+
+void setByteMapKernel(ByteMapKernel kernel) {
+    selectedKernel() = kernel;
+}
+
+const char* byteMapKernelName(ByteMapKernel kernel) {
+    switch (kernel) {
+    case ByteMapKernel::Ssse3: return "ssse3";
+    case ByteMapKernel::Avx2: return "avx2";
+    case ByteMapKernel::Avx512Vbmi: return "avx512vbmi";
+    default: return "scalar";
+    }
+}
+
+void mapBytes(const uint8_t* table, char* data, size_t length) {
+#ifdef BYTE_MAP_X86
+    switch (selectedKernel()) {
+    case ByteMapKernel::Avx512Vbmi:
+        mapBytesAvx512Vbmi(table, data, length);
+        return;
+    case ByteMapKernel::Avx2:
+        // Setting up the rows costs more than a short password saves
+        if (length >= 32) {
+            mapBytesAvx2(table, data, length);
+            return;
+        }
+        break;
+    case ByteMapKernel::Ssse3:
+        if (length >= 16) {
+            mapBytesSsse3(table, data, length);
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+#endif
+    mapBytesScalar(table, data, length);
+}
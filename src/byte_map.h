@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Runs a buffer through a 256-entry byte table in place, data[i] = table[data[i]]. This is the
+// inner loop of the password transform's table steps, so it uses the widest byte shuffle the CPU
+// has, picked once at startup:
+//   Avx512Vbmi  vpermi2b, 64 bytes per two lookups into the whole table
+//   Avx2        vpshufb on the table's 16-byte rows, 32 bytes at a time
+//   Ssse3       pshufb the same way, 16 bytes at a time
+//   Scalar      one load per byte, for everything else and for the tails
+// The row-by-row kernels skip rows the table leaves unchanged, so a sub touching a few letters
+// costs a few shuffles per vector rather than sixteen
+
+enum class ByteMapKernel {
+    Scalar,
+    Ssse3,
+    Avx2,
+    Avx512Vbmi
+};
+
+void mapBytes(const uint8_t* table, char* data, size_t length);
+
+ByteMapKernel byteMapKernel();
+bool byteMapKernelSupported(ByteMapKernel kernel);
+// Forces a kernel, for benchmarks and for checking the kernels against each other. It must be supported
+void setByteMapKernel(ByteMapKernel kernel);
+const char* byteMapKernelName(ByteMapKernel kernel);
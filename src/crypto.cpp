@@ -0,0 +1,457 @@
+#include "crypto.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <bcrypt.h>
+#endif
+
+static uint32_t load32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void store32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+    p[2] = static_cast<uint8_t>(v >> 16);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+static void store64(uint8_t* p, uint64_t v) {
+    store32(p, static_cast<uint32_t>(v));
+    store32(p + 4, static_cast<uint32_t>(v >> 32));
+}
+
+static uint32_t rotl32(uint32_t v, int n) {
+    return (v << n) | (v >> (32 - n));
+}
+
+// ---- ChaCha20 ----
+
+// On sixteen named locals rather than an array, so every word stays in a register
+#define CHACHA_QUARTER(a, b, c, d)                  \
+    a += b; d = rotl32(d ^ a, 16);                  \
+    c += d; b = rotl32(b ^ c, 12);                  \
+    a += b; d = rotl32(d ^ a, 8);                   \
+    c += d; b = rotl32(b ^ c, 7)
+
+static void chachaInit(uint32_t* state, const AeadKey& key, const uint8_t* nonce) {
+    state[0] = 0x61707865;
+    state[1] = 0x3320646E;
+    state[2] = 0x79622D32;
+    state[3] = 0x6B206574;
+    for (int i = 0; i < 8; ++i) {
+        state[4 + i] = load32(key.bytes + 4 * i);
+    }
+    state[12] = 0;
+    state[13] = load32(nonce);
+    state[14] = load32(nonce + 4);
+    state[15] = load32(nonce + 8);
+}
+
+// Callers wipe state and out once they are done with the whole message, not after every block
+static void chachaBlock(uint32_t* state, uint32_t counter, uint8_t* out) {
+    state[12] = counter;
+    uint32_t x0 = state[0], x1 = state[1], x2 = state[2], x3 = state[3];
+    uint32_t x4 = state[4], x5 = state[5], x6 = state[6], x7 = state[7];
+    uint32_t x8 = state[8], x9 = state[9], x10 = state[10], x11 = state[11];
+    uint32_t x12 = state[12], x13 = state[13], x14 = state[14], x15 = state[15];
+    for (int round = 0; round < 10; ++round) {
+        CHACHA_QUARTER(x0, x4, x8, x12);
+        CHACHA_QUARTER(x1, x5, x9, x13);
+        CHACHA_QUARTER(x2, x6, x10, x14);
+        CHACHA_QUARTER(x3, x7, x11, x15);
+        CHACHA_QUARTER(x0, x5, x10, x15);
+        CHACHA_QUARTER(x1, x6, x11, x12);
+        CHACHA_QUARTER(x2, x7, x8, x13);
+        CHACHA_QUARTER(x3, x4, x9, x14);
+    }
+    const uint32_t x[16] = { x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15 };
+    for (int i = 0; i < 16; ++i) {
+        store32(out + 4 * i, x[i] + state[i]);
+    }
+}
+
+// Block 0 keys Poly1305, the data is encrypted from block 1 on
+static void chachaXor(const AeadKey& key, const uint8_t* nonce, uint8_t* data, size_t length) {
+    uint32_t state[16];
+    chachaInit(state, key, nonce);
+    uint8_t block[64];
+    uint32_t counter = 1;
+    for (size_t pos = 0; pos < length; pos += 64, ++counter) {
+        chachaBlock(state, counter, block);
+        size_t n = length - pos < 64 ? length - pos : 64;
+        for (size_t i = 0; i < n; ++i) {
+            data[pos + i] ^= block[i];
+        }
+    }
+    secureWipe(state, sizeof(state));
+    secureWipe(block, sizeof(block));
+}
+
+// ---- Poly1305, 26-bit limbs so every product fits in 64 bits ----
+
+struct Poly1305 {
+    uint32_t r[5];
+    uint32_t h[5];
+    uint32_t pad[4];
+};
+
+static void polyInit(Poly1305& poly, const uint8_t* key) {
+    poly.r[0] = load32(key + 0) & 0x3FFFFFF;
+    poly.r[1] = (load32(key + 3) >> 2) & 0x3FFFF03;
+    poly.r[2] = (load32(key + 6) >> 4) & 0x3FFC0FF;
+    poly.r[3] = (load32(key + 9) >> 6) & 0x3F03FFF;
+    poly.r[4] = (load32(key + 12) >> 8) & 0x00FFFFF;
+    for (int i = 0; i < 5; ++i) {
+        poly.h[i] = 0;
+    }
+    for (int i = 0; i < 4; ++i) {
+        poly.pad[i] = load32(key + 16 + 4 * i);
+    }
+}
+
+// Full 16-byte blocks only. The AEAD pads everything it authenticates to 16 bytes, so a short
+// final block never comes up
+static void polyBlocks(Poly1305& poly, const uint8_t* data, size_t length) {
+    const uint32_t r0 = poly.r[0], r1 = poly.r[1], r2 = poly.r[2], r3 = poly.r[3], r4 = poly.r[4];
+    const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = poly.h[0], h1 = poly.h[1], h2 = poly.h[2], h3 = poly.h[3], h4 = poly.h[4];
+
+    for (size_t pos = 0; pos + 16 <= length; pos += 16) {
+        const uint8_t* m = data + pos;
+        h0 += load32(m + 0) & 0x3FFFFFF;
+        h1 += (load32(m + 3) >> 2) & 0x3FFFFFF;
+        h2 += (load32(m + 6) >> 4) & 0x3FFFFFF;
+        h3 += (load32(m + 9) >> 6) & 0x3FFFFFF;
+        h4 += (load32(m + 12) >> 8) | (1u << 24);
+
+        uint64_t d0 = static_cast<uint64_t>(h0) * r0 + static_cast<uint64_t>(h1) * s4 + static_cast<uint64_t>(h2) * s3 +
+                      static_cast<uint64_t>(h3) * s2 + static_cast<uint64_t>(h4) * s1;
+        uint64_t d1 = static_cast<uint64_t>(h0) * r1 + static_cast<uint64_t>(h1) * r0 + static_cast<uint64_t>(h2) * s4 +
+                      static_cast<uint64_t>(h3) * s3 + static_cast<uint64_t>(h4) * s2;
+        uint64_t d2 = static_cast<uint64_t>(h0) * r2 + static_cast<uint64_t>(h1) * r1 + static_cast<uint64_t>(h2) * r0 +
+                      static_cast<uint64_t>(h3) * s4 + static_cast<uint64_t>(h4) * s3;
+        uint64_t d3 = static_cast<uint64_t>(h0) * r3 + static_cast<uint64_t>(h1) * r2 + static_cast<uint64_t>(h2) * r1 +
+                      static_cast<uint64_t>(h3) * r0 + static_cast<uint64_t>(h4) * s4;
+        uint64_t d4 = static_cast<uint64_t>(h0) * r4 + static_cast<uint64_t>(h1) * r3 + static_cast<uint64_t>(h2) * r2 +
+                      static_cast<uint64_t>(h3) * r1 + static_cast<uint64_t>(h4) * r0;
+
+        uint32_t c = static_cast<uint32_t>(d0 >> 26); h0 = static_cast<uint32_t>(d0) & 0x3FFFFFF;
+        d1 += c; c = static_cast<uint32_t>(d1 >> 26); h1 = static_cast<uint32_t>(d1) & 0x3FFFFFF;
+        d2 += c; c = static_cast<uint32_t>(d2 >> 26); h2 = static_cast<uint32_t>(d2) & 0x3FFFFFF;
+        d3 += c; c = static_cast<uint32_t>(d3 >> 26); h3 = static_cast<uint32_t>(d3) & 0x3FFFFFF;
+        d4 += c; c = static_cast<uint32_t>(d4 >> 26); h4 = static_cast<uint32_t>(d4) & 0x3FFFFFF;
+        h0 += c * 5; c = h0 >> 26; h0 &= 0x3FFFFFF;
+        h1 += c;
+    }
+    poly.h[0] = h0; poly.h[1] = h1; poly.h[2] = h2; poly.h[3] = h3; poly.h[4] = h4;
+}
+
+// Authenticates data followed by zeros up to the next multiple of 16
+static void polyPadded(Poly1305& poly, const uint8_t* data, size_t length) {
+    size_t full = length & ~static_cast<size_t>(15);
+    polyBlocks(poly, data, full);
+    if (full != length) {
+        uint8_t block[16] = {};
+        std::memcpy(block, data + full, length - full);
+        polyBlocks(poly, block, 16);
+        secureWipe(block, sizeof(block));
+    }
+}
+
+static void polyFinish(Poly1305& poly, uint8_t* tag) {
+    uint32_t h0 = poly.h[0], h1 = poly.h[1], h2 = poly.h[2], h3 = poly.h[3], h4 = poly.h[4];
+    uint32_t c = h1 >> 26; h1 &= 0x3FFFFFF;
+    h2 += c; c = h2 >> 26; h2 &= 0x3FFFFFF;
+    h3 += c; c = h3 >> 26; h3 &= 0x3FFFFFF;
+    h4 += c; c = h4 >> 26; h4 &= 0x3FFFFFF;
+    h0 += c * 5; c = h0 >> 26; h0 &= 0x3FFFFFF;
+    h1 += c;
+
+    // h - p, kept only if it didn't go negative, picked without a branch
+    uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3FFFFFF;
+    uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= 0x3FFFFFF;
+    uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= 0x3FFFFFF;
+    uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= 0x3FFFFFF;
+    uint32_t g4 = h4 + c - (1u << 26);
+    uint32_t mask = (g4 >> 31) - 1;
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+    h2 = (h2 & ~mask) | (g2 & mask);
+    h3 = (h3 & ~mask) | (g3 & mask);
+    h4 = (h4 & ~mask) | (g4 & mask);
+
+    uint32_t w0 = h0 | (h1 << 26);
+    uint32_t w1 = (h1 >> 6) | (h2 << 20);
+    uint32_t w2 = (h2 >> 12) | (h3 << 14);
+    uint32_t w3 = (h3 >> 18) | (h4 << 8);
+    uint64_t f = static_cast<uint64_t>(w0) + poly.pad[0];
+    store32(tag, static_cast<uint32_t>(f));
+    f = static_cast<uint64_t>(w1) + poly.pad[1] + (f >> 32);
+    store32(tag + 4, static_cast<uint32_t>(f));
+    f = static_cast<uint64_t>(w2) + poly.pad[2] + (f >> 32);
+    store32(tag + 8, static_cast<uint32_t>(f));
+    f = static_cast<uint64_t>(w3) + poly.pad[3] + (f >> 32);
+    store32(tag + 12, static_cast<uint32_t>(f));
+    secureWipe(&poly, sizeof(poly));
+}
+
+// Tag over aad || pad || ciphertext || pad || lengths, keyed by ChaCha20 block 0
+static void aeadTag(const AeadKey& key, const uint8_t* nonce, const void* aad, size_t aadLength,
+                    const uint8_t* ciphertext, size_t length, uint8_t* tag) {
+    uint32_t state[16];
+    chachaInit(state, key, nonce);
+    uint8_t block[64];
+    chachaBlock(state, 0, block);
+    Poly1305 poly;
+    polyInit(poly, block);
+    secureWipe(state, sizeof(state));
+    secureWipe(block, sizeof(block));
+
+    polyPadded(poly, static_cast<const uint8_t*>(aad), aadLength);
+    polyPadded(poly, ciphertext, length);
+    uint8_t lengths[16];
+    store64(lengths, aadLength);
+    store64(lengths + 8, length);
+    polyBlocks(poly, lengths, 16);
+    polyFinish(poly, tag);
+}
+
+void aeadSeal(const AeadKey& key, const uint8_t* nonce, const void* aad, size_t aadLength,
+              void* data, size_t length, uint8_t* tag) {
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    chachaXor(key, nonce, bytes, length);
+    aeadTag(key, nonce, aad, aadLength, bytes, length, tag);
+}
+
+bool aeadOpen(const AeadKey& key, const uint8_t* nonce, const void* aad, size_t aadLength,
+              void* data, size_t length, const uint8_t* tag) {
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    uint8_t expected[AEAD_TAG_SIZE];
+    aeadTag(key, nonce, aad, aadLength, bytes, length, expected);
+    if (!constantTimeEqual(expected, tag, AEAD_TAG_SIZE)) {
+        return false;
+    }
+    chachaXor(key, nonce, bytes, length);
+    return true;
+}
+
+// ---- SHA-256 ----
+
+static const uint32_t SHA256_K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+struct Sha256 {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t buffer[64];
+    size_t used;
+};
+
+static uint32_t rotr32(uint32_t v, int n) {
+    return (v >> n) | (v << (32 - n));
+}
+
+static uint32_t loadBe32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static void storeBe32(uint8_t* p, uint32_t v) {
+    p[0] = static_cast<uint8_t>(v >> 24);
+    p[1] = static_cast<uint8_t>(v >> 16);
+    p[2] = static_cast<uint8_t>(v >> 8);
+    p[3] = static_cast<uint8_t>(v);
+}
+
+static void shaCompress(uint32_t* state, const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = loadBe32(block + 4 * i);
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void shaInit(Sha256& sha) {
+    static const uint32_t initial[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+                                         0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+    std::memcpy(sha.state, initial, sizeof(initial));
+    sha.length = 0;
+    sha.used = 0;
+}
+
+static void shaUpdate(Sha256& sha, const void* data, size_t length) {
+    if (length == 0) return;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    sha.length += length;
+    if (sha.used > 0) {
+        size_t take = 64 - sha.used < length ? 64 - sha.used : length;
+        std::memcpy(sha.buffer + sha.used, bytes, take);
+        sha.used += take;
+        bytes += take;
+        length -= take;
+        if (sha.used < 64) return;
+        shaCompress(sha.state, sha.buffer);
+        sha.used = 0;
+    }
+    for (; length >= 64; bytes += 64, length -= 64) {
+        shaCompress(sha.state, bytes);
+    }
+    std::memcpy(sha.buffer, bytes, length);
+    sha.used = length;
+}
+
+// Leaves the finished state in sha, callers wipe it
+static void shaFinal(Sha256& sha, uint8_t* digest) {
+    uint64_t bits = sha.length * 8;
+    size_t used = sha.used;
+    sha.buffer[used++] = 0x80;
+    if (used > 56) {
+        std::memset(sha.buffer + used, 0, 64 - used);
+        shaCompress(sha.state, sha.buffer);
+        used = 0;
+    }
+    std::memset(sha.buffer + used, 0, 56 - used);
+    for (int i = 0; i < 8; ++i) {
+        sha.buffer[56 + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    }
+    shaCompress(sha.state, sha.buffer);
+    for (int i = 0; i < 8; ++i) {
+        storeBe32(digest + 4 * i, sha.state[i]);
+    }
+}
+
+void sha256(const void* data, size_t length, uint8_t* digest) {
+    Sha256 sha;
+    shaInit(sha);
+    shaUpdate(sha, data, length);
+    shaFinal(sha, digest);
+    secureWipe(&sha, sizeof(sha));
+}
+
+// ---- HMAC and PBKDF2 ----
+
+// The inner and outer hashes after the padded key, so each HMAC after this costs two short updates
+struct HmacKey {
+    Sha256 inner;
+    Sha256 outer;
+};
+
+static void hmacInit(HmacKey& hmac, const void* key, size_t keyLength) {
+    uint8_t block[64] = {};
+    if (keyLength > 64) {
+        sha256(key, keyLength, block);
+    } else {
+        std::memcpy(block, key, keyLength);
+    }
+    uint8_t pad[64];
+    for (int i = 0; i < 64; ++i) pad[i] = block[i] ^ 0x36;
+    shaInit(hmac.inner);
+    shaUpdate(hmac.inner, pad, 64);
+    for (int i = 0; i < 64; ++i) pad[i] = block[i] ^ 0x5C;
+    shaInit(hmac.outer);
+    shaUpdate(hmac.outer, pad, 64);
+    secureWipe(block, sizeof(block));
+    secureWipe(pad, sizeof(pad));
+}
+
+// sha is scratch space, left for the caller to wipe after the last HMAC
+static void hmacCompute(const HmacKey& hmac, Sha256& sha, const void* data, size_t length,
+                        const void* more, size_t moreLength, uint8_t* mac) {
+    sha = hmac.inner;
+    shaUpdate(sha, data, length);
+    shaUpdate(sha, more, moreLength);
+    uint8_t innerDigest[SHA256_SIZE];
+    shaFinal(sha, innerDigest);
+    sha = hmac.outer;
+    shaUpdate(sha, innerDigest, sizeof(innerDigest));
+    shaFinal(sha, mac);
+}
+
+void hmacSha256(const void* key, size_t keyLength, const void* data, size_t length, uint8_t* mac) {
+    HmacKey hmac;
+    Sha256 sha;
+    hmacInit(hmac, key, keyLength);
+    hmacCompute(hmac, sha, data, length, nullptr, 0, mac);
+    secureWipe(&hmac, sizeof(hmac));
+    secureWipe(&sha, sizeof(sha));
+}
+
+void pbkdf2Sha256(std::string_view passphrase, const uint8_t* salt, size_t saltLength, uint32_t iterations,
+                  uint8_t* out, size_t outLength) {
+    HmacKey hmac;
+    Sha256 sha;
+    hmacInit(hmac, passphrase.data(), passphrase.size());
+    uint8_t u[SHA256_SIZE];
+    uint8_t t[SHA256_SIZE];
+    for (uint32_t block = 1; outLength > 0; ++block) {
+        uint8_t index[4];
+        storeBe32(index, block);
+        hmacCompute(hmac, sha, salt, saltLength, index, sizeof(index), u);
+        std::memcpy(t, u, sizeof(t));
+        for (uint32_t i = 1; i < iterations; ++i) {
+            hmacCompute(hmac, sha, u, sizeof(u), nullptr, 0, u);
+            for (size_t j = 0; j < sizeof(t); ++j) {
+                t[j] ^= u[j];
+            }
+        }
+        size_t n = outLength < sizeof(t) ? outLength : sizeof(t);
+        std::memcpy(out, t, n);
+        out += n;
+        outLength -= n;
+    }
+    secureWipe(&hmac, sizeof(hmac));
+    secureWipe(&sha, sizeof(sha));
+    secureWipe(u, sizeof(u));
+    secureWipe(t, sizeof(t));
+}
+
+bool randomBytes(void* out, size_t length) {
+#ifdef _WIN32
+    return BCryptGenRandom(nullptr, static_cast<PUCHAR>(out), static_cast<ULONG>(length),
+                           BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0;
+#else
+    FILE* source = std::fopen("/dev/urandom", "rb");
+    if (!source) return false;
+    // Unbuffered, so no random bytes are left behind in a stdio buffer
+    std::setvbuf(source, nullptr, _IONBF, 0);
+    bool ok = std::fread(out, 1, length, source) == length;
+    std::fclose(source);
+    return ok;
+#endif
+}
+
+bool constantTimeEqual(const uint8_t* a, const uint8_t* b, size_t length) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < length; ++i) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "secure_alloc.h"
+
+// What the sealed vault needs from cryptography, written out here so the engine still builds
+// without external libraries:
+//   ChaCha20-Poly1305   AEAD from RFC 8439, seals every chunk and journal record
+//   SHA-256, HMAC       for PBKDF2 and the key check
+//   PBKDF2-HMAC-SHA256  turns the passphrase into the vault key
+// The ciphers have no secret-dependent branches or table lookups, and tags are compared in constant time
+
+const size_t AEAD_KEY_SIZE = 32;
+const size_t AEAD_NONCE_SIZE = 12;
+const size_t AEAD_TAG_SIZE = 16;
+const size_t SHA256_SIZE = 32;
+
+// Wiped when it goes out of scope, like everything else holding vault secrets
+struct AeadKey {
+    uint8_t bytes[AEAD_KEY_SIZE] = {};
+
+    AeadKey() = default;
+    AeadKey(const AeadKey&) = default;
+    AeadKey& operator=(const AeadKey&) = default;
+    ~AeadKey() { secureWipe(bytes, sizeof(bytes)); }
+};
+
+// Encrypts data in place and writes its tag. aad is authenticated along with it but stays as it is.
+// A nonce must never be used twice with the same key
+void aeadSeal(const AeadKey& key, const uint8_t* nonce, const void* aad, size_t aadLength,
+              void* data, size_t length, uint8_t* tag);
+// Checks the tag and only then decrypts in place. Returns false, leaving data as it was, if the
+// key is wrong or anything covered by the tag was altered
+bool aeadOpen(const AeadKey& key, const uint8_t* nonce, const void* aad, size_t aadLength,
+              void* data, size_t length, const uint8_t* tag);
+
+void sha256(const void* data, size_t length, uint8_t* digest);
+void hmacSha256(const void* key, size_t keyLength, const void* data, size_t length, uint8_t* mac);
+void pbkdf2Sha256(std::string_view passphrase, const uint8_t* salt, size_t saltLength, uint32_t iterations,
+                  uint8_t* out, size_t outLength);
+
+// Fills out from the OS random source. Fails only if the OS has nothing to give
+bool randomBytes(void* out, size_t length);
+
+// Compares without stopping at the first difference, so the time taken says nothing about where it was
+bool constantTimeEqual(const uint8_t* a, const uint8_t* b, size_t length);
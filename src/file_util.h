@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+// Flushes the stdio buffer and waits until the OS has put the data on disk
+bool syncFile(FILE* file);
+
+bool fileExists(const std::string& filename);
+
+// Atomically replaces target with source. Once this returns true, readers see either the
+// old file or the new one, even across a power loss
+bool replaceFile(const std::string& source, const std::string& target);
@@ -0,0 +1,71 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+RenderCounters renderCounters;
+
+void toggleFrameStats(FrameStats& stats) {
+    stats.visible = !stats.visible;
+    stats.frames = 0;
+}
+
+void beginFrame(FrameStats& stats, uint64_t allocations) {
+    if (!stats.visible) return;
+    renderCounters = RenderCounters();
+    stats.allocationsAtStart = allocations;
+    stats.frameStart = SDL_GetPerformanceCounter();
+}
+
+void endFrame(FrameStats& stats, uint64_t allocations) {
+    if (!stats.visible) return;
+    Uint64 elapsed = SDL_GetPerformanceCounter() - stats.frameStart;
+    stats.frameMs[stats.frames % FRAME_HISTORY] = static_cast<double>(elapsed) * 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+    ++stats.frames;
+    stats.lastFrame = renderCounters;
+    stats.lastFrameAllocations = allocations - stats.allocationsAtStart;
+}
+
+// Percentile of the sorted window, nearest rank
+static double percentile(const double* sorted, size_t count, double p) {
+    size_t rank = static_cast<size_t>(p * static_cast<double>(count - 1) + 0.5);
+    return sorted[std::min(rank, count - 1)];
+}
+
+void drawFrameStats(SDL_Renderer* renderer, GlyphAtlas& atlas, const FrameStats& stats, size_t vaultBytesLive) {
+    if (!stats.visible) return;
+
+    char lines[4][96];
+    size_t count = std::min(stats.frames, FRAME_HISTORY);
+    if (count == 0) {
+        std::snprintf(lines[0], sizeof(lines[0]), "frame: no frames yet");
+    } else {
+        double sorted[FRAME_HISTORY];
+        std::copy(stats.frameMs, stats.frameMs + count, sorted);
+        std::sort(sorted, sorted + count);
+        std::snprintf(lines[0], sizeof(lines[0]), "frame ms p50 %.2f  p95 %.2f  p99 %.2f  max %.2f",
+                      percentile(sorted, count, 0.50), percentile(sorted, count, 0.95),
+                      percentile(sorted, count, 0.99), sorted[count - 1]);
+    }
+    std::snprintf(lines[1], sizeof(lines[1]), "TTF renders %u  textures +%u -%u",
+                  stats.lastFrame.ttfRenders, stats.lastFrame.textureCreates, stats.lastFrame.textureDestroys);
+    std::snprintf(lines[2], sizeof(lines[2]), "heap allocations %llu",
+                  static_cast<unsigned long long>(stats.lastFrameAllocations));
+    std::snprintf(lines[3], sizeof(lines[3]), "vault memory %zu KB", vaultBytesLive / 1024);
+
+    SDL_Rect panel = { 5, 5, 0, 4 * atlas.lineHeight + 10 };
+    for (const char* line : lines) {
+        panel.w = std::max(panel.w, measureText(atlas, line) + 10);
+    }
+
+    SDL_BlendMode previousMode;
+    SDL_GetRenderDrawBlendMode(renderer, &previousMode);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
+    SDL_RenderFillRect(renderer, &panel);
+    SDL_SetRenderDrawBlendMode(renderer, previousMode);
+
+    for (int i = 0; i < 4; ++i) {
+        drawText(renderer, atlas, lines[i], panel.x + 5, panel.y + 5 + i * atlas.lineHeight, { 255, 255, 0, 255 });
+    }
+}
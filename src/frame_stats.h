@@ -0,0 +1,45 @@
+#pragma once
+
+#include <SDL.h>
+#include <cstddef>
+#include <cstdint>
+
+#include "text_atlas.h"
+
+// Bumped by the render code wherever it rasterizes text or creates and destroys textures.
+// Plain increments, so they stay in place whether or not anything reads them
+struct RenderCounters {
+    uint32_t ttfRenders = 0;
+    uint32_t textureCreates = 0;
+    uint32_t textureDestroys = 0;
+};
+
+extern RenderCounters renderCounters;
+
+// Heap allocations through operator new since startup. Defined in heap_counter.cpp, which only
+// the app links, so libraries and tools keep the default allocator
+uint64_t heapAllocationCount();
+
+const size_t FRAME_HISTORY = 120;
+
+// Debug overlay for the main loop. While hidden, beginFrame and endFrame return right away
+struct FrameStats {
+    bool visible = false;
+    double frameMs[FRAME_HISTORY] = {};
+    size_t frames = 0;             // frames recorded since the overlay was shown, the ring keeps the last FRAME_HISTORY
+    Uint64 frameStart = 0;
+    uint64_t allocationsAtStart = 0;
+
+    RenderCounters lastFrame;      // what the last finished frame did
+    uint64_t lastFrameAllocations = 0;
+};
+
+void toggleFrameStats(FrameStats& stats);
+
+// Brackets the drawing and presenting of one frame; allocations is heapAllocationCount() at that point
+void beginFrame(FrameStats& stats, uint64_t allocations);
+void endFrame(FrameStats& stats, uint64_t allocations);
+
+// Draws the overlay in the top-left corner. It formats into stack buffers and draws straight from
+// the atlas, so showing it adds no allocations or textures of its own
+void drawFrameStats(SDL_Renderer* renderer, GlyphAtlas& atlas, const FrameStats& stats, size_t vaultBytesLive);
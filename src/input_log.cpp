@@ -0,0 +1,258 @@
+#include "input_log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+enum class InputLogMode {
+    Off,
+    Recording,
+    Replaying
+};
+
+struct RecordedEvent {
+    Uint32 time;
+    SDL_Event event;
+};
+
+struct InputLog {
+    InputLogMode mode = InputLogMode::Off;
+
+    // Recording
+    std::ofstream out;
+    Uint32 recordStart = 0;
+    bool secret = false;       // text input is logged as placeholders
+
+    // Replaying
+    std::vector<RecordedEvent> events;
+    size_t next = 0;
+    Uint32 clock = 0;
+    bool batchOpen = false;    // the last poll returned an event, so the next empty one ends the batch
+    Uint64 replayStart = 0;
+    Uint64 replayEnd = 0;
+};
+
+static InputLog inputLog;
+
+static void writeEvent(std::ostream& out, Uint32 time, const SDL_Event& e, bool secret) {
+    switch (e.type) {
+    case SDL_MOUSEBUTTONDOWN:
+        out << time << " down " << static_cast<int>(e.button.button) << ' ' << e.button.x << ' ' << e.button.y;
+        break;
+    case SDL_MOUSEWHEEL:
+        out << time << " wheel " << e.wheel.x << ' ' << e.wheel.y;
+        break;
+    case SDL_KEYDOWN:
+        out << time << " key " << e.key.keysym.sym << ' ' << e.key.keysym.mod;
+        break;
+    case SDL_TEXTINPUT: {
+        out << time << " text ";
+        char hex[3];
+        for (const char* p = e.text.text; *p; ++p) {
+            std::snprintf(hex, sizeof(hex), "%02x", secret ? '*' : static_cast<unsigned char>(*p));
+            out << hex;
+        }
+        break;
+    }
+    case SDL_QUIT:
+        out << time << " quit";
+        break;
+    default:
+        return;
+    }
+    // Flushed per event, the log is most useful exactly when the app didn't exit cleanly
+    out << '\n';
+    out.flush();
+}
+
+static bool decodeHex(const char* hex, char* out, size_t capacity) {
+    size_t length = std::strlen(hex);
+    if (length % 2 != 0 || length / 2 >= capacity) return false;
+    for (size_t i = 0; i < length; i += 2) {
+        unsigned int byte = 0;
+        if (std::sscanf(hex + i, "%2x", &byte) != 1) return false;
+        out[i / 2] = static_cast<char>(byte);
+    }
+    out[length / 2] = '\0';
+    return true;
+}
+
+static bool parseEvent(const std::string& line, RecordedEvent& recorded) {
+    SDL_Event& e = recorded.event;
+    SDL_zero(e);
+    char type[8] = {};
+    int consumed = 0;
+    if (std::sscanf(line.c_str(), "%u %7s %n", &recorded.time, type, &consumed) < 2) return false;
+    const char* args = line.c_str() + consumed;
+
+    if (std::strcmp(type, "down") == 0) {
+        int button = 0;
+        e.type = SDL_MOUSEBUTTONDOWN;
+        if (std::sscanf(args, "%d %d %d", &button, &e.button.x, &e.button.y) != 3) return false;
+        e.button.button = static_cast<Uint8>(button);
+        e.button.state = SDL_PRESSED;
+        e.button.clicks = 1;
+    } else if (std::strcmp(type, "wheel") == 0) {
+        e.type = SDL_MOUSEWHEEL;
+        e.wheel.direction = SDL_MOUSEWHEEL_NORMAL;
+        if (std::sscanf(args, "%d %d", &e.wheel.x, &e.wheel.y) != 2) return false;
+    } else if (std::strcmp(type, "key") == 0) {
+        int sym = 0;
+        unsigned int mod = 0;
+        e.type = SDL_KEYDOWN;
+        if (std::sscanf(args, "%d %u", &sym, &mod) != 2) return false;
+        e.key.state = SDL_PRESSED;
+        e.key.keysym.sym = sym;
+        e.key.keysym.mod = static_cast<Uint16>(mod);
+    } else if (std::strcmp(type, "text") == 0) {
+        e.type = SDL_TEXTINPUT;
+        if (!decodeHex(args, e.text.text, sizeof(e.text.text))) return false;
+    } else if (std::strcmp(type, "quit") == 0) {
+        e.type = SDL_QUIT;
+    } else {
+        return false;
+    }
+    e.common.timestamp = recorded.time;
+    return true;
+}
+
+bool startInputRecording(const std::string& filename) {
+    stopInputLog();
+    inputLog.out.open(filename, std::ios::trunc);
+    if (!inputLog.out) {
+        std::cerr << "Failed to open input log for recording: " << filename << std::endl;
+        return false;
+    }
+    inputLog.out << "# NoteBook input log\n";
+    inputLog.recordStart = SDL_GetTicks();
+    inputLog.mode = InputLogMode::Recording;
+    return true;
+}
+
+bool startInputReplay(const std::string& filename) {
+    stopInputLog();
+    std::ifstream in(filename);
+    if (!in) {
+        std::cerr << "Failed to open input log for replay: " << filename << std::endl;
+        return false;
+    }
+
+    std::vector<RecordedEvent> events;
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        if (line.empty() || line[0] == '#') continue;
+        RecordedEvent recorded;
+        if (!parseEvent(line, recorded)) {
+            std::cerr << "Bad input log line " << lineNumber << " in " << filename << ": " << line << std::endl;
+            return false;
+        }
+        events.push_back(recorded);
+    }
+
+    inputLog.events = std::move(events);
+    inputLog.next = 0;
+    inputLog.clock = 0;
+    inputLog.batchOpen = false;
+    inputLog.replayStart = SDL_GetPerformanceCounter();
+    inputLog.replayEnd = 0;
+    inputLog.mode = InputLogMode::Replaying;
+    return true;
+}
+
+void stopInputLog() {
+    if (inputLog.mode == InputLogMode::Recording) {
+        inputLog.out.close();
+    }
+    inputLog.mode = InputLogMode::Off;
+}
+
+bool inputReplaying() {
+    return inputLog.mode == InputLogMode::Replaying;
+}
+
+void setInputLogSecret(bool secret) {
+    inputLog.secret = secret;
+}
+
+static bool replayExhausted() {
+    if (inputLog.next < inputLog.events.size()) return false;
+    if (inputLog.replayEnd == 0) {
+        inputLog.replayEnd = SDL_GetPerformanceCounter();
+    }
+    return true;
+}
+
+bool pollInput(SDL_Event* e) {
+    if (inputLog.mode != InputLogMode::Replaying) {
+        if (!SDL_PollEvent(e)) return false;
+        if (inputLog.mode == InputLogMode::Recording) {
+            Uint32 time = SDL_TICKS_PASSED(e->common.timestamp, inputLog.recordStart) ? e->common.timestamp - inputLog.recordStart : 0;
+            writeEvent(inputLog.out, time, *e, inputLog.secret);
+        }
+        return true;
+    }
+
+    // Real input would make the replay diverge from the recording, so it is drained and dropped
+    SDL_Event discarded;
+    while (SDL_PollEvent(&discarded)) {}
+
+    // Once the log runs out, every poll loop gets a quit of its own in its next batch, which closes
+    // the popups one by one and then the main window
+    if (replayExhausted()) {
+        inputLog.batchOpen = !inputLog.batchOpen;
+        if (!inputLog.batchOpen) return false;
+        SDL_zerop(e);
+        e->type = SDL_QUIT;
+        e->common.timestamp = inputLog.clock;
+        return true;
+    }
+
+    // Events recorded at the same moment arrive in the same batch, later ones wait for the next waitInput
+    const RecordedEvent& recorded = inputLog.events[inputLog.next];
+    inputLog.batchOpen = SDL_TICKS_PASSED(inputLog.clock, recorded.time);
+    if (!inputLog.batchOpen) return false;
+    *e = recorded.event;
+    ++inputLog.next;
+    return true;
+}
+
+void waitInput() {
+    if (inputLog.mode != InputLogMode::Replaying) {
+        SDL_WaitEvent(nullptr);
+        return;
+    }
+    if (!replayExhausted() && SDL_TICKS_PASSED(inputLog.events[inputLog.next].time, inputLog.clock)) {
+        inputLog.clock = inputLog.events[inputLog.next].time;
+    }
+}
+
+bool waitInputTimeout(Uint32 timeoutMs) {
+    if (inputLog.mode != InputLogMode::Replaying) {
+        return SDL_WaitEventTimeout(nullptr, static_cast<int>(timeoutMs)) != 0;
+    }
+    Uint32 deadline = inputLog.clock + timeoutMs;
+    if (!replayExhausted() && SDL_TICKS_PASSED(deadline, inputLog.events[inputLog.next].time)) {
+        waitInput();
+        return true;
+    }
+    inputLog.clock = deadline;
+    return false;
+}
+
+Uint32 inputTicks() {
+    return inputLog.mode == InputLogMode::Replaying ? inputLog.clock : SDL_GetTicks();
+}
+
+InputReplayStats inputReplayStats() {
+    InputReplayStats stats;
+    stats.events = inputLog.next;
+    Uint64 end = inputLog.replayEnd ? inputLog.replayEnd : SDL_GetPerformanceCounter();
+    if (inputLog.replayStart != 0) {
+        stats.wallMs = static_cast<double>(end - inputLog.replayStart) * 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+    }
+    return stats;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <SDL.h>
+
+#include <string>
+
+// Every modal loop reads its input through here instead of SDL directly, so a session can be
+// recorded to a file and replayed later without a person at the keyboard.
+//
+// Only the events the UI reacts to are logged: clicks, the wheel, key presses, text input and quit,
+// each with its time in ms since recording started. During a replay the events come from the file,
+// real input is thrown away, and inputTicks() follows the recorded times, so timed redraws like the
+// "Copied!" feedback expire at the same point in the event stream on every machine. Replays run as
+// fast as the loops can draw, and a replay that runs out of events quits the app.
+//
+// Log lines, one event each:
+//   <ms> down <button> <x> <y>
+//   <ms> wheel <x> <y>
+//   <ms> key <keycode> <mod>
+//   <ms> text <UTF-8 bytes in hex>
+//   <ms> quit
+
+bool startInputRecording(const std::string& filename);
+bool startInputReplay(const std::string& filename);
+void stopInputLog();
+
+bool inputReplaying();
+
+// While set, text input is recorded as one '*' per byte instead of what was typed, for fields
+// like passwords. Replays then type the placeholder, which edits the same way
+void setInputLogSecret(bool secret);
+
+// Stand-ins for SDL_PollEvent, SDL_WaitEvent(nullptr) and SDL_WaitEventTimeout(nullptr, ms).
+// While replaying, the waits never block: a timeout "expires" when the next recorded event is later
+bool pollInput(SDL_Event* e);
+void waitInput();
+bool waitInputTimeout(Uint32 timeoutMs);
+
+// SDL_GetTicks(), or the recorded clock while replaying
+Uint32 inputTicks();
+
+struct InputReplayStats {
+    size_t events = 0;
+    double wallMs = 0;
+};
+
+InputReplayStats inputReplayStats();
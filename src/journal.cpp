@@ -0,0 +1,214 @@
+#include "journal.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "file_util.h"
+#include "trace.h"
+
+const uint32_t JOURNAL_MAX_PAYLOAD = 1 << 20;
+
+static uint32_t fnv1a(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void putBytes(SecureVector<char>& out, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+static void putString(SecureVector<char>& out, const std::string& str) {
+    uint32_t length = static_cast<uint32_t>(str.size());
+    putBytes(out, &length, sizeof(length));
+    putBytes(out, str.data(), str.size());
+}
+
+// Reads fixed-size fields out of a payload, failing instead of running past its end
+struct PayloadReader {
+    const char* pos;
+    const char* end;
+
+    bool get(void* out, size_t size) {
+        if (static_cast<size_t>(end - pos) < size) return false;
+        std::memcpy(out, pos, size);
+        pos += size;
+        return true;
+    }
+
+    bool getString(std::string& out) {
+        uint32_t length = 0;
+        if (!get(&length, sizeof(length)) || static_cast<size_t>(end - pos) < length) return false;
+        out.assign(pos, length);
+        pos += length;
+        return true;
+    }
+};
+
+// What a sealed record's tag covers besides the payload
+static size_t recordAad(const uint8_t* fileId, uint32_t payloadLength, uint8_t* aad) {
+    std::memcpy(aad, "JRNL", 4);
+    std::memcpy(aad + 4, fileId, JOURNAL_FILE_ID_SIZE);
+    std::memcpy(aad + 4 + JOURNAL_FILE_ID_SIZE, &payloadLength, sizeof(payloadLength));
+    return 8 + JOURNAL_FILE_ID_SIZE;
+}
+
+bool openJournal(Journal& journal, const std::string& filename, uint64_t nextSeq, const AeadKey* key, const uint8_t* fileId) {
+    journal.file = std::fopen(filename.c_str(), "ab");
+    if (!journal.file) {
+        std::cerr << "Failed to open journal: " << filename << std::endl;
+        return false;
+    }
+    journal.filename = filename;
+    journal.nextSeq = nextSeq;
+    journal.recordCount = 0;
+    journal.sealed = key != nullptr;
+    if (key) {
+        journal.key = *key;
+        std::memcpy(journal.fileId, fileId, JOURNAL_FILE_ID_SIZE);
+    }
+    return true;
+}
+
+void closeJournal(Journal& journal) {
+    if (journal.file) {
+        syncFile(journal.file);
+        std::fclose(journal.file);
+        journal.file = nullptr;
+    }
+}
+
+bool appendJournal(Journal& journal, JournalRecord& record) {
+    if (!journal.file) return false;
+
+    record.seq = journal.nextSeq;
+
+    // Length and checksum are patched in once the payload is encoded
+    SecureVector<char>& buf = journal.buffer;
+    size_t headerSize = journal.sealed ? sizeof(uint32_t) + AEAD_NONCE_SIZE + AEAD_TAG_SIZE : 2 * sizeof(uint32_t);
+    buf.assign(headerSize, 0);
+    putBytes(buf, &record.seq, sizeof(record.seq));
+    uint8_t op = record.op;
+    putBytes(buf, &op, sizeof(op));
+    putBytes(buf, &record.service, sizeof(record.service));
+    putBytes(buf, &record.account, sizeof(record.account));
+    putString(buf, record.text1);
+    putString(buf, record.text2);
+
+    uint32_t payloadLength = static_cast<uint32_t>(buf.size() - headerSize);
+    std::memcpy(buf.data(), &payloadLength, sizeof(payloadLength));
+    if (journal.sealed) {
+        uint8_t* nonce = reinterpret_cast<uint8_t*>(buf.data() + sizeof(uint32_t));
+        uint8_t aad[32];
+        size_t aadLength = recordAad(journal.fileId, payloadLength, aad);
+        if (!randomBytes(nonce, AEAD_NONCE_SIZE)) {
+            std::cerr << "No random numbers for the journal: " << journal.filename << std::endl;
+            return false;
+        }
+        aeadSeal(journal.key, nonce, aad, aadLength, buf.data() + headerSize, payloadLength, nonce + AEAD_NONCE_SIZE);
+    } else {
+        uint32_t checksum = fnv1a(buf.data() + headerSize, payloadLength);
+        std::memcpy(buf.data() + sizeof(uint32_t), &checksum, sizeof(checksum));
+    }
+
+    if (std::fwrite(buf.data(), 1, buf.size(), journal.file) != buf.size() || !syncFile(journal.file)) {
+        // Part of the record may be on disk, and replay stops at it, so nothing more is appended
+        // behind it. The caller keeps later edits in memory until the vault is saved
+        std::cerr << "Failed to append to journal, closing it: " << journal.filename << std::endl;
+        std::fclose(journal.file);
+        journal.file = nullptr;
+        return false;
+    }
+
+    ++journal.nextSeq;
+    ++journal.recordCount;
+    return true;
+}
+
+bool applyJournalRecord(Vault& vault, const JournalRecord& record) {
+    switch (record.op) {
+    case JOURNAL_ADD_SERVICE:
+        return vaultAddService(vault, record.text1);
+    case JOURNAL_ADD_ACCOUNT:
+        if (record.service >= vaultServiceCount(vault)) return false;
+        return vaultAddAccount(vault, record.service, record.text1, record.text2);
+    case JOURNAL_DELETE_ACCOUNT:
+        if (record.service >= vaultServiceCount(vault)) return false;
+        if (record.account >= vaultAccountCount(vault, record.service)) return false;
+        vaultDeleteAccount(vault, record.service, record.account);
+        return true;
+    case JOURNAL_DELETE_SERVICE:
+        if (record.service >= vaultServiceCount(vault)) return false;
+        vaultDeleteService(vault, record.service);
+        return true;
+    }
+    return false;
+}
+
+bool replayJournal(const std::string& filename, uint64_t afterSeq, Vault& vault, uint64_t& lastSeq,
+                   const AeadKey* key, const uint8_t* fileId) {
+    TRACE_SCOPE("replayJournal");
+    std::ifstream inFile(filename, std::ios::binary);
+    if (!inFile) {
+        return true;
+    }
+    SecureVector<char> data((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+
+    size_t headerSize = key ? sizeof(uint32_t) + AEAD_NONCE_SIZE + AEAD_TAG_SIZE : 2 * sizeof(uint32_t);
+    uint64_t previousSeq = 0;
+    size_t pos = 0;
+    while (data.size() - pos >= headerSize) {
+        uint32_t payloadLength = 0;
+        std::memcpy(&payloadLength, data.data() + pos, sizeof(payloadLength));
+        char* payload = data.data() + pos + headerSize;
+
+        bool intact = payloadLength <= JOURNAL_MAX_PAYLOAD && data.size() - pos - headerSize >= payloadLength;
+        if (intact && key) {
+            const uint8_t* nonce = reinterpret_cast<const uint8_t*>(data.data() + pos + sizeof(uint32_t));
+            uint8_t aad[32];
+            size_t aadLength = recordAad(fileId, payloadLength, aad);
+            intact = aeadOpen(*key, nonce, aad, aadLength, payload, payloadLength, nonce + AEAD_NONCE_SIZE);
+        } else if (intact) {
+            uint32_t checksum = 0;
+            std::memcpy(&checksum, data.data() + pos + sizeof(uint32_t), sizeof(checksum));
+            intact = fnv1a(payload, payloadLength) == checksum;
+        }
+        if (!intact) {
+            std::cerr << "Ignoring torn journal tail in " << filename << std::endl;
+            break;
+        }
+
+        JournalRecord record;
+        uint8_t op = 0;
+        PayloadReader reader = { payload, payload + payloadLength };
+        if (!reader.get(&record.seq, sizeof(record.seq)) || !reader.get(&op, sizeof(op)) ||
+            !reader.get(&record.service, sizeof(record.service)) || !reader.get(&record.account, sizeof(record.account)) ||
+            !reader.getString(record.text1) || !reader.getString(record.text2)) {
+            std::cerr << "Malformed journal record in " << filename << std::endl;
+            return false;
+        }
+        record.op = static_cast<JournalOp>(op);
+        // A sealed record can't be altered, but whole records could still be dropped or replayed
+        if (key && previousSeq != 0 && record.seq != previousSeq + 1) {
+            std::cerr << "Journal record " << record.seq << " is out of sequence in " << filename << std::endl;
+            return false;
+        }
+        previousSeq = record.seq;
+
+        if (record.seq > afterSeq) {
+            if (!applyJournalRecord(vault, record)) {
+                std::cerr << "Journal record " << record.seq << " does not match the vault in " << filename << std::endl;
+                return false;
+            }
+        }
+        if (record.seq > lastSeq) lastSeq = record.seq;
+        pos += headerSize + payloadLength;
+    }
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "crypto.h"
+#include "vault.h"
+
+// Write-ahead journal of vault edits. Every record is appended and synced to disk before the
+// edit counts as done, and is replayed on top of save.vault after a crash.
+//
+// Record framing: u32 payload length | u32 FNV-1a checksum of the payload | payload
+// Sealed framing, when the journal belongs to a sealed vault:
+//   u32 payload length | nonce | tag | payload sealed with the vault key
+// The tag covers the vault's file id and the length, and sequence numbers must follow each other,
+// so records of another vault or ones moved around stop the replay like a torn tail
+// Payload: u64 seq | u8 op | u32 service | u32 account | u32 len, text | u32 len, text
+enum JournalOp : uint8_t {
+    JOURNAL_ADD_SERVICE = 1,
+    JOURNAL_ADD_ACCOUNT = 2,
+    JOURNAL_DELETE_ACCOUNT = 3,
+    JOURNAL_DELETE_SERVICE = 4,
+};
+
+const size_t JOURNAL_FILE_ID_SIZE = 16;
+
+struct JournalRecord {
+    uint64_t seq = 0;
+    JournalOp op = JOURNAL_ADD_SERVICE;
+    uint32_t service = 0;
+    uint32_t account = 0;
+    std::string text1;   // service label, or account name
+    std::string text2;   // account password
+};
+
+struct Journal {
+    FILE* file = nullptr;
+    std::string filename;
+    uint64_t nextSeq = 1;
+    size_t recordCount = 0;      // records appended since the file was opened
+    SecureVector<char> buffer;   // reused encoding buffer
+    bool sealed = false;
+    AeadKey key;
+    uint8_t fileId[JOURNAL_FILE_ID_SIZE] = {};
+};
+
+// Opens the journal for appending, numbering new records from nextSeq. With a key the records are
+// sealed for the vault fileId names, without one they are written in the clear
+bool openJournal(Journal& journal, const std::string& filename, uint64_t nextSeq,
+                 const AeadKey* key = nullptr, const uint8_t* fileId = nullptr);
+void closeJournal(Journal& journal);
+
+// Appends the record, assigning it the next sequence number, and syncs it to disk. A failed write
+// closes the journal, since records after a torn one would never be replayed
+bool appendJournal(Journal& journal, JournalRecord& record);
+
+// Applies one record to the vault. Returns false if it doesn't fit the current state
+bool applyJournalRecord(Vault& vault, const JournalRecord& record);
+
+// Applies every intact record newer than afterSeq. Reading stops at the first torn or corrupted
+// record, which is what a crash in the middle of an append leaves behind. lastSeq is raised to
+// the highest sequence number seen. key and fileId must match what the journal was opened with
+bool replayJournal(const std::string& filename, uint64_t afterSeq, Vault& vault, uint64_t& lastSeq,
+                   const AeadKey* key = nullptr, const uint8_t* fileId = nullptr);
@@ -0,0 +1,159 @@
+#include "label_cache.h"
+
+#include <functional>
+
+#include "frame_stats.h"
+#include "trace.h"
+
+static size_t labelHash(std::string_view text, const GlyphAtlas* atlas) {
+    size_t h = std::hash<std::string_view>{}(text);
+    return h ^ (std::hash<const void*>{}(atlas) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2));
+}
+
+static bool sameColor(SDL_Color a, SDL_Color b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static void removeEntry(LabelCache& cache, std::list<LabelEntry>::iterator it) {
+    auto range = cache.lookup.equal_range(it->hash);
+    for (auto m = range.first; m != range.second; ++m) {
+        if (m->second == it) {
+            cache.lookup.erase(m);
+            break;
+        }
+    }
+    SDL_DestroyTexture(it->texture);
+    ++renderCounters.textureDestroys;
+    cache.bytesUsed -= it->bytes;
+    cache.entries.erase(it);
+}
+
+static void evictToFit(LabelCache& cache, size_t incoming) {
+    while (!cache.entries.empty() && cache.bytesUsed + incoming > cache.maxBytes) {
+        removeEntry(cache, std::prev(cache.entries.end()));
+        ++cache.evictions;
+    }
+}
+
+// Renders the label once from the glyph atlas into a texture of its own
+static SDL_Texture* renderLabelTexture(SDL_Renderer* renderer, GlyphAtlas& atlas, std::string_view text, SDL_Color color, int w, int h) {
+    TRACE_SCOPE("rasterize label");
+    SDL_Texture* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    if (!texture) {
+        return nullptr;
+    }
+    ++renderCounters.textureCreates;
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    SDL_Texture* previousTarget = SDL_GetRenderTarget(renderer);
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+
+    if (SDL_SetRenderTarget(renderer, texture) != 0) {
+        SDL_DestroyTexture(texture);
+        ++renderCounters.textureDestroys;
+        return nullptr;
+    }
+    // Clearing to the text color with zero alpha keeps glyph edges from being darkened twice
+    // when the finished texture is blended onto the screen
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 0);
+    SDL_RenderClear(renderer);
+    drawText(renderer, atlas, text, 0, 0, color);
+
+    SDL_SetRenderTarget(renderer, previousTarget);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+    return texture;
+}
+
+static const LabelEntry* findOrCreate(SDL_Renderer* renderer, LabelCache& cache, GlyphAtlas& atlas, std::string_view text, SDL_Color color) {
+    size_t hash = labelHash(text, &atlas);
+    auto range = cache.lookup.equal_range(hash);
+    for (auto m = range.first; m != range.second; ++m) {
+        auto it = m->second;
+        if (it->atlas == &atlas && sameColor(it->color, color) && it->text == text) {
+            ++cache.hits;
+            cache.entries.splice(cache.entries.begin(), cache.entries, it);
+            return &*it;
+        }
+    }
+
+    ++cache.misses;
+    int w = measureText(atlas, text);
+    int h = atlas.lineHeight;
+    size_t bytes = static_cast<size_t>(w) * static_cast<size_t>(h) * 4;
+    if (w <= 0 || h <= 0 || bytes > cache.maxBytes) {
+        return nullptr;
+    }
+
+    evictToFit(cache, bytes);
+    SDL_Texture* texture = renderLabelTexture(renderer, atlas, text, color, w, h);
+    if (!texture) {
+        return nullptr;
+    }
+
+    cache.entries.push_front({ std::string(text), color, &atlas, hash, texture, w, h, bytes });
+    cache.lookup.emplace(hash, cache.entries.begin());
+    cache.bytesUsed += bytes;
+    return &cache.entries.front();
+}
+
+int drawCachedText(SDL_Renderer* renderer, LabelCache& cache, GlyphAtlas& atlas, std::string_view text, int x, int y, SDL_Color color) {
+    if (text.empty()) return x;
+
+    const LabelEntry* entry = findOrCreate(renderer, cache, atlas, text, color);
+    if (!entry) {
+        // Renderers without target texture support still get the text, just uncached
+        return drawText(renderer, atlas, text, x, y, color);
+    }
+
+    SDL_Rect dst = { x, y, entry->w, entry->h };
+    SDL_RenderCopy(renderer, entry->texture, nullptr, &dst);
+    return x + entry->w;
+}
+
+void drawCachedTextCentered(SDL_Renderer* renderer, LabelCache& cache, GlyphAtlas& atlas, std::string_view text, const SDL_Rect& rect, SDL_Color color) {
+    if (text.empty()) return;
+
+    const LabelEntry* entry = findOrCreate(renderer, cache, atlas, text, color);
+    if (!entry) {
+        drawTextCentered(renderer, atlas, text, rect, color);
+        return;
+    }
+
+    SDL_Rect dst = {
+        rect.x + (rect.w - entry->w) / 2,
+        rect.y + (rect.h - entry->h) / 2,
+        entry->w,
+        entry->h
+    };
+    SDL_RenderCopy(renderer, entry->texture, nullptr, &dst);
+}
+
+void invalidateLabel(LabelCache& cache, std::string_view text) {
+    for (auto it = cache.entries.begin(); it != cache.entries.end();) {
+        auto next = std::next(it);
+        if (it->text == text) {
+            removeEntry(cache, it);
+        }
+        it = next;
+    }
+}
+
+void setLabelCacheLimit(LabelCache& cache, size_t maxBytes) {
+    cache.maxBytes = maxBytes;
+    evictToFit(cache, 0);
+}
+
+void clearLabelCache(LabelCache& cache) {
+    while (!cache.entries.empty()) {
+        removeEntry(cache, cache.entries.begin());
+    }
+}
+
+void printLabelCacheStats(const LabelCache& cache, std::ostream& out) {
+    uint64_t lookups = cache.hits + cache.misses;
+    double hitRate = lookups ? 100.0 * static_cast<double>(cache.hits) / static_cast<double>(lookups) : 0.0;
+    out << "Label cache: " << cache.hits << " hits, " << cache.misses << " misses ("
+        << hitRate << "% hit rate), " << cache.evictions << " evictions, "
+        << cache.entries.size() << " entries using " << cache.bytesUsed << " of " << cache.maxBytes << " bytes" << std::endl;
+}
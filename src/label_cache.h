@@ -0,0 +1,46 @@
+#pragma once
+
+#include <SDL.h>
+#include <cstdint>
+#include <list>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "text_atlas.h"
+
+const size_t LABEL_CACHE_DEFAULT_BYTES = 8 * 1024 * 1024;
+
+struct LabelEntry {
+    std::string text;
+    SDL_Color color;
+    const GlyphAtlas* atlas;   // stands in for the font, one atlas per font and size
+    size_t hash;
+    SDL_Texture* texture;
+    int w, h;
+    size_t bytes;
+};
+
+// Retained textures for whole labels, evicted least-recently-used once bytesUsed goes over maxBytes
+struct LabelCache {
+    std::list<LabelEntry> entries;                    // front is the most recently used
+    std::unordered_multimap<size_t, std::list<LabelEntry>::iterator> lookup;
+    size_t bytesUsed = 0;
+    size_t maxBytes = LABEL_CACHE_DEFAULT_BYTES;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+// Draws text through the cache, rendering it from the atlas into its own texture on a miss.
+// Returns the pen position after the label, like drawText
+int drawCachedText(SDL_Renderer* renderer, LabelCache& cache, GlyphAtlas& atlas, std::string_view text, int x, int y, SDL_Color color);
+void drawCachedTextCentered(SDL_Renderer* renderer, LabelCache& cache, GlyphAtlas& atlas, std::string_view text, const SDL_Rect& rect, SDL_Color color);
+
+// Drops every cached texture for this text, whatever color or font it was drawn with
+void invalidateLabel(LabelCache& cache, std::string_view text);
+void setLabelCacheLimit(LabelCache& cache, size_t maxBytes);
+void clearLabelCache(LabelCache& cache);
+void printLabelCacheStats(const LabelCache& cache, std::ostream& out);
@@ -0,0 +1,300 @@
+#include "legacy_save.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.h"
+#include "trace.h"
+
+void saveToFile(const Vault& vault, const std::string& filename) {
+    TRACE_SCOPE("saveToFile");
+    std::ofstream outFile(filename);
+    if (!outFile) {
+        std::cerr << "Failed to open file for writing: " << filename << std::endl;
+        return;
+    }
+
+    for (size_t i = 0; i < vaultServiceCount(vault); ++i) {
+        std::string_view label = vaultServiceLabel(vault, i);
+        for (size_t a = 0; a < vaultAccountCount(vault, i); ++a) {
+            outFile << label << ";" << vaultAccountName(vault, i, a) << ";" << vaultAccountPassword(vault, i, a) << "\n";
+        }
+        if (vaultAccountCount(vault, i) == 0) {
+            outFile << label << ";;\n";
+        }
+    }
+
+    outFile.close();
+}
+
+// One account line, still pointing into the mapped file
+struct LegacyAccount {
+    uint32_t service;      // index among the services of its chunk, then of the whole file
+    std::string_view name;
+    std::string_view password;
+};
+
+// Open-addressing map from label to service index. Slots keep the label's hash, so growing the
+// table never hashes a label again and almost every mismatch is rejected without a string compare
+struct ServiceDedup {
+    struct Slot {
+        size_t hash;
+        uint32_t service;
+    };
+    static const uint32_t EMPTY = UINT32_MAX;
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+};
+
+static void reserveDedup(ServiceDedup& dedup, size_t services) {
+    size_t capacity = 16;
+    while (capacity < services * 2) capacity *= 2;
+    if (capacity <= dedup.slots.size()) return;
+
+    std::vector<ServiceDedup::Slot> old(capacity, { 0, ServiceDedup::EMPTY });
+    old.swap(dedup.slots);
+    size_t mask = capacity - 1;
+    for (const ServiceDedup::Slot& slot : old) {
+        if (slot.service == ServiceDedup::EMPTY) continue;
+        size_t i = slot.hash & mask;
+        while (dedup.slots[i].service != ServiceDedup::EMPTY) i = (i + 1) & mask;
+        dedup.slots[i] = slot;
+    }
+}
+
+static size_t labelHash(std::string_view label) {
+    return std::hash<std::string_view>{}(label);
+}
+
+// Returns the index of the service with this label, appending it to labels if it is new
+static uint32_t findOrAddService(ServiceDedup& dedup, std::vector<std::string_view>& labels,
+                                 std::string_view label, size_t hash) {
+    if ((dedup.count + 1) * 2 > dedup.slots.size()) {
+        reserveDedup(dedup, dedup.count + 1);
+    }
+
+    size_t mask = dedup.slots.size() - 1;
+    size_t i = hash & mask;
+    while (dedup.slots[i].service != ServiceDedup::EMPTY) {
+        const ServiceDedup::Slot& slot = dedup.slots[i];
+        if (slot.hash == hash && labels[slot.service] == label) {
+            return slot.service;
+        }
+        i = (i + 1) & mask;
+    }
+
+    uint32_t service = static_cast<uint32_t>(labels.size());
+    dedup.slots[i] = { hash, service };
+    ++dedup.count;
+    labels.push_back(label);
+    return service;
+}
+
+// Splits off everything up to the next delimiter. Returns false if there was nothing left to
+// take, the same cases where std::getline(ss, field, delim) fails on the remainder of a line
+static bool nextField(std::string_view& rest, bool& atEnd, char delimiter, std::string_view& field) {
+    if (atEnd || rest.empty()) return false;
+    const char* found = static_cast<const char*>(std::memchr(rest.data(), delimiter, rest.size()));
+    if (!found) {
+        field = rest;
+        rest = {};
+        atEnd = true;
+        return true;
+    }
+    size_t length = static_cast<size_t>(found - rest.data());
+    field = rest.substr(0, length);
+    rest.remove_prefix(length + 1);
+    return true;
+}
+
+// Guesses the number of lines from the first 64 KB, so the account list is sized once up front
+static size_t estimateLines(std::string_view text) {
+    std::string_view sample = text.substr(0, 64 * 1024);
+    size_t lines = 1;
+    size_t pos = 0;
+    while ((pos = sample.find('\n', pos)) != std::string_view::npos) {
+        ++lines;
+        ++pos;
+    }
+    return text.size() / (sample.size() / lines + 1) + lines;
+}
+
+// Services and accounts of one newline-aligned slice of the file. Service indexes are local to
+// the chunk until mergeChunk maps them onto the whole file's services
+struct LegacyChunk {
+    std::string_view text;
+    std::vector<std::string_view> labels;
+    std::vector<size_t> labelHashes;
+    std::vector<uint32_t> accountCounts;
+    std::vector<LegacyAccount> accounts;
+    ServiceDedup dedup;
+    size_t accountBytes = 0;
+};
+
+static uint32_t addChunkService(LegacyChunk& chunk, std::string_view label) {
+    size_t hash = labelHash(label);
+    uint32_t service = findOrAddService(chunk.dedup, chunk.labels, label, hash);
+    if (service == chunk.accountCounts.size()) {
+        chunk.labelHashes.push_back(hash);
+        chunk.accountCounts.push_back(0);
+    }
+    return service;
+}
+
+// Pass 1 only slices the file: labels and accounts are views into the mapping
+static void parseChunk(LegacyChunk& chunk) {
+    TRACE_SCOPE("parse chunk");
+    std::string_view text = chunk.text;
+    chunk.accounts.reserve(estimateLines(text));
+    while (!text.empty()) {
+        const char* newline = static_cast<const char*>(std::memchr(text.data(), '\n', text.size()));
+        size_t lineLength = newline ? static_cast<size_t>(newline - text.data()) : text.size();
+        std::string_view line = text.substr(0, lineLength);
+        text.remove_prefix(newline ? lineLength + 1 : lineLength);
+        // The file was written in text mode on Windows, where CRLF reads back as a plain newline
+        if (newline && !line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        // Same rules as the old getline-based reader: the password is the rest of the line, and a
+        // line without one only declares the service
+        std::string_view rest = line;
+        bool atEnd = false;
+        std::string_view serviceName, accountName, password;
+        bool hasService = nextField(rest, atEnd, ';', serviceName);
+        if (hasService && nextField(rest, atEnd, ';', accountName) && nextField(rest, atEnd, '\n', password)) {
+            uint32_t service = addChunkService(chunk, serviceName);
+            chunk.accounts.push_back({ service, accountName, password });
+            ++chunk.accountCounts[service];
+            chunk.accountBytes += accountName.size() + password.size();
+        } else if (!serviceName.empty()) {
+            addChunkService(chunk, serviceName);
+        }
+    }
+}
+
+// Cuts text into about `count` pieces, each ending just after a newline
+static std::vector<LegacyChunk> splitChunks(std::string_view text, size_t count) {
+    std::vector<LegacyChunk> chunks(count);
+    size_t start = 0;
+    for (size_t c = 0; c < count; ++c) {
+        size_t end = text.size();
+        if (c + 1 < count) {
+            size_t target = std::max(start, text.size() / count * (c + 1));
+            size_t newline = text.find('\n', target);
+            end = newline == std::string_view::npos ? text.size() : newline + 1;
+        }
+        chunks[c].text = text.substr(start, end - start);
+        start = end;
+    }
+    return chunks;
+}
+
+// Large files are parsed on several threads; small ones aren't worth starting a thread for
+static size_t chunkCount(size_t fileSize) {
+    const size_t minChunkBytes = 4 * 1024 * 1024;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    return std::max<size_t>(1, std::min(threads, fileSize / minChunkBytes));
+}
+
+// The whole file's service table. Services get their index in order of first appearance, so
+// merging the chunks in file order gives the same numbering a single pass would
+struct LegacyServices {
+    std::vector<std::string_view> labels;
+    std::vector<uint32_t> accountCounts;
+    ServiceDedup dedup;
+    size_t poolBytes = 0;
+};
+
+// Rewrites the chunk's accounts to point at whole-file service indexes
+static void mergeChunk(LegacyServices& services, LegacyChunk& chunk) {
+    TRACE_SCOPE("merge chunk");
+    std::vector<uint32_t> toService(chunk.labels.size());
+    for (size_t i = 0; i < chunk.labels.size(); ++i) {
+        uint32_t service = findOrAddService(services.dedup, services.labels, chunk.labels[i], chunk.labelHashes[i]);
+        if (service == services.accountCounts.size()) {
+            services.accountCounts.push_back(0);
+            services.poolBytes += chunk.labels[i].size();
+        }
+        services.accountCounts[service] += chunk.accountCounts[i];
+        toService[i] = service;
+    }
+    for (LegacyAccount& account : chunk.accounts) {
+        account.service = toService[account.service];
+    }
+    services.poolBytes += chunk.accountBytes;
+}
+
+bool loadFromFile(Vault& vault, const std::string& filename, size_t expectedServices) {
+    TRACE_SCOPE("loadFromFile");
+    MappedFile file;
+    if (!mapFile(file, filename)) {
+        std::cerr << "No existing file to load: " << filename << std::endl;
+        return false;
+    }
+
+    std::string_view text(file.data, file.size);
+    std::vector<LegacyChunk> chunks = splitChunks(text, chunkCount(text.size()));
+    std::vector<std::thread> workers;
+    for (size_t c = 1; c < chunks.size(); ++c) {
+        workers.emplace_back([&chunk = chunks[c]]() {
+            setTraceThreadName("save.txt parser");
+            parseChunk(chunk);
+        });
+    }
+    parseChunk(chunks[0]);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    LegacyServices services;
+    reserveDedup(services.dedup, expectedServices);
+    services.labels.reserve(expectedServices);
+    services.accountCounts.reserve(expectedServices);
+    size_t accountCount = 0;
+    for (LegacyChunk& chunk : chunks) {
+        mergeChunk(services, chunk);
+        accountCount += chunk.accounts.size();
+    }
+
+    // Pass 2 groups the accounts by service so each service's range is laid out once, in file order
+    const std::vector<std::string_view>& labels = services.labels;
+    std::vector<uint32_t> firstAccount(labels.size() + 1, 0);
+    for (size_t i = 0; i < labels.size(); ++i) {
+        firstAccount[i + 1] = firstAccount[i] + services.accountCounts[i];
+    }
+    std::vector<const LegacyAccount*> order(accountCount);
+    std::vector<uint32_t> next(firstAccount.begin(), firstAccount.end() - 1);
+    for (const LegacyChunk& chunk : chunks) {
+        for (const LegacyAccount& account : chunk.accounts) {
+            order[next[account.service]++] = &account;
+        }
+    }
+
+    if (services.poolBytes > VAULT_MAX_POOL_BYTES - vault.pool.size()) {
+        std::cerr << "Too much text to load from " << filename << ", the vault holds at most "
+                  << VAULT_MAX_POOL_BYTES << " bytes" << std::endl;
+        unmapFile(file);
+        return false;
+    }
+    size_t base = vaultServiceCount(vault);
+    reserveVault(vault, base + labels.size(),
+                 vault.accountNames.size() + accountCount,
+                 vault.pool.size() + services.poolBytes);
+    for (size_t i = 0; i < labels.size(); ++i) {
+        vaultAddService(vault, labels[i]);
+        for (uint32_t a = firstAccount[i]; a < firstAccount[i + 1]; ++a) {
+            vaultAddAccount(vault, base + i, order[a]->name, order[a]->password);
+        }
+    }
+
+    unmapFile(file);
+    return true;
+}
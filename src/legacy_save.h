@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+#include "vault.h"
+
+// The original semicolon-delimited save.txt format: one "label;account;password" line per account
+void saveToFile(const Vault& vault, const std::string& filename);
+// Appends the file's services to vault. The format has no header, so callers that know roughly
+// how many services to expect can pass it to size the service tables once. Fails without
+// touching vault if the file can't be read or its strings don't fit in the vault's pool
+bool loadFromFile(Vault& vault, const std::string& filename, size_t expectedServices = 0);
@@ -1,41 +1,40 @@
-//TODO: make a search bar for services/accounts (*)
 //TODO: unite getServiceNameInput and getMultipleTextInput into one function (also structures MultiInputResult and ServiceInputResult unite into one structure)
 //TODO: make it, so all buttons, heights, widths and placement is connected to WIDTH and HEIGHT of the window (there should be relativity everywhere to WIDTH and HEIGHT)
 //TODO: make this more universal code by adding specified int and char types like int8
-//TODO: make this available for linux (?)
 //TODO: make a better visuals altogether :D
 
 #include <SDL.h>
 #include <SDL_ttf.h>
 #include <vector>
+#include <algorithm>
 #include <string>
+#include <string_view>
+#include <cstdlib>
 #include <iostream>
-#include <fstream>
-#include <sstream>
-#include <unordered_map>
-#include <windows.h>
 
+#include "frame_stats.h"
+#include "input_log.h"
+#include "text_atlas.h"
+#include "label_cache.h"
+#include "password_transform.h"
+#include "redraw.h"
+#include "search.h"
+#include "secure_alloc.h"
+#include "trace.h"
+#include "virtual_list.h"
+#include "vault.h"
+#include "vault_store.h"
+#include "views.h"
 
-const int WINDOW_WIDTH = 400;
-const int WINDOW_HEIGHT = 700;
-const int MAX_CHARACTERS = 20;
-const char PATH_SAVE[9] = "save.txt";
-
-struct Account {
-    std::string accountName;
-    std::string password;
-
-};
-
-struct Service {
-    std::string label;
-    std::vector<Account> accounts;
 
-};
+const int MAX_CHARACTERS = 20;
+const size_t MAX_PASSPHRASE_CHARACTERS = 64;
+const Uint32 COPIED_FEEDBACK_MS = 1500;
 
 struct MultiInputResult {
     bool submitted;
-    Account account;
+    std::string accountName;
+    std::string password;
 };
 
 struct ServiceInputResult {
@@ -43,7 +42,7 @@ struct ServiceInputResult {
     std::string label;
 };
 
-ServiceInputResult getServiceNameInput(SDL_Renderer* renderer, TTF_Font* font) {
+ServiceInputResult getServiceNameInput(SDL_Renderer* renderer, GlyphAtlas& atlas) {
     SDL_StartTextInput();
 
     std::string inputText;
@@ -60,8 +59,12 @@ ServiceInputResult getServiceNameInput(SDL_Renderer* renderer, TTF_Font* font) {
     // Define rectangles for input boxes stacked vertically
     SDL_Rect inputRect = { 50, 290, 300, 50 };
 
+    RedrawState redraw;
     while (!done && !submitted) {
-        while (SDL_PollEvent(&e)) {
+        waitForInput(redraw);
+        TRACE_SCOPE("service name input");
+        while (pollInput(&e)) {
+            noteEvent(redraw, e);
             if (e.type == SDL_QUIT) {
                 done = true;
             }
@@ -83,6 +86,9 @@ ServiceInputResult getServiceNameInput(SDL_Renderer* renderer, TTF_Font* font) {
             }
         }
 
+        if (!redraw.dirty) continue;
+        redraw.dirty = false;
+
         // Clear screen
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderClear(renderer);
@@ -94,28 +100,101 @@ ServiceInputResult getServiceNameInput(SDL_Renderer* renderer, TTF_Font* font) {
         SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
         SDL_RenderDrawRect(renderer, &inputRect);
         // Render text or placeholder
-        const std::string& textToRender = (inputText.empty()) ? placeholder : inputText;
+        std::string_view textToRender = (inputText.empty()) ? std::string_view(placeholder) : std::string_view(inputText);
         SDL_Color colorToUse = (inputText.empty()) ? placeholderColor : textColor;
 
-        std::string displayText = textToRender;
+        std::string_view displayText = textToRender;
 
-        SDL_Surface* textSurf = TTF_RenderText_Blended(font, displayText.c_str(), colorToUse);
-        SDL_Texture* textTex = SDL_CreateTextureFromSurface(renderer, textSurf);
-        SDL_Rect textRect = { inputRect.x + 5, inputRect.y + 10, textSurf->w, textSurf->h };
-        SDL_RenderCopy(renderer, textTex, nullptr, &textRect);
-        SDL_FreeSurface(textSurf);
-        SDL_DestroyTexture(textTex);
+        drawText(renderer, atlas, displayText, inputRect.x + 5, inputRect.y + 10, colorToUse);
 
         SDL_RenderPresent(renderer);
-        SDL_Delay(16);
     }
 
     SDL_StopTextInput();
     return { submitted, inputText };
 }
 
+// Asks for the vault passphrase, showing a dot per character. It reads SDL directly rather than
+// through pollInput, so the passphrase never ends up in a recorded input log
+bool getPassphraseInput(SDL_Renderer* renderer, GlyphAtlas& atlas, const char* prompt, SecureString& passphrase) {
+    SDL_StartTextInput();
+    passphrase.clear();
+    bool done = false;
+    bool submitted = false;
+    SDL_Event e;
+
+    SDL_Color textColor = { 255, 255, 255, 255 };
+    SDL_Color placeholderColor = { 150, 150, 150, 255 };
+    SDL_Rect inputRect = { 50, 290, 300, 50 };
+    SecureString dots;
 
-MultiInputResult getMultipleTextInput(SDL_Renderer* renderer, TTF_Font* font, int maxLen = 20) {
+    bool dirty = true;
+    while (!done && !submitted) {
+        if (!dirty) {
+            SDL_WaitEvent(nullptr);
+        }
+        while (SDL_PollEvent(&e)) {
+            dirty = true;
+            if (e.type == SDL_QUIT) {
+                done = true;
+            }
+            else if (e.type == SDL_TEXTINPUT) {
+                if (passphrase.size() < MAX_PASSPHRASE_CHARACTERS) {
+                    passphrase += e.text.text;
+                }
+                secureWipe(e.text.text, sizeof(e.text.text));
+            }
+            else if (e.type == SDL_KEYDOWN) {
+                if (e.key.keysym.sym == SDLK_BACKSPACE && !passphrase.empty()) {
+                    // Drops a whole UTF-8 character, not just its last byte
+                    while (!passphrase.empty() && (passphrase.back() & 0xC0) == 0x80) passphrase.pop_back();
+                    if (!passphrase.empty()) passphrase.pop_back();
+                }
+                else if (e.key.keysym.sym == SDLK_RETURN && !passphrase.empty()) {
+                    submitted = true;
+                }
+                else if (e.key.keysym.sym == SDLK_ESCAPE) {
+                    done = true;
+                }
+            }
+        }
+
+        if (!dirty) continue;
+        dirty = false;
+
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        drawText(renderer, atlas, prompt, inputRect.x, inputRect.y - 30, textColor);
+
+        SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
+        SDL_RenderFillRect(renderer, &inputRect);
+        SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+        SDL_RenderDrawRect(renderer, &inputRect);
+
+        size_t characters = 0;
+        for (char c : passphrase) {
+            if ((c & 0xC0) != 0x80) ++characters;
+        }
+        dots.assign(characters, '*');
+        if (dots.empty()) {
+            drawText(renderer, atlas, "Passphrase", inputRect.x + 5, inputRect.y + 10, placeholderColor);
+        } else {
+            drawText(renderer, atlas, dots, inputRect.x + 5, inputRect.y + 10, textColor);
+        }
+
+        SDL_RenderPresent(renderer);
+    }
+
+    SDL_StopTextInput();
+    if (!submitted) {
+        secureWipe(&passphrase[0], passphrase.size());
+        passphrase.clear();
+    }
+    return submitted;
+}
+
+
+MultiInputResult getMultipleTextInput(SDL_Renderer* renderer, GlyphAtlas& atlas, LabelCache& labels, int maxLen = 20) {
     SDL_StartTextInput();
 
     std::string inputs[2] = { "", "" };
@@ -137,8 +216,12 @@ MultiInputResult getMultipleTextInput(SDL_Renderer* renderer, TTF_Font* font, in
         { 50, 360, 300, 50 }
     };
 
+    RedrawState redraw;
     while (!done && !canceled) {
-        while (SDL_PollEvent(&e)) {
+        waitForInput(redraw);
+        TRACE_SCOPE("account input");
+        while (pollInput(&e)) {
+            noteEvent(redraw, e);
             if (e.type == SDL_QUIT) {
                 canceled = true;
             }
@@ -159,10 +242,15 @@ MultiInputResult getMultipleTextInput(SDL_Renderer* renderer, TTF_Font* font, in
                 }
                 else if (e.key.keysym.sym == SDLK_TAB) {
                     activeInput = (activeInput + 1) % 2;
+                    // Takes effect for the next event polled, so what is typed into Password isn't logged
+                    setInputLogSecret(activeInput == 1);
                 }
             }
         }
 
+        if (!redraw.dirty) continue;
+        redraw.dirty = false;
+
         // Clear screen
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderClear(renderer);
@@ -182,46 +270,36 @@ MultiInputResult getMultipleTextInput(SDL_Renderer* renderer, TTF_Font* font, in
             SDL_RenderDrawRect(renderer, &inputRects[i]);
 
             // Render text or placeholder
-            const std::string& textToRender = (inputs[i].empty()) ? placeholders[i] : inputs[i];
+            std::string_view textToRender = (inputs[i].empty()) ? std::string_view(placeholders[i]) : std::string_view(inputs[i]);
             SDL_Color colorToUse = (inputs[i].empty()) ? placeholderColor : textColor;
 
-            std::string displayText = textToRender;
+            std::string_view displayText = textToRender;
             // For password field (index 2), mask text with '*'
             // if (i == 1 && !inputs[i].empty()) {
             //     displayText = std::string(inputs[i].size(), '*');
             // }
 
-            SDL_Surface* textSurf = TTF_RenderText_Blended(font, displayText.c_str(), colorToUse);
-            SDL_Texture* textTex = SDL_CreateTextureFromSurface(renderer, textSurf);
-            SDL_Rect textRect = { inputRects[i].x + 5, inputRects[i].y + 10, textSurf->w, textSurf->h };
-            SDL_RenderCopy(renderer, textTex, nullptr, &textRect);
-            SDL_FreeSurface(textSurf);
-            SDL_DestroyTexture(textTex);
+            drawText(renderer, atlas, displayText, inputRects[i].x + 5, inputRects[i].y + 10, colorToUse);
         }
 
         // Draw instruction at bottom
         const char* instruction = "Press Enter to submit, Esc to cancel, Tab to switch fields";
-        SDL_Surface* instrSurf = TTF_RenderText_Blended(font, instruction, textColor);
-        SDL_Texture* instrTex = SDL_CreateTextureFromSurface(renderer, instrSurf);
-        SDL_Rect instrRect = { 50, 430, instrSurf->w, instrSurf->h };
-        SDL_RenderCopy(renderer, instrTex, nullptr, &instrRect);
-        SDL_FreeSurface(instrSurf);
-        SDL_DestroyTexture(instrTex);
+        drawCachedText(renderer, labels, atlas, instruction, 50, 430, textColor);
 
         SDL_RenderPresent(renderer);
-        SDL_Delay(16);
     }
 
     SDL_StopTextInput();
+    setInputLogSecret(false);
 
     if (canceled) {
         return { false, "", "" };
     } else {
-        return { true, Account{inputs[0], inputs[1]} };
+        return { true, inputs[0], inputs[1] };
     }
 }
 
-bool showDeleteConfirmation(SDL_Renderer* renderer, TTF_Font* font, const std::string& message) {
+bool showDeleteConfirmation(SDL_Renderer* renderer, GlyphAtlas& atlas, LabelCache& labels, const std::string& message) {
     bool confirmed = false;
     bool waiting = true;
 
@@ -233,8 +311,12 @@ bool showDeleteConfirmation(SDL_Renderer* renderer, TTF_Font* font, const std::s
     SDL_Color bgColor = { 40, 40, 40, 255 };
 
     SDL_Event e;
+    RedrawState redraw;
     while (waiting) {
-        while (SDL_PollEvent(&e)) {
+        waitForInput(redraw);
+        TRACE_SCOPE("delete confirmation");
+        while (pollInput(&e)) {
+            noteEvent(redraw, e);
             if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE)) {
                 waiting = false;
             }
@@ -256,6 +338,9 @@ bool showDeleteConfirmation(SDL_Renderer* renderer, TTF_Font* font, const std::s
             }
         }
 
+        if (!redraw.dirty) continue;
+        redraw.dirty = false;
+
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
         SDL_RenderFillRect(renderer, nullptr);
 
@@ -264,17 +349,8 @@ bool showDeleteConfirmation(SDL_Renderer* renderer, TTF_Font* font, const std::s
         SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
         SDL_RenderDrawRect(renderer, &popupRect);
 
-        SDL_Surface* msgSurf = TTF_RenderText_Blended_Wrapped(font, message.c_str(), white, popupRect.w - 20);
-        SDL_Texture* msgTex = SDL_CreateTextureFromSurface(renderer, msgSurf);
-        SDL_Rect msgRect = {
-            popupRect.x + (popupRect.w - msgSurf->w) / 2,
-            popupRect.y + 20,
-            msgSurf->w,
-            msgSurf->h
-        };
-        SDL_RenderCopy(renderer, msgTex, nullptr, &msgRect);
-        SDL_FreeSurface(msgSurf);
-        SDL_DestroyTexture(msgTex);
+        SDL_Rect msgRect = { popupRect.x, popupRect.y + 20, popupRect.w, 0 };
+        drawTextWrapped(renderer, atlas, message, msgRect, popupRect.w - 20, white);
 
         // Yes Button
         SDL_SetRenderDrawColor(renderer, 34, 139, 34, 255);
@@ -282,17 +358,7 @@ bool showDeleteConfirmation(SDL_Renderer* renderer, TTF_Font* font, const std::s
         SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
         SDL_RenderDrawRect(renderer, &yesBtn);
 
-        SDL_Surface* yesSurf = TTF_RenderText_Blended(font, "Yes", white);
-        SDL_Texture* yesTex = SDL_CreateTextureFromSurface(renderer, yesSurf);
-        SDL_Rect yesRect = {
-            yesBtn.x + (yesBtn.w - yesSurf->w) / 2,
-            yesBtn.y + (yesBtn.h - yesSurf->h) / 2,
-            yesSurf->w,
-            yesSurf->h
-        };
-        SDL_RenderCopy(renderer, yesTex, nullptr, &yesRect);
-        SDL_FreeSurface(yesSurf);
-        SDL_DestroyTexture(yesTex);
+        drawCachedTextCentered(renderer, labels, atlas, "Yes", yesBtn, white);
 
         // No Button
         SDL_SetRenderDrawColor(renderer, 200, 50, 50, 255);
@@ -300,47 +366,37 @@ bool showDeleteConfirmation(SDL_Renderer* renderer, TTF_Font* font, const std::s
         SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
         SDL_RenderDrawRect(renderer, &noBtn);
 
-        SDL_Surface* noSurf = TTF_RenderText_Blended(font, "No", white);
-        SDL_Texture* noTex = SDL_CreateTextureFromSurface(renderer, noSurf);
-        SDL_Rect noRect = {
-            noBtn.x + (noBtn.w - noSurf->w) / 2,
-            noBtn.y + (noBtn.h - noSurf->h) / 2,
-            noSurf->w,
-            noSurf->h
-        };
-        SDL_RenderCopy(renderer, noTex, nullptr, &noRect);
-        SDL_FreeSurface(noSurf);
-        SDL_DestroyTexture(noTex);
+        drawCachedTextCentered(renderer, labels, atlas, "No", noBtn, white);
 
         SDL_RenderPresent(renderer);
-        SDL_Delay(16);
     }
 
     return confirmed;
 }
 
-bool showServiceDetailsPopup(SDL_Renderer* renderer, TTF_Font* font, Service& service) {
+bool showServiceDetailsPopup(SDL_Renderer* renderer, GlyphAtlas& atlas, LabelCache& labels, VaultStore& store,
+                             const TransformProgram* transform, std::string_view transformError, size_t serviceIndex) {
+    storeLoadService(store, serviceIndex);
+    const Vault& vault = store.vault;
     bool done = false;
     int scrollOffset = 0;
-    const int blockHeight = 120;
-    const int spacing = 10;
     bool deleteService = false;
+    int copiedIndex = -1;
+    Uint32 copiedUntil = 0;
 
-
-
-    int paddingY = 20;
-    int paddingX = 50;
-    int btnHeight = 50;
-    int btnWidth = 300;
-
-    SDL_Rect addAccountBtn = { paddingX, WINDOW_HEIGHT - paddingY - btnHeight, btnWidth, btnHeight };
-    SDL_Rect deleteServiceBtn = { addAccountBtn.x, addAccountBtn.y - addAccountBtn.h - paddingY, addAccountBtn.w, addAccountBtn.h };
+    DetailsLayout layout = detailsLayout();
+    const VirtualList& accountList = layout.accountList;
+    const SDL_Rect& addAccountBtn = layout.addAccountBtn;
+    const SDL_Rect& deleteServiceBtn = layout.deleteServiceBtn;
 
     SDL_Event e;
-    SDL_Color white = { 255, 255, 255, 255 };
 
+    RedrawState redraw;
     while (!done) {
-        while (SDL_PollEvent(&e)) {
+        waitForInput(redraw);
+        TRACE_SCOPE("service details");
+        while (pollInput(&e)) {
+            noteEvent(redraw, e);
             if (e.type == SDL_QUIT) {
                 done = true;
             }
@@ -349,7 +405,7 @@ bool showServiceDetailsPopup(SDL_Renderer* renderer, TTF_Font* font, Service& se
             }
             else if (e.type == SDL_MOUSEWHEEL) {
                 scrollOffset -= e.wheel.y * 20;
-                if (scrollOffset < 0) scrollOffset = 0;
+                scrollOffset = std::clamp(scrollOffset, 0, maxScrollOffset(accountList, vaultAccountCount(vault, serviceIndex)));
             }
             else if (e.type == SDL_MOUSEBUTTONDOWN) {
                 int mx = e.button.x;
@@ -357,39 +413,44 @@ bool showServiceDetailsPopup(SDL_Renderer* renderer, TTF_Font* font, Service& se
 
                 if (mx >= addAccountBtn.x && mx <= addAccountBtn.x + addAccountBtn.w &&
                     my >= addAccountBtn.y && my <= addAccountBtn.y + addAccountBtn.h) {
-                    MultiInputResult result = getMultipleTextInput(renderer, font, 20);
+                    MultiInputResult result = getMultipleTextInput(renderer, atlas, labels, 20);
                     if (result.submitted) {
-                        service.accounts.push_back(result.account);
+                        storeAddAccount(store, serviceIndex, result.accountName, result.password);
                     }
                 }
 
-                if (!service.accounts.empty()) {
-                    // Check Delete and Copy buttons for each account
-                    for (size_t i = 0; i < service.accounts.size(); ++i) {
-                        int y = 80 + static_cast<int>(i) * (blockHeight + spacing) - scrollOffset;
-                        SDL_Rect deleteBtn = { 80, y + 60, 80, 30 };
-                        SDL_Rect copyBtn = { 200, y + 60, 80, 30 };
+                if (vaultAccountCount(vault, serviceIndex) > 0) {
+                    // Only the account block under the cursor can own the Delete or Copy button that was hit
+                    size_t i = hitTestRow(accountList, vaultAccountCount(vault, serviceIndex), scrollOffset, mx, my);
+                    if (i != NO_ROW) {
+                        SDL_Rect blockRect = rowRect(accountList, i, scrollOffset);
+                        SDL_Rect deleteBtn = accountDeleteButton(blockRect);
+                        SDL_Rect copyBtn = accountCopyButton(blockRect);
 
                         if (mx >= deleteBtn.x && mx <= deleteBtn.x + deleteBtn.w &&
                             my >= deleteBtn.y && my <= deleteBtn.y + deleteBtn.h) {
-                            if (showDeleteConfirmation(renderer, font, "Are you sure you want to delete this account?")) {
-                                service.accounts.erase(service.accounts.begin() + i);
+                            if (showDeleteConfirmation(renderer, atlas, labels, "Are you sure you want to delete this account?")) {
+                                invalidateLabel(labels, vaultAccountName(vault, serviceIndex, i));
+                                storeDeleteAccount(store, serviceIndex, i);
+                                copiedIndex = -1;
                             }
-
-                            break;
                         }
-
-                        if (mx >= copyBtn.x && mx <= copyBtn.x + copyBtn.w &&
-                            my >= copyBtn.y && my <= copyBtn.y + copyBtn.h) {
-                            SDL_SetClipboardText(service.accounts[i].password.c_str());
+                        else if (transform && mx >= copyBtn.x && mx <= copyBtn.x + copyBtn.w &&
+                                 my >= copyBtn.y && my <= copyBtn.y + copyBtn.h) {
+                            // The clipboard gets the transformed password, the vault only ever holds the simple one
+                            SecureString password;
+                            transformPassword(*transform, vaultAccountPassword(vault, serviceIndex, i), password);
+                            SDL_SetClipboardText(password.c_str());
+                            // The button reads "Copied!" until the timer wakes the loop up again
+                            copiedIndex = static_cast<int>(i);
+                            copiedUntil = inputTicks() + COPIED_FEEDBACK_MS;
+                            scheduleRedraw(redraw, COPIED_FEEDBACK_MS);
                         }
                     }
-
-
                 } else {
                     if (mx >= deleteServiceBtn.x && mx <= deleteServiceBtn.x + deleteServiceBtn.w &&
                         my >= deleteServiceBtn.y && my <= deleteServiceBtn.y + deleteServiceBtn.h) {
-                        if (showDeleteConfirmation(renderer, font, "Are you sure you want to delete this service?")) {
+                        if (showDeleteConfirmation(renderer, atlas, labels, "Are you sure you want to delete this service?")) {
                             deleteService = true;
                             done = true;
                         }
@@ -398,193 +459,51 @@ bool showServiceDetailsPopup(SDL_Renderer* renderer, TTF_Font* font, Service& se
             }
         }
 
-        // Background
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
-        SDL_RenderFillRect(renderer, nullptr);
-
-        // Title
-        std::string title = "Service: " + service.label;
-        SDL_Surface* titleSurf = TTF_RenderText_Blended(font, title.c_str(), white);
-        SDL_Texture* titleTex = SDL_CreateTextureFromSurface(renderer, titleSurf);
-        SDL_Rect titleRect = { 60, 30, titleSurf->w, titleSurf->h };
-        SDL_RenderCopy(renderer, titleTex, nullptr, &titleRect);
-        SDL_FreeSurface(titleSurf);
-        SDL_DestroyTexture(titleTex);
-
-        // Add Account button
-        SDL_SetRenderDrawColor(renderer, 34, 139, 34, 255);
-        SDL_RenderFillRect(renderer, &addAccountBtn);
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        SDL_RenderDrawRect(renderer, &addAccountBtn);
-
-        SDL_Surface* addTextSurf = TTF_RenderText_Blended(font, "Add Account", white);
-        SDL_Texture* addTextTex = SDL_CreateTextureFromSurface(renderer, addTextSurf);
-        SDL_Rect addTextRect = {
-            addAccountBtn.x + (addAccountBtn.w - addTextSurf->w) / 2,
-            addAccountBtn.y + (addAccountBtn.h - addTextSurf->h) / 2,
-            addTextSurf->w,
-            addTextSurf->h
-        };
-        SDL_RenderCopy(renderer, addTextTex, nullptr, &addTextRect);
-        SDL_FreeSurface(addTextSurf);
-        SDL_DestroyTexture(addTextTex);
-
-        if (!service.accounts.empty()) {
-            for (size_t i = 0; i < service.accounts.size(); ++i) {
-                int y = 80 + static_cast<int>(i) * (blockHeight + spacing) - scrollOffset;
-                if (y + blockHeight < 0 || y > 700) continue;
-
-                SDL_Rect blockRect = { 50, y, 300, blockHeight };
-                SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
-                SDL_RenderFillRect(renderer, &blockRect);
-                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-                SDL_RenderDrawRect(renderer, &blockRect);
-
-                std::string accountStr = "Account: " + service.accounts[i].accountName;
-                std::string passwordStr = "Password: " + service.accounts[i].password;
-
-                SDL_Surface* accSurf = TTF_RenderText_Blended(font, accountStr.c_str(), white);
-                SDL_Texture* accTex = SDL_CreateTextureFromSurface(renderer, accSurf);
-                SDL_Rect accRect = { blockRect.x + 10, blockRect.y + 10, accSurf->w, accSurf->h };
-                SDL_RenderCopy(renderer, accTex, nullptr, &accRect);
-                SDL_FreeSurface(accSurf);
-                SDL_DestroyTexture(accTex);
-
-                SDL_Surface* passSurf = TTF_RenderText_Blended(font, passwordStr.c_str(), white);
-                SDL_Texture* passTex = SDL_CreateTextureFromSurface(renderer, passSurf);
-                SDL_Rect passRect = { blockRect.x + 10, blockRect.y + 35, passSurf->w, passSurf->h };
-                SDL_RenderCopy(renderer, passTex, nullptr, &passRect);
-                SDL_FreeSurface(passSurf);
-                SDL_DestroyTexture(passTex);
-
-                SDL_Rect deleteBtn = { blockRect.x + 30, blockRect.y + 70, 80, 30 };
-                SDL_SetRenderDrawColor(renderer, 200, 50, 50, 255);
-                SDL_RenderFillRect(renderer, &deleteBtn);
-                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-                SDL_RenderDrawRect(renderer, &deleteBtn);
-
-                SDL_Surface* delSurf = TTF_RenderText_Blended(font, "Delete", white);
-                SDL_Texture* delTex = SDL_CreateTextureFromSurface(renderer, delSurf);
-                SDL_Rect delRect = {
-                    deleteBtn.x + (deleteBtn.w - delSurf->w) / 2,
-                    deleteBtn.y + (deleteBtn.h - delSurf->h) / 2,
-                    delSurf->w,
-                    delSurf->h
-                };
-                SDL_RenderCopy(renderer, delTex, nullptr, &delRect);
-                SDL_FreeSurface(delSurf);
-                SDL_DestroyTexture(delTex);
-
-                SDL_Rect copyBtn = { blockRect.x + 150, blockRect.y + 70, 80, 30 };
-                SDL_SetRenderDrawColor(renderer, 50, 150, 200, 255);
-                SDL_RenderFillRect(renderer, &copyBtn);
-                SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-                SDL_RenderDrawRect(renderer, &copyBtn);
-
-                SDL_Surface* copySurf = TTF_RenderText_Blended(font, "Copy", white);
-                SDL_Texture* copyTex = SDL_CreateTextureFromSurface(renderer, copySurf);
-                SDL_Rect copyRect = {
-                    copyBtn.x + (copyBtn.w - copySurf->w) / 2,
-                    copyBtn.y + (copyBtn.h - copySurf->h) / 2,
-                    copySurf->w,
-                    copySurf->h
-                };
-                SDL_RenderCopy(renderer, copyTex, nullptr, &copyRect);
-                SDL_FreeSurface(copySurf);
-                SDL_DestroyTexture(copyTex);
-            }
-
-
+        if (!redraw.dirty) continue;
+        redraw.dirty = false;
 
-        } else {
-            // Delete Service button (no accounts case)
-            SDL_SetRenderDrawColor(renderer, 200, 50, 50, 255);
-            SDL_RenderFillRect(renderer, &deleteServiceBtn);
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            SDL_RenderDrawRect(renderer, &deleteServiceBtn);
-
-            SDL_Surface* delServText = TTF_RenderText_Blended(font, "Delete Service", white);
-            SDL_Texture* delServTex = SDL_CreateTextureFromSurface(renderer, delServText);
-            SDL_Rect delServRect = {
-                deleteServiceBtn.x + (deleteServiceBtn.w - delServText->w) / 2,
-                deleteServiceBtn.y + (deleteServiceBtn.h - delServText->h) / 2,
-                delServText->w,
-                delServText->h
-            };
-            SDL_RenderCopy(renderer, delServTex, nullptr, &delServRect);
-            SDL_FreeSurface(delServText);
-            SDL_DestroyTexture(delServTex);
+        if (copiedIndex >= 0 && SDL_TICKS_PASSED(inputTicks(), copiedUntil)) {
+            copiedIndex = -1;
         }
+        // Deleting accounts can leave the offset past the end of the shorter list
+        scrollOffset = std::min(scrollOffset, maxScrollOffset(accountList, vaultAccountCount(vault, serviceIndex)));
 
+        drawDetailsFrame(renderer, atlas, labels, layout, vault, serviceIndex, scrollOffset, copiedIndex, transformError);
         SDL_RenderPresent(renderer);
-        SDL_Delay(16);
     }
 
     return deleteService;
 }
 
-void saveToFile(const std::vector<Service>& services, const std::string& filename) {
-    std::ofstream outFile(filename);
-    if (!outFile) {
-        std::cerr << "Failed to open file for writing: " << filename << std::endl;
-        return;
-    }
-
-    for (const auto& service : services) {
-        for (const auto& account : service.accounts) {
-            outFile << service.label << ";" << account.accountName << ";" << account.password << "\n";
-        }
-        if (service.accounts.size() == 0) {
-            outFile << service.label << ";;";
-        }
-    }
-
-    outFile.close();
-}
-
-void loadFromFile(std::vector<Service>& services, const std::string& filename) {
-    std::ifstream inFile(filename);
-    if (!inFile) {
-        std::cerr << "No existing file to load: " << filename << std::endl;
-        return;
-    }
-
-    std::unordered_map<std::string, Service*> serviceMap;
-    std::string line;
-
-    while (std::getline(inFile, line)) {
-        std::stringstream ss(line);
-        std::string serviceName, accountName, password;
-
-        if (std::getline(ss, serviceName, ';') &&
-            std::getline(ss, accountName, ';') &&
-            std::getline(ss, password)) {
-
-            if (serviceMap.find(serviceName) == serviceMap.end()) {
-                services.emplace_back(Service{serviceName});
-                serviceMap[serviceName] = &services.back();
-            }
-
-            serviceMap[serviceName]->accounts.push_back({accountName, password});
-        } else if (serviceName.size() != 0) {
-            if (serviceMap.find(serviceName) == serviceMap.end()) {
-                services.emplace_back(Service{serviceName});
-                serviceMap[serviceName] = &services.back();
-            }
-        }
-    }
-
-    inFile.close();
-}
-
-// used to be main(), but since I decided to use windows.h to remove console, so it needed to be changed
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nShowCmd)
+// SDL2main turns this into WinMain on Windows, where WIN32_EXECUTABLE keeps the console away
+int main(int argc, char* argv[])
 {
+    // NOTEBOOK_TRACE=<file> records a Chrome trace from startup and writes it on exit; F4 writes
+    // one at any point, turning tracing on first if it was off
+    const char* traceEnv = std::getenv("NOTEBOOK_TRACE");
+    std::string tracePath = traceEnv ? traceEnv : "notebook_trace.json";
+    setTraceEnabled(traceEnv != nullptr);
+    setTraceThreadName("main");
+
     SDL_Init(SDL_INIT_VIDEO);
     TTF_Init();
 
     SDL_Window* window = SDL_CreateWindow("Fixed Size Window", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_SHOWN);
     SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    if (!renderer) {
+        // Headless replays run on SDL_VIDEODRIVER=dummy, which only has the software renderer
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
+    }
+
+    // NOTEBOOK_RECORD=<file> logs this session's input, NOTEBOOK_REPLAY=<file> plays a log back
+    // instead of reading the keyboard and mouse, see input_log.h
+    const char* replayEnv = std::getenv("NOTEBOOK_REPLAY");
+    const char* recordEnv = std::getenv("NOTEBOOK_RECORD");
+    if (replayEnv) {
+        if (!startInputReplay(replayEnv)) return 1;
+    } else if (recordEnv) {
+        startInputRecording(recordEnv);
+    }
 
     TTF_Font* font = TTF_OpenFont("assets/fonts/Oswald-VariableFont_wght.ttf", 16);
     if (!font) {
@@ -592,35 +511,160 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         return 1;
     }
 
-    std::vector<Service> services;
-    loadFromFile(services, PATH_SAVE);
+    // Every glyph is rasterized once here, text drawing after this point never touches TTF_Render*
+    GlyphAtlas atlas;
+    if (!createGlyphAtlas(atlas, renderer, font)) {
+        return 1;
+    }
+    LabelCache labels;
+
+    // Edits are journaled as they happen, so nothing is lost if the app doesn't exit cleanly
+    // NOTEBOOK_DIR points the app at another vault, e.g. one made by vault_gen for a replay.
+    // NOTEBOOK_PASSPHRASE skips the prompt, which replays need since the prompt is never recorded
+    const char* directoryEnv = std::getenv("NOTEBOOK_DIR");
+    const char* passphraseEnv = std::getenv("NOTEBOOK_PASSPHRASE");
+    std::string directory = directoryEnv ? directoryEnv : "";
+    if (!passphraseEnv && inputReplaying()) {
+        std::cerr << "Replays need NOTEBOOK_PASSPHRASE to unlock the vault" << std::endl;
+        return 1;
+    }
+    bool newVault = !isSealedVault(storePaths(directory).save);
+    const char* prompt = newVault ? "Choose a passphrase for the vault" : "Vault passphrase";
+    VaultStore store;
+    OpenStoreResult opened = OpenStoreResult::WrongPassphrase;
+    SecureString passphrase;
+    SecureString confirmation;
+    while (opened == OpenStoreResult::WrongPassphrase) {
+        if (passphraseEnv) {
+            passphrase = passphraseEnv;
+        } else if (!getPassphraseInput(renderer, atlas, prompt, passphrase)) {
+            return 0;
+        } else if (newVault) {
+            // A typo here would lock the vault for good, so a new passphrase is typed twice
+            if (!getPassphraseInput(renderer, atlas, "Type the passphrase again", confirmation)) return 0;
+            if (confirmation != passphrase) {
+                prompt = "The passphrases differ, choose again";
+                continue;
+            }
+        }
+        opened = openStore(store, passphrase, directory);
+        if (opened == OpenStoreResult::Damaged) {
+            // Nothing has been touched yet. A replay can't answer, so it stops here
+            if (inputReplaying() || !showDeleteConfirmation(renderer, atlas, labels,
+                    "The vault is damaged. Move it aside to save.vault.corrupt and start an empty one?")) {
+                std::cerr << "Left the damaged vault as it is" << std::endl;
+                return 1;
+            }
+            opened = openStore(store, passphrase, directory, true);
+        }
+        if (opened == OpenStoreResult::WrongPassphrase) {
+            if (passphraseEnv) {
+                std::cerr << "NOTEBOOK_PASSPHRASE does not unlock the vault" << std::endl;
+                return 1;
+            }
+            prompt = "Wrong passphrase, try again";
+        }
+    }
+    secureWipe(&passphrase[0], passphrase.size());
+    secureWipe(&confirmation[0], confirmation.size());
+    if (opened == OpenStoreResult::Failed) {
+        // stderr goes nowhere on Windows, so this one gets a window of its own
+        std::cerr << "Failed to open the vault" << std::endl;
+        SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "NoteBook",
+                                 "Failed to open the vault. Its files were left as they were.", window);
+        return 1;
+    }
+    if (opened == OpenStoreResult::OpenedWithoutJournal) {
+        std::cerr << "Edits will only be saved on exit" << std::endl;
+    }
+    const Vault& vault = store.vault;
+
+    // Without a transform.txt next to the vault, Copy copies the stored password as it is. Broken
+    // rules disable Copy instead, rather than putting a password on the clipboard that won't work,
+    // and the details popup says what is wrong with them
+    TransformProgram transform;
+    std::string transformError;
+    const TransformProgram* copyTransform = loadTransform(transform, store.paths.transform, transformError) ? &transform : nullptr;
+
+    std::string searchQuery;
+    std::vector<SearchResult> searchResults;
+    auto refreshSearch = [&]() {
+        storeSearch(store, searchQuery, searchResults);
+    };
+    auto rowCount = [&]() -> size_t {
+        return listRowCount(vault, searchQuery, searchResults);
+    };
+    auto rowService = [&](size_t row) -> size_t {
+        return listRowService(searchQuery, searchResults, row);
+    };
 
     auto addService = [&]() {
-        ServiceInputResult result = getServiceNameInput(renderer, font);
+        ServiceInputResult result = getServiceNameInput(renderer, atlas);
         if (result.submitted) {
-            Service newService;
-            newService.label = result.label;
-            services.push_back(newService);
+            storeAddService(store, result.label);
         }
     };
 
-    Service* selectedService = nullptr;
+    MainLayout layout = mainLayout();
+    const VirtualList& serviceList = layout.serviceList;
 
     int scrollOffset = 0;
-    size_t lastServiceI = 0;
     bool running = true;
     SDL_Event event;
 
 
+    // F3 toggles the frame time and allocation overlay
+    FrameStats frameStats;
+
+    // Typing anywhere in the main window goes to the search bar
+    SDL_StartTextInput();
+
+    RedrawState redraw;
     while (running) {
-        while (SDL_PollEvent(&event)) {
+        waitForInput(redraw);
+        TRACE_SCOPE("main loop");
+        while (pollInput(&event)) {
+            noteEvent(redraw, event);
             if (event.type == SDL_QUIT) running = false;
 
-            if (event.type == SDL_MOUSEWHEEL) {
-                if (!((lastServiceI == (services.size() - 1)) && (event.wheel.y < 0))) {
-                    scrollOffset -= event.wheel.y * 20;
+            if (event.type == SDL_TEXTINPUT && searchQuery.size() < (size_t)MAX_CHARACTERS) {
+                searchQuery += event.text.text;
+                scrollOffset = 0;
+                refreshSearch();
+            }
+
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3) {
+                toggleFrameStats(frameStats);
+            }
+
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F4) {
+                if (!traceEnabled()) {
+                    setTraceEnabled(true);
+                    std::cerr << "Tracing started, press F4 again to write " << tracePath << std::endl;
+                } else if (writeTrace(tracePath)) {
+                    std::cerr << "Trace written to " << tracePath << std::endl;
                 }
-                if (scrollOffset < 0) scrollOffset = 0;
+            }
+
+            if (event.type == SDL_KEYDOWN && !searchQuery.empty()) {
+                if (event.key.keysym.sym == SDLK_BACKSPACE) {
+                    searchQuery.pop_back();
+                    scrollOffset = 0;
+                    refreshSearch();
+                } else if (event.key.keysym.sym == SDLK_ESCAPE) {
+                    searchQuery.clear();
+                    scrollOffset = 0;
+                }
+            }
+
+            // Target textures lose their contents when the render device is reset
+            if (event.type == SDL_RENDER_TARGETS_RESET || event.type == SDL_RENDER_DEVICE_RESET) {
+                clearLabelCache(labels);
+            }
+
+            if (event.type == SDL_MOUSEWHEEL) {
+                scrollOffset -= event.wheel.y * 20;
+                scrollOffset = std::clamp(scrollOffset, 0, maxScrollOffset(serviceList, rowCount()));
             }
 
             if (event.type == SDL_MOUSEBUTTONDOWN) {
@@ -628,109 +672,71 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                 int my = event.button.y;
 
                 SDL_Point mousePoint = { mx, my };
-                SDL_Rect addBtnRect = { WINDOW_WIDTH - 160, WINDOW_HEIGHT - 70, 140, 50 };
 
-                if (SDL_PointInRect(&mousePoint, &addBtnRect)) {
+                if (SDL_PointInRect(&mousePoint, &layout.addServiceBtn)) {
                     addService();
+                    refreshSearch();
+                    SDL_StartTextInput();
                 } else {
-                    int spacing = 10;
-                    int buttonHeight = 50;
-                    int buttonWidth = static_cast<int>(WINDOW_WIDTH * 0.5);
-                    int xStart = static_cast<int>(WINDOW_WIDTH * 0.1);
-                    int yStart = static_cast<int>(WINDOW_HEIGHT * 0.1);
-
-                    for (size_t i = 0; i < services.size(); ++i) {
-                        int y = static_cast<int>(i) * (buttonHeight + spacing) - scrollOffset + yStart;
-                        SDL_Rect btnRect = { xStart, y, buttonWidth, buttonHeight };
-                        if (mx >= btnRect.x && mx <= btnRect.x + btnRect.w &&
-                            my >= btnRect.y && my <= btnRect.y + btnRect.h) {
-                            // Show popup, delete service if requested
-                            bool deleted = showServiceDetailsPopup(renderer, font, services[i]);
-                            if (deleted) {
-                                services.erase(services.begin() + i);
-                                selectedService = nullptr;
+                    size_t row = hitTestRow(serviceList, rowCount(), scrollOffset, mx, my);
+                    if (row != NO_ROW) {
+                        size_t i = rowService(row);
+                        // Show popup, delete service if requested
+                        bool deleted = showServiceDetailsPopup(renderer, atlas, labels, store, copyTransform, transformError, i);
+                        if (deleted) {
+                            invalidateLabel(labels, vaultServiceLabel(vault, i));
+                            for (size_t account = 0; account < vaultAccountCount(vault, i); ++account) {
+                                invalidateLabel(labels, vaultAccountName(vault, i, account));
                             }
-                            break;
+                            storeDeleteService(store, i);
                         }
+                        // Popups stop text input and may have changed what matches
+                        refreshSearch();
+                        SDL_StartTextInput();
                     }
                 }
             }
         }
 
-        SDL_SetRenderDrawColor(renderer, 25, 25, 25, 255);
-        SDL_RenderClear(renderer);
+        if (!redraw.dirty) continue;
+        redraw.dirty = false;
 
-        int spacing = 10;
-        int buttonHeight = 50;
-        int buttonWidth = static_cast<int>(WINDOW_WIDTH * 0.5);
-        int xStart = static_cast<int>(WINDOW_WIDTH * 0.1);
-        int yStart = static_cast<int>(WINDOW_HEIGHT * 0.1);
-        int scrollAreaHeight = WINDOW_HEIGHT - 100;
-
-        // Draw "Services" label
-        SDL_Surface* labelSurf = TTF_RenderText_Blended(font, "Services", { 255, 255, 255, 255 });
-        SDL_Texture* labelTex = SDL_CreateTextureFromSurface(renderer, labelSurf);
-        SDL_Rect labelRect = { xStart + buttonWidth + 20, yStart, labelSurf->w, labelSurf->h };
-        SDL_RenderCopy(renderer, labelTex, nullptr, &labelRect);
-        SDL_FreeSurface(labelSurf);
-        SDL_DestroyTexture(labelTex);
-
-        for (size_t i = 0; i < services.size(); ++i) {
-            int y = static_cast<int>(i) * (buttonHeight + spacing) - scrollOffset + yStart;
-            if (y + buttonHeight < yStart || y > scrollAreaHeight) continue;
-            lastServiceI = i;
-
-            SDL_Rect btnRect = { xStart, y, buttonWidth, buttonHeight };
-            SDL_SetRenderDrawColor(renderer, 70, 130, 180, 255);
-            SDL_RenderFillRect(renderer, &btnRect);
-            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-            SDL_RenderDrawRect(renderer, &btnRect);
-
-            // Draw label text
-            if (!services[i].label.empty()) {
-                SDL_Surface* textSurf = TTF_RenderText_Blended(font, services[i].label.c_str(), { 255, 255, 255, 255 });
-                SDL_Texture* textTex = SDL_CreateTextureFromSurface(renderer, textSurf);
-                SDL_Rect textRect = {
-                    btnRect.x + (btnRect.w - textSurf->w) / 2,
-                    btnRect.y + (btnRect.h - textSurf->h) / 2,
-                    textSurf->w,
-                    textSurf->h
-                };
-                SDL_RenderCopy(renderer, textTex, nullptr, &textRect);
-                SDL_FreeSurface(textSurf);
-                SDL_DestroyTexture(textTex);
-            }
-        }
+        beginFrame(frameStats, heapAllocationCount());
 
-        // Draw Add Service Button
-        SDL_Rect addBtnRect = { WINDOW_WIDTH - 160, WINDOW_HEIGHT - 70, 140, 50 };
-        SDL_SetRenderDrawColor(renderer, 34, 139, 34, 255);
-        SDL_RenderFillRect(renderer, &addBtnRect);
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        SDL_RenderDrawRect(renderer, &addBtnRect);
-
-        SDL_Surface* addTextSurf = TTF_RenderText_Blended(font, "Add Service", { 255, 255, 255, 255 });
-        SDL_Texture* addTextTex = SDL_CreateTextureFromSurface(renderer, addTextSurf);
-        SDL_Rect addTextRect = {
-            addBtnRect.x + (addBtnRect.w - addTextSurf->w) / 2,
-            addBtnRect.y + (addBtnRect.h - addTextSurf->h) / 2,
-            addTextSurf->w,
-            addTextSurf->h
-        };
-        SDL_RenderCopy(renderer, addTextTex, nullptr, &addTextRect);
-        SDL_FreeSurface(addTextSurf);
-        SDL_DestroyTexture(addTextTex);
+        // Deleting services can leave the offset past the end of the shorter list
+        scrollOffset = std::min(scrollOffset, maxScrollOffset(serviceList, rowCount()));
+        // Only the chunks behind the rows on screen are ever decrypted for drawing
+        VisibleRange visible = visibleRows(serviceList, rowCount(), scrollOffset);
+        for (size_t row = visible.first; row < visible.last; ++row) {
+            storeLoadService(store, rowService(row));
+        }
+        drawMainFrame(renderer, atlas, labels, layout, vault, searchQuery, searchResults, scrollOffset);
+        drawFrameStats(renderer, atlas, frameStats, secureAllocStats().bytesLive);
 
         SDL_RenderPresent(renderer);
-        SDL_Delay(16);
+        endFrame(frameStats, heapAllocationCount());
+    }
+
+    if (inputReplaying()) {
+        InputReplayStats replay = inputReplayStats();
+        std::cerr << "Replayed " << replay.events << " events in " << replay.wallMs << " ms" << std::endl;
     }
+    stopInputLog();
 
+    printLabelCacheStats(labels, std::cerr);
+    clearLabelCache(labels);
+    destroyGlyphAtlas(atlas);
     TTF_CloseFont(font);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     TTF_Quit();
     SDL_Quit();
 
-    saveToFile(services, PATH_SAVE);
+    closeStore(store);
+    if (traceEnv) {
+        writeTrace(tracePath);
+    }
+    std::cerr << "Vault memory: ";
+    printSecureAllocStats(secureAllocStats(), std::cerr);
     return 0;
 }
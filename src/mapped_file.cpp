@@ -0,0 +1,89 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool mapFile(MappedFile& file, const std::string& path) {
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    file.fileHandle = handle;
+    file.size = static_cast<size_t>(size.QuadPart);
+    if (file.size == 0) {
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        unmapFile(file);
+        return false;
+    }
+    file.mappingHandle = mapping;
+
+    file.data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!file.data) {
+        unmapFile(file);
+        return false;
+    }
+    return true;
+}
+
+void unmapFile(MappedFile& file) {
+    if (file.data) UnmapViewOfFile(file.data);
+    if (file.mappingHandle) CloseHandle(file.mappingHandle);
+    if (file.fileHandle) CloseHandle(file.fileHandle);
+    file = MappedFile{};
+}
+
+#else
+
+bool mapFile(MappedFile& file, const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    file.fd = fd;
+    file.size = static_cast<size_t>(st.st_size);
+    if (file.size == 0) {
+        return true;
+    }
+
+    void* data = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        unmapFile(file);
+        return false;
+    }
+    file.data = static_cast<const char*>(data);
+    return true;
+}
+
+void unmapFile(MappedFile& file) {
+    if (file.data) munmap(const_cast<char*>(file.data), file.size);
+    if (file.fd >= 0) close(file.fd);
+    file = MappedFile{};
+}
+
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory map of a whole file
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// Returns false if the file can't be opened. Empty files map successfully with data == nullptr
+bool mapFile(MappedFile& file, const std::string& path);
+void unmapFile(MappedFile& file);
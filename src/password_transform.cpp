@@ -0,0 +1,317 @@
+#include "password_transform.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+#include "byte_map.h"
+#include "file_util.h"
+#include "transform_recipes.h"
+#include "trace.h"
+
+static TransformStep identityTable(uint32_t period) {
+    TransformStep step;
+    step.kind = TransformStepKind::Table;
+    step.period = period;
+    step.tables.resize(static_cast<size_t>(period) * 256);
+    for (uint32_t p = 0; p < period; ++p) {
+        for (int c = 0; c < 256; ++c) {
+            step.tables[p * 256 + c] = static_cast<uint8_t>(c);
+        }
+    }
+    return step;
+}
+
+static TransformStep mixTable(std::string_view key) {
+    TransformStep step;
+    step.period = MIX_PERIOD;
+    RecipeTables tables = mixTables(key);
+    step.tables.assign(tables.begin(), tables.end());
+    return step;
+}
+
+// Appends a table step, folding it into the previous one when that is a table too
+static void addTableStep(TransformProgram& program, TransformStep&& step) {
+    if (!program.steps.empty() && program.steps.back().kind == TransformStepKind::Table) {
+        TransformStep& previous = program.steps.back();
+        uint32_t period = std::lcm(previous.period, step.period);
+        if (period <= TRANSFORM_MAX_PERIOD) {
+            TransformStep fused = identityTable(period);
+            for (uint32_t p = 0; p < period; ++p) {
+                const uint8_t* first = &previous.tables[(p % previous.period) * 256];
+                const uint8_t* second = &step.tables[(p % step.period) * 256];
+                for (int c = 0; c < 256; ++c) {
+                    fused.tables[p * 256 + c] = second[first[c]];
+                }
+            }
+            previous = std::move(fused);
+            return;
+        }
+    }
+    program.steps.push_back(std::move(step));
+}
+
+static bool parseInt(std::string_view text, int32_t& value) {
+    std::string digits(text);
+    char* end = nullptr;
+    long parsed = std::strtol(digits.c_str(), &end, 10);
+    if (digits.empty() || *end != '\0' || parsed < INT32_MIN || parsed > INT32_MAX) return false;
+    value = static_cast<int32_t>(parsed);
+    return true;
+}
+
+// Splits off the first space-delimited word of line
+static std::string_view nextWord(std::string_view& line) {
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+    size_t end = line.find_first_of(" \t", start);
+    std::string_view word = line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+    line = end == std::string_view::npos ? std::string_view() : line.substr(end + 1);
+    return word;
+}
+
+static bool compileRule(TransformProgram& program, std::string_view line, std::string& error) {
+    std::string_view rule = nextWord(line);
+    if (rule == "sub") {
+        std::string_view from = nextWord(line);
+        std::string_view to = nextWord(line);
+        if (from.empty() || from.size() != to.size() || !nextWord(line).empty()) {
+            error = "sub needs two strings of the same length";
+            return false;
+        }
+        TransformStep step = identityTable(1);
+        bool seen[256] = {};
+        for (size_t i = 0; i < from.size(); ++i) {
+            uint8_t c = static_cast<uint8_t>(from[i]);
+            if (seen[c]) {
+                error = "sub maps '" + std::string(1, from[i]) + "' twice";
+                return false;
+            }
+            seen[c] = true;
+            step.tables[c] = static_cast<uint8_t>(to[i]);
+        }
+        addTableStep(program, std::move(step));
+    } else if (rule == "insert") {
+        TransformStep step;
+        step.kind = TransformStepKind::Insert;
+        if (!parseInt(nextWord(line), step.position) || line.empty()) {
+            error = "insert needs a position and some text";
+            return false;
+        }
+        step.text.assign(line.data(), line.size());
+        program.steps.push_back(std::move(step));
+    } else if (rule == "rotate") {
+        TransformStep step;
+        step.kind = TransformStepKind::Rotate;
+        if (!parseInt(nextWord(line), step.amount) || !nextWord(line).empty()) {
+            error = "rotate needs an amount";
+            return false;
+        }
+        program.steps.push_back(std::move(step));
+    } else if (rule == "mix") {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string_view::npos) {
+            error = "mix needs a key";
+            return false;
+        }
+        addTableStep(program, mixTable(line.substr(start)));
+    } else if (rule == "recipe") {
+        std::string_view name = nextWord(line);
+        const KnownRecipe* known = findRecipe(name);
+        if (!known || !nextWord(line).empty()) {
+            error = name.empty() ? "recipe needs a name" : "unknown recipe '" + std::string(name) + "'";
+            return false;
+        }
+        const Recipe& recipe = *known->recipe;
+        for (size_t i = 0; i < recipe.count; ++i) {
+            const RecipeStep& recipeStep = recipe.steps[i];
+            TransformStep step;
+            step.kind = recipeStep.kind;
+            step.period = recipeStep.period;
+            step.position = recipeStep.position;
+            step.text.assign(recipeStep.text, recipeStep.textLength);
+            step.amount = recipeStep.amount;
+            if (step.kind == TransformStepKind::Table) {
+                step.tables.assign(recipeStep.tables.begin(), recipeStep.tables.begin() + recipeStep.period * 256);
+                addTableStep(program, std::move(step));
+            } else {
+                program.steps.push_back(std::move(step));
+            }
+        }
+    } else {
+        error = "unknown rule '" + std::string(rule) + "'";
+        return false;
+    }
+    return true;
+}
+
+bool compileTransform(TransformProgram& program, std::string_view rules, std::string& error) {
+    TRACE_SCOPE("compileTransform");
+    program.steps.clear();
+    program.specialized = nullptr;
+    size_t lineNumber = 0;
+    while (!rules.empty()) {
+        size_t newline = rules.find('\n');
+        std::string_view line = rules.substr(0, newline);
+        rules = newline == std::string_view::npos ? std::string_view() : rules.substr(newline + 1);
+        ++lineNumber;
+
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string_view::npos || line[start] == '#') continue;
+
+        if (!compileRule(program, line.substr(start), error)) {
+            error = "line " + std::to_string(lineNumber) + ": " + error;
+            program.steps.clear();
+            return false;
+        }
+    }
+    program.specialized = findSpecializedTransform(program);
+    return true;
+}
+
+bool loadTransform(TransformProgram& program, const std::string& filename, std::string& error) {
+    program.steps.clear();
+    program.specialized = nullptr;
+    if (!fileExists(filename)) return true;
+
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in) {
+        error = "Failed to open transform rules: " + filename;
+        std::cerr << error << std::endl;
+        return false;
+    }
+    // The rules are as secret as the passwords, so they are read into wiped memory
+    SecureString rules(static_cast<size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    in.read(&rules[0], static_cast<std::streamsize>(rules.size()));
+
+    std::string ruleError;
+    if (!compileTransform(program, rules, ruleError)) {
+        error = "Bad transform rules in " + filename + ", " + ruleError;
+        std::cerr << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void applyTable(const TransformStep& step, char* data, size_t length) {
+    const uint8_t* tables = step.tables.data();
+    if (step.period == 1) {
+        mapBytes(tables, data, length);
+        return;
+    }
+    uint32_t p = 0;
+    for (size_t i = 0; i < length; ++i) {
+        data[i] = static_cast<char>(tables[p * 256 + static_cast<uint8_t>(data[i])]);
+        if (++p == step.period) p = 0;
+    }
+}
+
+static void applyRotate(const TransformStep& step, char* data, size_t length) {
+    if (length < 2) return;
+    int64_t shift = step.amount % static_cast<int64_t>(length);
+    if (shift < 0) shift += static_cast<int64_t>(length);
+    std::rotate(data, data + shift, data + length);
+}
+
+static size_t insertOffset(const TransformStep& step, size_t length) {
+    int64_t offset = step.position >= 0 ? step.position : static_cast<int64_t>(length) + 1 + step.position;
+    return static_cast<size_t>(std::clamp<int64_t>(offset, 0, static_cast<int64_t>(length)));
+}
+
+void transformPassword(const TransformProgram& program, std::string_view password, SecureString& out) {
+    if (program.specialized) {
+        out.resize(password.size() + program.specialized->growth);
+        out.resize(program.specialized->apply(password.data(), password.size(), &out[0]));
+        return;
+    }
+    out.assign(password.data(), password.size());
+    for (const TransformStep& step : program.steps) {
+        switch (step.kind) {
+        case TransformStepKind::Table:
+            applyTable(step, &out[0], out.size());
+            break;
+        case TransformStepKind::Rotate:
+            applyRotate(step, &out[0], out.size());
+            break;
+        case TransformStepKind::Insert:
+            out.insert(insertOffset(step, out.size()), step.text);
+            break;
+        }
+    }
+}
+
+void transformPasswords(const TransformProgram& program, const std::string_view* passwords, size_t count,
+                        TransformBatch& batch) {
+    TRACE_SCOPE("transformPasswords");
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        bytes += passwords[i].size();
+    }
+    batch.results.resize(count);
+    if (program.specialized) {
+        // The recipe's code runs password by password, straight into the pool
+        const SpecializedTransform& specialized = *program.specialized;
+        batch.pool.resize(bytes + count * specialized.growth);
+        size_t offset = 0;
+        for (size_t i = 0; i < count; ++i) {
+            size_t length = specialized.apply(passwords[i].data(), passwords[i].size(), &batch.pool[0] + offset);
+            batch.results[i] = { static_cast<uint32_t>(offset), static_cast<uint32_t>(length) };
+            offset += length;
+        }
+        batch.pool.resize(offset);
+        return;
+    }
+
+    batch.pool.clear();
+    batch.pool.reserve(bytes);
+    for (size_t i = 0; i < count; ++i) {
+        batch.results[i] = { static_cast<uint32_t>(batch.pool.size()), static_cast<uint32_t>(passwords[i].size()) };
+        batch.pool.append(passwords[i].data(), passwords[i].size());
+    }
+
+    for (const TransformStep& step : program.steps) {
+        if (step.kind == TransformStepKind::Insert) {
+            // Every password grows by the same amount, so the batch is rebuilt into scratch in one pass
+            SecureString& next = batch.scratch;
+            next.clear();
+            next.reserve(batch.pool.size() + count * step.text.size());
+            for (PoolString& result : batch.results) {
+                const char* data = batch.pool.data() + result.offset;
+                size_t at = insertOffset(step, result.length);
+                result.offset = static_cast<uint32_t>(next.size());
+                next.append(data, at);
+                next.append(step.text);
+                next.append(data + at, result.length - at);
+                result.length += static_cast<uint32_t>(step.text.size());
+            }
+            batch.pool.swap(next);
+            continue;
+        }
+        // A table without a period doesn't care where one password ends, so the whole pool is one
+        // vectorized pass. Periodic tables restart at every password and go through them one by one
+        if (step.kind == TransformStepKind::Table && step.period == 1) {
+            mapBytes(step.tables.data(), &batch.pool[0], batch.pool.size());
+            continue;
+        }
+        for (const PoolString& result : batch.results) {
+            char* data = &batch.pool[0] + result.offset;
+            if (step.kind == TransformStepKind::Table) {
+                applyTable(step, data, result.length);
+            } else {
+                applyRotate(step, data, result.length);
+            }
+        }
+    }
+}
+
+std::string_view transformResult(const TransformBatch& batch, size_t index) {
+    const PoolString& result = batch.results[index];
+    return std::string_view(batch.pool.data() + result.offset, result.length);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "secure_alloc.h"
+#include "vault.h"
+
+// The README's "app 2": turns the simple password stored in the vault into the one the service
+// actually gets. A rule file is compiled once into lookup tables, after which transforming a
+// password is a table lookup per byte plus the odd memmove for insertions and rotations.
+//
+// Rule file, one rule per line, applied top to bottom. Blank lines and lines starting with # are skipped:
+//   sub <from> <to>          replaces from[i] with to[i], both strings the same length
+//   insert <position> <text> inserts the rest of the line at position, negative counts from the end (-1 appends)
+//   rotate <amount>          rotates left by amount, negative rotates right
+//   mix <key>                position-dependent substitution of the printable ASCII characters, keyed by the rest of the line
+//   recipe <name>            the rules of one of the known recipes in transform_recipes.h
+//
+// Runs of sub and mix rules are fused into one table step, so a long rule file costs no more per byte than a short one.
+// A program that compiles to exactly a known recipe runs the recipe's specialized code instead of the steps
+
+// Longest period a fused table step may have before the next table rule starts a step of its own
+const uint32_t TRANSFORM_MAX_PERIOD = 64;
+
+enum class TransformStepKind {
+    Table,
+    Insert,
+    Rotate
+};
+
+struct TransformStep {
+    TransformStepKind kind = TransformStepKind::Table;
+    // Table: byte i of the password maps through tables[(i % period) * 256 + byte]
+    uint32_t period = 1;
+    SecureVector<uint8_t> tables;
+    // Insert
+    int32_t position = 0;
+    SecureString text;
+    // Rotate
+    int32_t amount = 0;
+};
+
+// A recipe compiled ahead of time. apply writes the transformed password to out, which has room for
+// length + growth bytes, and returns its length
+struct SpecializedTransform {
+    size_t growth;
+    size_t (*apply)(const char* password, size_t length, char* out);
+};
+
+// An empty program is the identity
+struct TransformProgram {
+    std::vector<TransformStep> steps;
+    // Set by compileTransform when steps match a known recipe, clear it to force the interpreter
+    const SpecializedTransform* specialized = nullptr;
+};
+
+// Compiles rules into program. On failure program is left empty and error names the bad line
+bool compileTransform(TransformProgram& program, std::string_view rules, std::string& error);
+
+// Compiles a rule file. A missing file is not an error and leaves the identity program. On failure
+// error says what is wrong with the file, for the user to see
+bool loadTransform(TransformProgram& program, const std::string& filename, std::string& error);
+
+void transformPassword(const TransformProgram& program, std::string_view password, SecureString& out);
+
+// Transformed passwords of one batch, back to back in pool. Reusing a batch reuses its buffers
+struct TransformBatch {
+    SecureString pool;
+    SecureVector<PoolString> results;
+    SecureString scratch;
+};
+
+// Transforms count passwords step by step rather than password by password, so each step's tables
+// stay in cache for the whole batch
+void transformPasswords(const TransformProgram& program, const std::string_view* passwords, size_t count,
+                        TransformBatch& batch);
+
+std::string_view transformResult(const TransformBatch& batch, size_t index);
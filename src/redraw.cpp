@@ -0,0 +1,38 @@
+#include "redraw.h"
+
+#include "input_log.h"
+
+void waitForInput(RedrawState& redraw) {
+    if (redraw.dirty) return;
+
+    if (redraw.wakeAt == 0) {
+        // Only waits, the event stays queued for the pollInput loop
+        waitInput();
+        return;
+    }
+
+    Uint32 now = inputTicks();
+    if (SDL_TICKS_PASSED(now, redraw.wakeAt) || !waitInputTimeout(redraw.wakeAt - now)) {
+        redraw.wakeAt = 0;
+        redraw.dirty = true;
+    }
+}
+
+void noteEvent(RedrawState& redraw, const SDL_Event& e) {
+    // Nothing in the UI reacts to hovering, so plain mouse motion never needs a new frame
+    if (e.type != SDL_MOUSEMOTION) {
+        redraw.dirty = true;
+    }
+}
+
+void markDirty(RedrawState& redraw) {
+    redraw.dirty = true;
+}
+
+void scheduleRedraw(RedrawState& redraw, Uint32 delayMs) {
+    Uint32 wakeAt = inputTicks() + delayMs;
+    if (wakeAt == 0) wakeAt = 1;
+    if (redraw.wakeAt == 0 || SDL_TICKS_PASSED(redraw.wakeAt, wakeAt)) {
+        redraw.wakeAt = wakeAt;
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <SDL.h>
+
+// Damage tracking for the modal loops: a frame is only drawn after something marked the view dirty
+struct RedrawState {
+    bool dirty = true;     // the first pass through a loop always draws
+    Uint32 wakeAt = 0;     // inputTicks() time of the next scheduled redraw, 0 when none is pending
+};
+
+// Blocks until an event is queued or a scheduled redraw is due. Returns immediately while the view is dirty
+void waitForInput(RedrawState& redraw);
+
+// Marks the view dirty for every event that can change what is on screen
+void noteEvent(RedrawState& redraw, const SDL_Event& e);
+
+void markDirty(RedrawState& redraw);
+
+// Wakes the loop up after delayMs even if no input arrives, for things like timed feedback
+void scheduleRedraw(RedrawState& redraw, Uint32 delayMs);
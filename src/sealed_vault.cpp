@@ -0,0 +1,497 @@
+#include "sealed_vault.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "file_util.h"
+#include "trace.h"
+
+static_assert(sizeof(SealedHeader) == 80, "SealedHeader layout is part of the file format");
+static_assert(sizeof(SealedRoot) == 48, "SealedRoot layout is part of the file format");
+static_assert(sizeof(SealedChunkEntry) == 40, "SealedChunkEntry layout is part of the file format");
+static_assert(sizeof(SealedDirectoryHeader) == 16, "SealedDirectoryHeader layout is part of the file format");
+
+static const char KEY_CHECK_TEXT[] = "NoteBook sealed vault key check";
+
+static bool seekTo(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+static bool readAt(FILE* file, uint64_t offset, void* out, size_t size) {
+    return seekTo(file, offset) && std::fread(out, 1, size, file) == size;
+}
+
+static bool writeAt(FILE* file, uint64_t offset, const void* data, size_t size) {
+    return seekTo(file, offset) && std::fwrite(data, 1, size, file) == size;
+}
+
+static uint64_t fileSize(FILE* file) {
+#ifdef _WIN32
+    if (_fseeki64(file, 0, SEEK_END) != 0) return 0;
+    __int64 size = _ftelli64(file);
+#else
+    if (fseeko(file, 0, SEEK_END) != 0) return 0;
+    off_t size = ftello(file);
+#endif
+    return size < 0 ? 0 : static_cast<uint64_t>(size);
+}
+
+static uint64_t slotOffset(uint32_t slot) {
+    return SEALED_SLOTS_OFFSET + static_cast<uint64_t>(slot) * SEALED_SLOT_SIZE;
+}
+
+// Additional data of a chunk: what it is, which file and which slots, so it only opens where it was sealed
+static size_t chunkAad(const SealedVault& sealed, uint32_t firstSlot, uint32_t slotCount, uint8_t* aad) {
+    std::memcpy(aad, "CHNK", 4);
+    std::memcpy(aad + 4, sealed.header.fileId, SEALED_FILE_ID_SIZE);
+    std::memcpy(aad + 20, &firstSlot, sizeof(firstSlot));
+    std::memcpy(aad + 24, &slotCount, sizeof(slotCount));
+    return 28;
+}
+
+static size_t directoryAad(const SealedVault& sealed, const SealedRoot& root, uint8_t* aad) {
+    std::memcpy(aad, "DIR ", 4);
+    std::memcpy(aad + 4, sealed.header.fileId, SEALED_FILE_ID_SIZE);
+    std::memcpy(aad + 20, &root.generation, sizeof(root.generation));
+    std::memcpy(aad + 28, &root.directorySlot, sizeof(root.directorySlot));
+    std::memcpy(aad + 32, &root.directorySlots, sizeof(root.directorySlots));
+    return 36;
+}
+
+static void keyCheck(const AeadKey& key, uint8_t* check) {
+    hmacSha256(key.bytes, sizeof(key.bytes), KEY_CHECK_TEXT, sizeof(KEY_CHECK_TEXT) - 1, check);
+}
+
+bool deriveSealedKey(SealedKey& key, std::string_view passphrase, uint32_t kdfIterations) {
+    TRACE_SCOPE("deriveSealedKey");
+    if (!randomBytes(key.salt, sizeof(key.salt))) {
+        std::cerr << "No random numbers for the vault salt" << std::endl;
+        return false;
+    }
+    key.kdfIterations = kdfIterations;
+    pbkdf2Sha256(passphrase, key.salt, sizeof(key.salt), kdfIterations, key.key.bytes, sizeof(key.key.bytes));
+    return true;
+}
+
+bool isSealedVault(const std::string& filename) {
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) return false;
+    char magic[sizeof(SEALED_MAGIC)] = {};
+    bool sealed = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                  std::memcmp(magic, SEALED_MAGIC, sizeof(magic)) == 0;
+    std::fclose(file);
+    return sealed;
+}
+
+// Unbuffered, so a read never picks up bytes of a slot someone else has rewritten since
+static FILE* openHandle(const std::string& filename, const char* mode) {
+    FILE* file = std::fopen(filename.c_str(), mode);
+    if (file) {
+        std::setvbuf(file, nullptr, _IONBF, 0);
+    }
+    return file;
+}
+
+// Authenticates the directory root names and takes it as the committed state
+static bool loadDirectory(SealedVault& sealed, const SealedRoot& root, int rootIndex) {
+    if (root.directorySlots == 0 || root.directorySlot > sealed.slotCount ||
+        root.directorySlots > sealed.slotCount - root.directorySlot) {
+        return false;
+    }
+    SecureVector<char> plain(static_cast<size_t>(root.directorySlots) * SEALED_SLOT_SIZE);
+    uint8_t aad[40];
+    size_t aadLength = directoryAad(sealed, root, aad);
+    if (!readAt(sealed.file, slotOffset(root.directorySlot), plain.data(), plain.size()) ||
+        !aeadOpen(sealed.key.key, root.nonce, aad, aadLength, plain.data(), plain.size(), root.tag)) {
+        return false;
+    }
+
+    SealedDirectoryHeader header;
+    std::memcpy(&header, plain.data(), sizeof(header));
+    if (header.chunkCount > (plain.size() - sizeof(header)) / sizeof(SealedChunkEntry)) {
+        return false;
+    }
+    std::vector<SealedChunkEntry> chunks(header.chunkCount);
+    if (!chunks.empty()) {
+        std::memcpy(chunks.data(), plain.data() + sizeof(header), chunks.size() * sizeof(SealedChunkEntry));
+    }
+    uint64_t services = 0;
+    for (const SealedChunkEntry& chunk : chunks) {
+        if (chunk.slotCount == 0 || chunk.firstSlot > sealed.slotCount || chunk.slotCount > sealed.slotCount - chunk.firstSlot) {
+            return false;
+        }
+        services += chunk.serviceCount;
+    }
+    if (services != header.serviceCount) {
+        return false;
+    }
+
+    sealed.generation = root.generation;
+    sealed.root = rootIndex;
+    sealed.directorySlot = root.directorySlot;
+    sealed.directorySlots = root.directorySlots;
+    sealed.journalSeq = header.journalSeq;
+    sealed.chunks = std::move(chunks);
+    return true;
+}
+
+SealedOpenResult openSealedVault(SealedVault& sealed, const std::string& filename, std::string_view passphrase) {
+    TRACE_SCOPE("openSealedVault");
+    closeSealedVault(sealed);
+    sealed.file = openHandle(filename, "rb");
+    if (!sealed.file) {
+        std::cerr << "Failed to open vault: " << filename << std::endl;
+        return SealedOpenResult::Unreadable;
+    }
+    sealed.filename = filename;
+
+    SealedHeader& header = sealed.header;
+    if (!readAt(sealed.file, 0, &header, sizeof(header)) || std::memcmp(header.magic, SEALED_MAGIC, sizeof(SEALED_MAGIC)) != 0 ||
+        header.version != SEALED_VERSION || header.slotSize != SEALED_SLOT_SIZE || header.kdfIterations == 0) {
+        std::cerr << "Not a supported sealed vault: " << filename << std::endl;
+        closeSealedVault(sealed);
+        return SealedOpenResult::Unreadable;
+    }
+
+    std::memcpy(sealed.key.salt, header.salt, sizeof(header.salt));
+    sealed.key.kdfIterations = header.kdfIterations;
+    {
+        TRACE_SCOPE("pbkdf2");
+        pbkdf2Sha256(passphrase, header.salt, sizeof(header.salt), header.kdfIterations,
+                     sealed.key.key.bytes, sizeof(sealed.key.key.bytes));
+    }
+    uint8_t check[SHA256_SIZE];
+    keyCheck(sealed.key.key, check);
+    if (!constantTimeEqual(check, header.keyCheck, sizeof(check))) {
+        closeSealedVault(sealed);
+        return SealedOpenResult::WrongPassphrase;
+    }
+
+    uint64_t size = fileSize(sealed.file);
+    uint64_t slots = size > SEALED_SLOTS_OFFSET ? (size - SEALED_SLOTS_OFFSET) / SEALED_SLOT_SIZE : 0;
+    sealed.slotCount = static_cast<uint32_t>(std::min<uint64_t>(slots, std::numeric_limits<uint32_t>::max()));
+
+    // The newer root first. A torn root write fails to authenticate and the older one takes over
+    SealedRoot roots[2] = {};
+    for (int i = 0; i < 2; ++i) {
+        if (!readAt(sealed.file, SEALED_ROOT_OFFSETS[i], &roots[i], sizeof(SealedRoot))) {
+            roots[i] = SealedRoot{};
+        }
+    }
+    int newer = roots[1].generation > roots[0].generation ? 1 : 0;
+    for (int i : { newer, 1 - newer }) {
+        if (roots[i].generation != 0 && loadDirectory(sealed, roots[i], i)) {
+            return SealedOpenResult::Opened;
+        }
+    }
+    std::cerr << "Vault directory is damaged: " << filename << std::endl;
+    closeSealedVault(sealed);
+    return SealedOpenResult::Damaged;
+}
+
+bool reopenSealedVault(SealedVault& sealed, const SealedVault& source, bool writable) {
+    closeSealedVault(sealed);
+    sealed.file = openHandle(source.filename, writable ? "r+b" : "rb");
+    if (!sealed.file) {
+        std::cerr << "Failed to open vault: " << source.filename << std::endl;
+        return false;
+    }
+    sealed.filename = source.filename;
+    sealed.header = source.header;
+    sealed.key = source.key;
+    sealed.generation = source.generation;
+    sealed.root = source.root;
+    sealed.directorySlot = source.directorySlot;
+    sealed.directorySlots = source.directorySlots;
+    sealed.journalSeq = source.journalSeq;
+    sealed.slotCount = source.slotCount;
+    sealed.chunks = source.chunks;
+    return true;
+}
+
+void closeSealedVault(SealedVault& sealed) {
+    if (sealed.file) {
+        std::fclose(sealed.file);
+    }
+    sealed = SealedVault{};
+}
+
+bool createSealedVault(SealedVault& sealed, const std::string& filename, const SealedKey& key, const Vault& vault,
+                       uint64_t journalSeq) {
+    TRACE_SCOPE("createSealedVault");
+    closeSealedVault(sealed);
+    std::vector<SealedChunkUpdate> updates;
+    {
+        std::vector<SealedChunkPlain> chunks;
+        if (!packSealedChunks(vault, 0, vaultServiceCount(vault), chunks)) {
+            std::cerr << "Vault is too large for the file format: " << filename << std::endl;
+            return false;
+        }
+        updates.resize(chunks.size());
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            updates[i].serviceCount = chunks[i].serviceCount;
+            updates[i].plain = std::move(chunks[i].data);
+        }
+    }
+
+    // Built next to the real file and renamed over it, like writeVault does
+    std::string tempFilename = filename + ".tmp";
+    SealedVault building;
+    building.file = openHandle(tempFilename, "w+b");
+    if (!building.file) {
+        std::cerr << "Failed to open file for writing: " << tempFilename << std::endl;
+        return false;
+    }
+    building.filename = tempFilename;
+    building.key = key;
+    building.root = 1;    // so the first commit goes to root A
+
+    SealedHeader& header = building.header;
+    std::memcpy(header.magic, SEALED_MAGIC, sizeof(SEALED_MAGIC));
+    header.version = SEALED_VERSION;
+    header.slotSize = SEALED_SLOT_SIZE;
+    header.kdfIterations = key.kdfIterations;
+    std::memcpy(header.salt, key.salt, sizeof(header.salt));
+    keyCheck(key.key, header.keyCheck);
+
+    std::vector<char> front(SEALED_SLOTS_OFFSET, 0);
+    bool written = randomBytes(header.fileId, sizeof(header.fileId));
+    std::memcpy(front.data(), &header, sizeof(header));
+    written = written && writeAt(building.file, 0, front.data(), front.size()) &&
+              commitSealedVault(building, updates, journalSeq);
+    written = (std::fclose(building.file) == 0) && written;
+    building.file = nullptr;
+
+    if (!written || !replaceFile(tempFilename, filename)) {
+        std::cerr << "Failed to write vault: " << filename << std::endl;
+        std::remove(tempFilename.c_str());
+        return false;
+    }
+    building.filename = filename;
+    return reopenSealedVault(sealed, building, false);
+}
+
+bool readSealedChunk(const SealedVault& sealed, const SealedChunkEntry& chunk, SecureVector<char>& plain) {
+    TRACE_SCOPE("readSealedChunk");
+    plain.assign(static_cast<size_t>(chunk.slotCount) * SEALED_SLOT_SIZE, 0);
+    uint8_t aad[32];
+    size_t aadLength = chunkAad(sealed, chunk.firstSlot, chunk.slotCount, aad);
+    if (!sealed.file || !readAt(sealed.file, slotOffset(chunk.firstSlot), plain.data(), plain.size()) ||
+        !aeadOpen(sealed.key.key, chunk.nonce, aad, aadLength, plain.data(), plain.size(), chunk.tag)) {
+        std::cerr << "Vault chunk at slot " << chunk.firstSlot << " failed to authenticate: " << sealed.filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Reads length-prefixed fields out of a chunk, failing instead of running past its end
+struct ChunkReader {
+    const char* pos;
+    const char* end;
+
+    bool get(uint32_t& value) {
+        if (static_cast<size_t>(end - pos) < sizeof(value)) return false;
+        std::memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    }
+
+    bool getString(std::string_view& out) {
+        uint32_t length = 0;
+        if (!get(length) || static_cast<size_t>(end - pos) < length) return false;
+        out = std::string_view(pos, length);
+        pos += length;
+        return true;
+    }
+};
+
+bool unpackSealedChunk(const SecureVector<char>& plain, uint32_t serviceCount, Vault& vault, size_t first) {
+    ChunkReader reader = { plain.data(), plain.data() + plain.size() };
+    uint32_t count = 0;
+    if (!reader.get(count) || count != serviceCount || first + count > vaultServiceCount(vault)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string_view label;
+        uint32_t accounts = 0;
+        if (!reader.getString(label) || !reader.get(accounts)) return false;
+        if (!vaultSetServiceLabel(vault, first + i, label)) return false;
+        for (uint32_t a = 0; a < accounts; ++a) {
+            std::string_view name, password;
+            if (!reader.getString(name) || !reader.getString(password) ||
+                !vaultAddAccount(vault, first + i, name, password)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool putString(SecureVector<char>& out, std::string_view str) {
+    if (str.size() > std::numeric_limits<uint32_t>::max()) return false;
+    uint32_t length = static_cast<uint32_t>(str.size());
+    const char* bytes = reinterpret_cast<const char*>(&length);
+    out.insert(out.end(), bytes, bytes + sizeof(length));
+    out.insert(out.end(), str.begin(), str.end());
+    return true;
+}
+
+static void finishChunk(SealedChunkPlain& chunk, std::vector<SealedChunkPlain>& chunks) {
+    std::memcpy(chunk.data.data(), &chunk.serviceCount, sizeof(chunk.serviceCount));
+    chunks.push_back(std::move(chunk));
+    chunk = SealedChunkPlain{};
+}
+
+bool packSealedChunks(const Vault& vault, size_t first, size_t count, std::vector<SealedChunkPlain>& chunks) {
+    TRACE_SCOPE("packSealedChunks");
+    SealedChunkPlain chunk;
+    size_t used = 0;
+    SecureVector<char> service;
+    for (size_t i = first; i < first + count; ++i) {
+        service.clear();
+        size_t accounts = vaultAccountCount(vault, i);
+        uint32_t accountCount = static_cast<uint32_t>(accounts);
+        const char* countBytes = reinterpret_cast<const char*>(&accountCount);
+        if (!putString(service, vaultServiceLabel(vault, i))) return false;
+        service.insert(service.end(), countBytes, countBytes + sizeof(accountCount));
+        for (size_t a = 0; a < accounts; ++a) {
+            if (!putString(service, vaultAccountName(vault, i, a)) || !putString(service, vaultAccountPassword(vault, i, a))) {
+                return false;
+            }
+        }
+
+        // A service that doesn't fit where the chunk is at starts the next one, which grows to as
+        // many slots as the service needs
+        if (chunk.serviceCount > 0 && used + service.size() > chunk.data.size()) {
+            finishChunk(chunk, chunks);
+        }
+        if (chunk.serviceCount == 0) {
+            size_t slots = (sizeof(uint32_t) + service.size() + SEALED_SLOT_SIZE - 1) / SEALED_SLOT_SIZE;
+            if (slots > std::numeric_limits<uint32_t>::max() / SEALED_SLOT_SIZE) return false;
+            chunk.data.assign(slots * SEALED_SLOT_SIZE, 0);
+            used = sizeof(uint32_t);
+        }
+        std::memcpy(chunk.data.data() + used, service.data(), service.size());
+        used += service.size();
+        ++chunk.serviceCount;
+    }
+    if (chunk.serviceCount > 0) {
+        finishChunk(chunk, chunks);
+    }
+    return true;
+}
+
+// Next-fit over the slots the committed directory doesn't use, growing the file when none are left
+struct SlotAllocator {
+    std::vector<bool> used;
+    uint32_t cursor = 0;
+
+    uint32_t allocate(uint32_t count) {
+        uint32_t run = 0;
+        for (uint32_t slot = cursor; slot < used.size(); ++slot) {
+            run = used[slot] ? 0 : run + 1;
+            if (run == count) {
+                return take(slot + 1 - count, count);
+            }
+        }
+        // Free slots at the very end count towards the run
+        return take(static_cast<uint32_t>(used.size()) - run, count);
+    }
+
+    uint32_t take(uint32_t first, uint32_t count) {
+        if (used.size() < static_cast<size_t>(first) + count) {
+            used.resize(static_cast<size_t>(first) + count, false);
+        }
+        std::fill(used.begin() + first, used.begin() + first + count, true);
+        cursor = first + count;
+        return first;
+    }
+};
+
+bool commitSealedVault(SealedVault& sealed, std::vector<SealedChunkUpdate>& chunks, uint64_t journalSeq) {
+    TRACE_SCOPE("commitSealedVault");
+    if (!sealed.file) return false;
+    SlotAllocator slots;
+    slots.used.assign(sealed.slotCount, false);
+    auto markUsed = [&](uint32_t first, uint32_t count) {
+        for (uint32_t s = first; s < first + count && s < slots.used.size(); ++s) slots.used[s] = true;
+    };
+    for (const SealedChunkEntry& chunk : sealed.chunks) {
+        markUsed(chunk.firstSlot, chunk.slotCount);
+    }
+    if (sealed.generation != 0) {
+        markUsed(sealed.directorySlot, sealed.directorySlots);
+    }
+
+    uint64_t services = 0;
+    SecureVector<char> sealedBytes;
+    for (SealedChunkUpdate& chunk : chunks) {
+        services += chunk.serviceCount;
+        if (chunk.plain.empty()) continue;
+        if (chunk.plain.size() % SEALED_SLOT_SIZE != 0) return false;
+
+        uint32_t count = static_cast<uint32_t>(chunk.plain.size() / SEALED_SLOT_SIZE);
+        SealedChunkEntry& entry = chunk.entry;
+        entry.firstSlot = slots.allocate(count);
+        entry.slotCount = count;
+        entry.serviceCount = chunk.serviceCount;
+        if (!randomBytes(entry.nonce, sizeof(entry.nonce))) return false;
+
+        // Sealed in a copy, so a failed commit still has the plaintext to retry with
+        sealedBytes.assign(chunk.plain.begin(), chunk.plain.end());
+        uint8_t aad[32];
+        size_t aadLength = chunkAad(sealed, entry.firstSlot, entry.slotCount, aad);
+        aeadSeal(sealed.key.key, entry.nonce, aad, aadLength, sealedBytes.data(), sealedBytes.size(), entry.tag);
+        if (!writeAt(sealed.file, slotOffset(entry.firstSlot), sealedBytes.data(), sealedBytes.size())) return false;
+    }
+    if (services > std::numeric_limits<uint32_t>::max() || chunks.size() > std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+
+    SealedDirectoryHeader directoryHeader = {};
+    directoryHeader.journalSeq = journalSeq;
+    directoryHeader.chunkCount = static_cast<uint32_t>(chunks.size());
+    directoryHeader.serviceCount = static_cast<uint32_t>(services);
+    size_t directoryBytes = sizeof(directoryHeader) + chunks.size() * sizeof(SealedChunkEntry);
+    uint32_t directorySlots = static_cast<uint32_t>((directoryBytes + SEALED_SLOT_SIZE - 1) / SEALED_SLOT_SIZE);
+    SecureVector<char> directory(static_cast<size_t>(directorySlots) * SEALED_SLOT_SIZE, 0);
+    std::memcpy(directory.data(), &directoryHeader, sizeof(directoryHeader));
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        std::memcpy(directory.data() + sizeof(directoryHeader) + i * sizeof(SealedChunkEntry), &chunks[i].entry,
+                    sizeof(SealedChunkEntry));
+    }
+
+    SealedRoot root = {};
+    root.generation = sealed.generation + 1;
+    root.directorySlot = slots.allocate(directorySlots);
+    root.directorySlots = directorySlots;
+    if (!randomBytes(root.nonce, sizeof(root.nonce))) return false;
+    uint8_t aad[40];
+    size_t aadLength = directoryAad(sealed, root, aad);
+    aeadSeal(sealed.key.key, root.nonce, aad, aadLength, directory.data(), directory.size(), root.tag);
+
+    // Everything the new root names is on disk before the root is written
+    int target = 1 - sealed.root;
+    if (!writeAt(sealed.file, slotOffset(root.directorySlot), directory.data(), directory.size()) || !syncFile(sealed.file) ||
+        !writeAt(sealed.file, SEALED_ROOT_OFFSETS[target], &root, sizeof(root)) || !syncFile(sealed.file)) {
+        return false;
+    }
+
+    sealed.generation = root.generation;
+    sealed.root = target;
+    sealed.directorySlot = root.directorySlot;
+    sealed.directorySlots = root.directorySlots;
+    sealed.journalSeq = journalSeq;
+    sealed.slotCount = std::max(sealed.slotCount, static_cast<uint32_t>(slots.used.size()));
+    sealed.chunks.resize(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        sealed.chunks[i] = chunks[i].entry;
+    }
+    return true;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "crypto.h"
+#include "secure_alloc.h"
+#include "vault.h"
+
+// Encrypted vault layout, all integers little-endian. The file is cut into fixed-size slots and
+// everything secret lives in chunks sealed on their own with ChaCha20-Poly1305, so any chunk can
+// be read or rewritten without touching the others:
+//   SealedHeader                  offset 0, written once when the file is created
+//   SealedRoot A, SealedRoot B    offsets 512 and 1024, the newest one that authenticates wins
+//   slots                         from offset 4096, SEALED_SLOT_SIZE bytes each
+//
+// A chunk holds whole services back to back and takes one slot, or as many as a service that
+// doesn't fit in one needs. The directory lists the chunks in service order with their slots, service counts, nonces
+// and tags, and is itself sealed into slots. A root says where the directory is.
+//
+// Nothing the committed directory uses is ever overwritten. A commit seals the changed chunks and
+// the new directory into free slots, syncs, and only then replaces the older root. A crash at any
+// point leaves the previous root and everything it names intact.
+//
+// The key comes from the passphrase through PBKDF2 with the header's salt. A chunk's tag covers the
+// file id and its slots, and the directory holds every tag, so chunks can't be moved, swapped or
+// rolled back one at a time.
+//
+// Chunk plaintext, zero-padded to the end of its slots:
+//   u32 serviceCount, then per service
+//   u32 length, label | u32 accountCount | per account: u32 length, name | u32 length, password
+const char SEALED_MAGIC[4] = { 'S', 'P', 'V', 'S' };
+const uint32_t SEALED_VERSION = 1;
+const uint32_t SEALED_SLOT_SIZE = 4096;
+const uint64_t SEALED_ROOT_OFFSETS[2] = { 512, 1024 };
+const uint64_t SEALED_SLOTS_OFFSET = 4096;
+const size_t SEALED_SALT_SIZE = 16;
+const size_t SEALED_FILE_ID_SIZE = 16;
+// OWASP's 2023 figure for PBKDF2-HMAC-SHA256. It is paid once per unlock, whatever the vault's size
+const uint32_t SEALED_KDF_ITERATIONS = 600000;
+
+struct SealedHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t slotSize;
+    uint32_t kdfIterations;
+    uint8_t salt[SEALED_SALT_SIZE];
+    uint8_t fileId[SEALED_FILE_ID_SIZE];
+    uint8_t keyCheck[SHA256_SIZE];    // HMAC of a fixed string, tells a wrong passphrase from a damaged file
+};
+
+struct SealedRoot {
+    uint64_t generation;              // 0 for a root never written
+    uint32_t directorySlot;
+    uint32_t directorySlots;
+    uint8_t nonce[AEAD_NONCE_SIZE];
+    uint8_t tag[AEAD_TAG_SIZE];
+};
+
+struct SealedChunkEntry {
+    uint32_t firstSlot;
+    uint32_t slotCount;
+    uint32_t serviceCount;
+    uint8_t nonce[AEAD_NONCE_SIZE];
+    uint8_t tag[AEAD_TAG_SIZE];
+};
+
+// Start of the directory plaintext, followed by chunkCount SealedChunkEntry
+struct SealedDirectoryHeader {
+    uint64_t journalSeq;              // last journal record already folded into the chunks
+    uint32_t chunkCount;
+    uint32_t serviceCount;
+};
+
+// The key with what it was derived from, so a rewritten file can keep the same passphrase
+struct SealedKey {
+    AeadKey key;
+    uint8_t salt[SEALED_SALT_SIZE] = {};
+    uint32_t kdfIterations = 0;
+};
+
+// Runs PBKDF2 over passphrase with a new random salt
+bool deriveSealedKey(SealedKey& key, std::string_view passphrase, uint32_t kdfIterations = SEALED_KDF_ITERATIONS);
+
+// An open sealed vault and its committed directory. The store keeps one handle for reading
+// chunks, the writer thread another for commits
+struct SealedVault {
+    FILE* file = nullptr;
+    std::string filename;
+    SealedHeader header = {};
+    SealedKey key;
+    uint64_t generation = 0;
+    int root = 0;                     // which root holds the committed directory
+    uint32_t directorySlot = 0;
+    uint32_t directorySlots = 0;
+    uint64_t journalSeq = 0;
+    uint32_t slotCount = 0;           // slots the file has room for
+    std::vector<SealedChunkEntry> chunks;
+};
+
+enum class SealedOpenResult {
+    Opened,
+    WrongPassphrase,
+    Unreadable,         // the file couldn't be read or isn't a version this build knows, nothing about its contents is known
+    Damaged             // the passphrase is right but neither directory authenticates
+};
+
+// Whether filename starts with SEALED_MAGIC, without unlocking anything
+bool isSealedVault(const std::string& filename);
+
+// Unlocks the vault and reads its directory. Chunks are only decrypted by readSealedChunk
+SealedOpenResult openSealedVault(SealedVault& sealed, const std::string& filename, std::string_view passphrase);
+// Another handle on a vault that is already unlocked, writable for the writer thread
+bool reopenSealedVault(SealedVault& sealed, const SealedVault& source, bool writable);
+void closeSealedVault(SealedVault& sealed);
+
+// Writes vault as a new sealed file next to filename and renames it over, then leaves sealed open on it
+bool createSealedVault(SealedVault& sealed, const std::string& filename, const SealedKey& key, const Vault& vault,
+                       uint64_t journalSeq);
+
+// Authenticates and decrypts one chunk, plain gets all of its slots
+bool readSealedChunk(const SealedVault& sealed, const SealedChunkEntry& chunk, SecureVector<char>& plain);
+
+// Fills the placeholder services [first, first + serviceCount) of vault from a decrypted chunk
+bool unpackSealedChunk(const SecureVector<char>& plain, uint32_t serviceCount, Vault& vault, size_t first);
+
+struct SealedChunkPlain {
+    uint32_t serviceCount = 0;
+    SecureVector<char> data;          // whole slots
+};
+
+// Serializes services [first, first + count) into as few chunks as fit them, appending to chunks
+bool packSealedChunks(const Vault& vault, size_t first, size_t count, std::vector<SealedChunkPlain>& chunks);
+
+// One chunk of the next directory: an unchanged chunk is just its committed entry, a changed one
+// brings its plaintext and gets its entry filled in by the commit
+struct SealedChunkUpdate {
+    SealedChunkEntry entry = {};
+    uint32_t serviceCount = 0;
+    SecureVector<char> plain;         // empty for an unchanged chunk
+};
+
+// Seals the changed chunks and the directory into free slots and switches roots. The vault
+// afterwards consists of chunks, in that order. Needs a writable handle
+bool commitSealedVault(SealedVault& sealed, std::vector<SealedChunkUpdate>& chunks, uint64_t journalSeq);
@@ -0,0 +1,509 @@
+#include "search.h"
+
+#include <algorithm>
+
+#include "text_match.h"
+#include "trace.h"
+
+// Posting keys: a trigram fills the low 24 bits, prefixes set one of these in the top byte
+const uint32_t LABEL_PREFIX_KEY = 1u << 24;
+const uint32_t WORD_PREFIX_KEY = 2u << 24;
+const uint32_t LONG_PREFIX_KEY = 4u << 24;     // two characters rather than one
+
+// fuzzyScore gives a label starting with the query at least 2 * 1500. Nothing else gets there
+const int LABEL_PREFIX_SCORE = 3000;
+const int MAX_SCATTERED_SCORE = 799;           // below the worst contiguous match
+const size_t MIN_TYPO_QUERY = 4;
+
+static char lowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+static uint32_t trigramKey(const char* p) {
+    return (static_cast<uint32_t>(static_cast<unsigned char>(p[0])) << 16) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(p[1])) << 8) |
+            static_cast<uint32_t>(static_cast<unsigned char>(p[2]));
+}
+
+// The first one or two characters of text
+static uint32_t prefixKey(uint32_t kind, std::string_view text) {
+    uint32_t key = kind | static_cast<unsigned char>(text[0]);
+    if (text.size() >= 2) key |= LONG_PREFIX_KEY | (static_cast<uint32_t>(static_cast<unsigned char>(text[1])) << 8);
+    return key;
+}
+
+static void appendField(std::string& text, std::string_view field) {
+    for (char c : field) {
+        // '\n' separates the fields, so it can't appear inside one
+        text.push_back(c == '\n' ? ' ' : lowerAscii(c));
+    }
+    text.push_back('\n');
+}
+
+static std::string_view documentText(const SearchIndex& index, const SearchDoc& doc) {
+    return std::string_view(index.text).substr(doc.textOffset, doc.textLength);
+}
+
+// Appends the service's text to the pool and points the document at it
+static void storeDocumentText(SearchIndex& index, SearchDoc& doc, const Vault& vault, size_t service) {
+    doc.textOffset = index.text.size();
+    appendField(index.text, vaultServiceLabel(vault, service));
+    for (size_t a = 0; a < vaultAccountCount(vault, service); ++a) {
+        appendField(index.text, vaultAccountName(vault, service, a));
+    }
+    doc.textLength = static_cast<uint32_t>(index.text.size() - doc.textOffset);
+}
+
+static void dropDocumentText(SearchIndex& index, SearchDoc& doc) {
+    index.staleBytes += doc.textLength;
+    doc.textLength = 0;
+}
+
+static void repackText(SearchIndex& index) {
+    if (index.staleBytes * 2 < index.text.size()) return;
+
+    std::string packed;
+    packed.reserve(index.text.size() - index.staleBytes);
+    for (SearchDoc& doc : index.docs) {
+        size_t offset = packed.size();
+        packed.append(index.text, doc.textOffset, doc.textLength);
+        doc.textOffset = offset;
+    }
+    index.text.swap(packed);
+    index.staleBytes = 0;
+}
+
+// Live documents among the first `count`
+static uint32_t liveBefore(const SearchIndex& index, size_t count) {
+    uint32_t live = 0;
+    for (size_t i = count; i > 0; i -= i & (~i + 1)) {
+        live += index.live[i - 1];
+    }
+    return live;
+}
+
+static void appendLive(SearchIndex& index) {
+    size_t i = index.live.size() + 1;
+    index.live.push_back(1 + liveBefore(index, i - 1) - liveBefore(index, i - (i & (~i + 1))));
+}
+
+static void removeLive(SearchIndex& index, uint32_t doc) {
+    for (size_t i = doc + 1; i <= index.live.size(); i += i & (~i + 1)) {
+        --index.live[i - 1];
+    }
+}
+
+// The document of the service'th live one, or docs.size() past the last
+static size_t docOfService(const SearchIndex& index, size_t service) {
+    size_t step = 1;
+    while (step * 2 <= index.live.size()) step *= 2;
+    size_t doc = 0;
+    size_t remaining = service + 1;
+    for (; step > 0; step /= 2) {
+        if (doc + step <= index.live.size() && index.live[doc + step - 1] < remaining) {
+            doc += step;
+            remaining -= index.live[doc - 1];
+        }
+    }
+    return doc;
+}
+
+static bool isWordStart(std::string_view field, size_t pos) {
+    if (pos == 0) return true;
+    char prev = field[pos - 1];
+    return prev == ' ' || prev == '-' || prev == '_' || prev == '.' || prev == '@' || prev == '/';
+}
+
+// Sorted, unique trigrams of every field, the label's prefixes and every word's. Nothing spans two fields
+static void documentKeys(std::string_view text, std::vector<uint32_t>& keys) {
+    keys.clear();
+    size_t fieldStart = 0;
+    while (fieldStart < text.size()) {
+        size_t fieldEnd = text.find('\n', fieldStart);
+        if (fieldEnd == std::string_view::npos) fieldEnd = text.size();
+        std::string_view field = text.substr(fieldStart, fieldEnd - fieldStart);
+        for (size_t i = 0; i < field.size(); ++i) {
+            if (i + 3 <= field.size()) keys.push_back(trigramKey(field.data() + i));
+            if (!isWordStart(field, i)) continue;
+            keys.push_back(prefixKey(WORD_PREFIX_KEY, field.substr(i, 1)));
+            if (i + 2 <= field.size()) keys.push_back(prefixKey(WORD_PREFIX_KEY, field.substr(i, 2)));
+        }
+        if (fieldStart == 0 && !field.empty()) {
+            keys.push_back(prefixKey(LABEL_PREFIX_KEY, field.substr(0, 1)));
+            if (field.size() >= 2) keys.push_back(prefixKey(LABEL_PREFIX_KEY, field.substr(0, 2)));
+        }
+        fieldStart = fieldEnd + 1;
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+static void insertPosting(std::vector<uint32_t>& list, uint32_t doc) {
+    // New documents get the highest id, so this is almost always an append
+    if (list.empty() || list.back() < doc) {
+        list.push_back(doc);
+        return;
+    }
+    auto it = std::lower_bound(list.begin(), list.end(), doc);
+    if (it == list.end() || *it != doc) list.insert(it, doc);
+}
+
+static void erasePosting(SearchIndex& index, uint32_t key, uint32_t doc) {
+    auto found = index.postings.find(key);
+    if (found == index.postings.end()) return;
+    std::vector<uint32_t>& list = found->second;
+    auto it = std::lower_bound(list.begin(), list.end(), doc);
+    if (it != list.end() && *it == doc) list.erase(it);
+    if (list.empty()) index.postings.erase(found);
+}
+
+void buildSearchIndex(SearchIndex& index, const Vault& vault) {
+    TRACE_SCOPE("buildSearchIndex");
+    index.docs.clear();
+    index.live.clear();
+    index.postings.clear();
+    index.text.clear();
+    index.staleBytes = 0;
+    size_t serviceCount = vaultServiceCount(vault);
+    index.docs.reserve(serviceCount);
+    index.live.reserve(serviceCount);
+    index.text.reserve(vault.pool.size());
+
+    for (size_t i = 0; i < serviceCount; ++i) {
+        searchAddService(index, vault, i);
+    }
+}
+
+void searchAddService(SearchIndex& index, const Vault& vault, size_t service) {
+    uint32_t doc = static_cast<uint32_t>(index.docs.size());
+    index.docs.push_back({ 0, 0 });
+    appendLive(index);
+    storeDocumentText(index, index.docs.back(), vault, service);
+
+    std::vector<uint32_t> keys;
+    documentKeys(documentText(index, index.docs.back()), keys);
+    for (uint32_t key : keys) {
+        insertPosting(index.postings[key], doc);
+    }
+}
+
+void searchUpdateService(SearchIndex& index, const Vault& vault, size_t serviceIndex) {
+    size_t doc = docOfService(index, serviceIndex);
+    if (doc >= index.docs.size()) return;
+    SearchDoc& entry = index.docs[doc];
+
+    std::vector<uint32_t> oldKeys, newKeys;
+    documentKeys(documentText(index, entry), oldKeys);
+    dropDocumentText(index, entry);
+    storeDocumentText(index, entry, vault, serviceIndex);
+    documentKeys(documentText(index, entry), newKeys);
+
+    // Only the keys that came or went touch the posting lists
+    size_t o = 0, n = 0;
+    while (o < oldKeys.size() || n < newKeys.size()) {
+        if (n == newKeys.size() || (o < oldKeys.size() && oldKeys[o] < newKeys[n])) {
+            erasePosting(index, oldKeys[o++], static_cast<uint32_t>(doc));
+        } else if (o == oldKeys.size() || newKeys[n] < oldKeys[o]) {
+            insertPosting(index.postings[newKeys[n++]], static_cast<uint32_t>(doc));
+        } else {
+            ++o;
+            ++n;
+        }
+    }
+    repackText(index);
+}
+
+void searchRemoveService(SearchIndex& index, size_t serviceIndex) {
+    size_t doc = docOfService(index, serviceIndex);
+    if (doc >= index.docs.size()) return;
+    SearchDoc& entry = index.docs[doc];
+
+    std::vector<uint32_t> keys;
+    documentKeys(documentText(index, entry), keys);
+    for (uint32_t key : keys) {
+        erasePosting(index, key, static_cast<uint32_t>(doc));
+    }
+    dropDocumentText(index, entry);
+    // The services after it move up a slot just by no longer counting it
+    removeLive(index, static_cast<uint32_t>(doc));
+    repackText(index);
+}
+
+// Whether query is a subsequence of field, with runs and word starts rewarded. charAt(q) is the
+// q'th of queryLength characters, so a typo can be tried without building the corrected query
+template <typename CharAt>
+static int scatteredScore(std::string_view field, size_t queryLength, CharAt charAt) {
+    int score = 0;
+    int run = 0;
+    size_t q = 0;
+    size_t lastMatch = 0;
+    for (size_t i = 0; i < field.size() && q < queryLength; ++i) {
+        if (field[i] != charAt(q)) {
+            run = 0;
+            continue;
+        }
+        score += 10 + 5 * run;
+        if (isWordStart(field, i)) score += 20;
+        if (q > 0) score -= static_cast<int>(std::min<size_t>(i - lastMatch - 1, 10));
+        lastMatch = i;
+        ++run;
+        ++q;
+    }
+    return q == queryLength ? std::clamp(score, 1, MAX_SCATTERED_SCORE) : -1;
+}
+
+static int fieldScore(std::string_view field, std::string_view query, bool typos) {
+    if (query.empty()) return 0;
+    if (query.size() > field.size() + 1) return -1;
+
+    // A contiguous match beats any scattered one; earlier and on a word boundary is better still
+    size_t found = field.find(query);
+    if (found != std::string_view::npos) {
+        int score = 1000 - static_cast<int>(std::min<size_t>(found, 200));
+        if (found == 0) score += 500;
+        else if (isWordStart(field, found)) score += 250;
+        if (query.size() == field.size()) score += 250;
+        return score;
+    }
+
+    // Otherwise every query character has to appear in order
+    int score = query.size() <= field.size() ? scatteredScore(field, query.size(), [&](size_t q) { return query[q]; }) : -1;
+    if (score >= 0 || !typos || query.size() < MIN_TYPO_QUERY) return score;
+
+    // Or in order once one typo is undone, for a quarter of the score
+    int best = -1;
+    for (size_t t = 0; t < query.size(); ++t) {
+        if (t + 1 < query.size() && query[t] != query[t + 1]) {
+            best = std::max(best, scatteredScore(field, query.size(), [&](size_t q) {
+                return query[q == t ? t + 1 : q == t + 1 ? t : q];
+            }));
+        }
+        best = std::max(best, scatteredScore(field, query.size() - 1, [&](size_t q) { return query[q < t ? q : q + 1]; }));
+    }
+    return best >= 0 ? std::max(best / 4, 1) : -1;
+}
+
+int fuzzyScore(std::string_view field, std::string_view query) {
+    return fieldScore(field, query, true);
+}
+
+static int scoreFields(std::string_view text, std::string_view query, bool typos) {
+    int best = -1;
+    bool label = true;
+    size_t fieldStart = 0;
+    while (fieldStart < text.size()) {
+        size_t fieldEnd = text.find('\n', fieldStart);
+        if (fieldEnd == std::string_view::npos) fieldEnd = text.size();
+        int score = fieldScore(text.substr(fieldStart, fieldEnd - fieldStart), query, typos);
+        if (score >= 0) {
+            best = std::max(best, label ? score * 2 : score);
+        }
+        label = false;
+        fieldStart = fieldEnd + 1;
+    }
+    return best;
+}
+
+// Labels count double so a service named after the query ranks above one with a matching account.
+// Any field matching as typed outranks a typo, so typos are only tried when none does
+static int scoreDocument(std::string_view text, std::string_view query) {
+    int best = scoreFields(text, query, false);
+    return best >= 0 ? best : scoreFields(text, query, true);
+}
+
+// Best first, then in service order. Document ids are in service order too
+static bool betterResult(const SearchResult& a, const SearchResult& b) {
+    return a.score != b.score ? a.score > b.score : a.service < b.service;
+}
+
+// One query in progress. Until the end, results hold document ids rather than services
+struct SearchRun {
+    const SearchIndex& index;
+    std::string_view query;
+    size_t maxResults;
+    size_t budget;                      // documents left to score
+    std::vector<SearchResult> top;      // heap of the best so far, worst on top
+    std::vector<uint32_t> seen;         // documents scored by earlier passes, sorted
+    std::vector<uint32_t> pass;         // documents scored by this pass, in order
+};
+
+// False once the budget is spent
+static bool scoreCandidate(SearchRun& run, uint32_t doc) {
+    if (std::binary_search(run.seen.begin(), run.seen.end(), doc)) return true;
+    if (run.budget == 0) return false;
+    --run.budget;
+    run.pass.push_back(doc);
+
+    int score = scoreDocument(documentText(run.index, run.index.docs[doc]), run.query);
+    if (score < 0) return true;
+    SearchResult result = { doc, score };
+    if (run.top.size() < run.maxResults) {
+        run.top.push_back(result);
+        std::push_heap(run.top.begin(), run.top.end(), betterResult);
+    } else if (betterResult(result, run.top.front())) {
+        std::pop_heap(run.top.begin(), run.top.end(), betterResult);
+        run.top.back() = result;
+        std::push_heap(run.top.begin(), run.top.end(), betterResult);
+    }
+    return true;
+}
+
+static void endPass(SearchRun& run) {
+    size_t middle = run.seen.size();
+    run.seen.insert(run.seen.end(), run.pass.begin(), run.pass.end());
+    std::inplace_merge(run.seen.begin(), run.seen.begin() + middle, run.seen.end());
+    run.pass.clear();
+}
+
+static bool topFull(const SearchRun& run) {
+    return run.top.size() == run.maxResults;
+}
+
+static const std::vector<uint32_t>* postingList(const SearchIndex& index, uint32_t key) {
+    static const std::vector<uint32_t> empty;
+    auto found = index.postings.find(key);
+    return found == index.postings.end() ? &empty : &found->second;
+}
+
+// First position at or after `from` whose document is not below doc. Probes come in order and
+// mostly land close to the last one, so this gallops out from there before bisecting
+static size_t seekPosting(const std::vector<uint32_t>& list, size_t from, uint32_t doc) {
+    size_t step = 1;
+    size_t end = from;
+    while (end < list.size() && list[end] < doc) {
+        from = end + 1;
+        end += step;
+        step *= 2;
+    }
+    return std::lower_bound(list.begin() + from, list.begin() + std::min(end, list.size()), doc) - list.begin();
+}
+
+// Calls visit with every document on at least `needed` of the lists, in order, until it returns
+// false. A document can miss at most lists.size() - needed lists, so it is on one of the
+// lists.size() - needed + 1 shortest; those drive and the rest are only probed
+template <typename Visit>
+static void forEachMatch(std::vector<const std::vector<uint32_t>*> lists, size_t needed, Visit visit) {
+    if (needed == 0 || needed > lists.size()) return;
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+        return a->size() < b->size();
+    });
+    size_t drivers = lists.size() - needed + 1;
+    std::vector<size_t> cursors(lists.size(), 0);
+    for (;;) {
+        uint32_t doc = UINT32_MAX;
+        for (size_t l = 0; l < drivers; ++l) {
+            if (cursors[l] < lists[l]->size()) doc = std::min(doc, (*lists[l])[cursors[l]]);
+        }
+        if (doc == UINT32_MAX) return;
+
+        size_t hits = 0;
+        for (size_t l = 0; l < drivers; ++l) {
+            if (cursors[l] < lists[l]->size() && (*lists[l])[cursors[l]] == doc) {
+                ++hits;
+                ++cursors[l];
+            }
+        }
+        for (size_t l = drivers; l < lists.size() && hits + lists.size() - l >= needed; ++l) {
+            const std::vector<uint32_t>& list = *lists[l];
+            cursors[l] = seekPosting(list, cursors[l], doc);
+            if (cursors[l] < list.size() && list[cursors[l]] == doc) ++hits;
+        }
+        if (hits >= needed && !visit(doc)) return;
+    }
+}
+
+// Documents containing query anywhere, in id order, from one findText pass over the pool. Documents
+// mostly sit in the pool in id order, so one hit answers for every document before it. An edited
+// document appended again after its neighbours is searched on its own
+template <typename Visit>
+static void forEachContaining(const SearchIndex& index, std::string_view query, Visit visit) {
+    std::string_view pool = index.text;
+    size_t searchedFrom = 0;
+    size_t hit = findText(pool, query);
+    for (uint32_t doc = 0; doc < index.docs.size(); ++doc) {
+        const SearchDoc& entry = index.docs[doc];
+        if (entry.textLength == 0) continue;
+        size_t end = entry.textOffset + entry.textLength;
+        bool inOrder = entry.textOffset >= searchedFrom && (doc + 1 == index.docs.size() || index.docs[doc + 1].textOffset >= end);
+        bool contains;
+        if (inOrder) {
+            if (hit < entry.textOffset) {
+                searchedFrom = entry.textOffset;
+                hit = findText(pool, query, searchedFrom);
+            }
+            // The query has no '\n', so a hit starting inside the document ends inside it too
+            contains = hit < end;
+        } else {
+            contains = findText(documentText(index, entry), query) != std::string_view::npos;
+        }
+        if (contains && !visit(doc)) return;
+    }
+}
+
+static bool labelStartsWith(const SearchIndex& index, uint32_t doc, std::string_view query) {
+    std::string_view text = documentText(index, index.docs[doc]);
+    return text.substr(0, text.find('\n')).substr(0, query.size()) == query;
+}
+
+void searchServices(const SearchIndex& index, std::string_view query, std::vector<SearchResult>& results, size_t maxResults) {
+    TRACE_SCOPE("searchServices");
+    results.clear();
+
+    std::string lowered;
+    lowered.reserve(query.size());
+    for (char c : query) lowered.push_back(lowerAscii(c));
+    if (lowered.empty() || maxResults == 0) return;
+
+    SearchRun run = { index, lowered, maxResults, std::max(SEARCH_MAX_CANDIDATES, maxResults), {}, {}, {} };
+    std::vector<const std::vector<uint32_t>*> trigrams;
+    for (size_t i = 0; i + 3 <= lowered.size(); ++i) {
+        trigrams.push_back(postingList(index, trigramKey(lowered.data() + i)));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    // Labels starting with the query outscore everything else, and among themselves only an exact
+    // match beats the earlier service. Once maxResults of them are in nothing left can rank higher
+    std::vector<const std::vector<uint32_t>*> labelLists = trigrams;
+    labelLists.push_back(postingList(index, prefixKey(LABEL_PREFIX_KEY, lowered)));
+    size_t labelHits = 0;
+    forEachMatch(labelLists, labelLists.size(), [&](uint32_t doc) {
+        if (lowered.size() > 2 && !labelStartsWith(index, doc, lowered)) return true;
+        return scoreCandidate(run, doc) && ++labelHits < maxResults;
+    });
+    endPass(run);
+    bool done = topFull(run) && run.top.front().score >= LABEL_PREFIX_SCORE;
+
+    if (!done && lowered.size() < 3) {
+        forEachMatch({ postingList(index, prefixKey(WORD_PREFIX_KEY, lowered)) }, 1, [&](uint32_t doc) {
+            return scoreCandidate(run, doc);
+        });
+        endPass(run);
+        // Too few words start with it, so "ma" still finds "gmail"
+        if (!topFull(run)) {
+            forEachContaining(index, lowered, [&](uint32_t doc) { return scoreCandidate(run, doc); });
+        }
+    } else if (!done) {
+        // Every trigram first, then documents missing a typo's worth of them
+        forEachMatch(trigrams, trigrams.size(), [&](uint32_t doc) { return scoreCandidate(run, doc); });
+        endPass(run);
+        if (!topFull(run) && trigrams.size() > 1) {
+            size_t needed = trigrams.size() > 3 ? trigrams.size() - 2 : 1;
+            forEachMatch(trigrams, needed, [&](uint32_t doc) { return scoreCandidate(run, doc); });
+            endPass(run);
+        }
+        // A short query with a typo or a skipped letter can keep none of its trigrams, but labels
+        // mostly start right
+        if (!topFull(run)) {
+            forEachMatch({ postingList(index, prefixKey(LABEL_PREFIX_KEY, lowered.substr(0, 1))) }, 1, [&](uint32_t doc) {
+                return scoreCandidate(run, doc) && !topFull(run);
+            });
+        }
+    }
+
+    results = std::move(run.top);
+    std::sort(results.begin(), results.end(), betterResult);
+    for (SearchResult& result : results) {
+        result.service = liveBefore(index, result.service);
+    }
+}
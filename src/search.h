@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "vault.h"
+
+const size_t SEARCH_MAX_RESULTS = 1000;
+// Documents scored per query at most, which is what keeps a keystroke under a millisecond
+const size_t SEARCH_MAX_CANDIDATES = 4000;
+
+// Everything searchable about one service: its label and account names, lowercased.
+// Documents keep their id for life, so deleting a service never renumbers the posting lists.
+// Services are only ever appended, so ids follow service order and a document's service is the
+// number of live documents before it
+struct SearchDoc {
+    size_t textOffset;         // label, then each account name, every field terminated by '\n'
+    uint32_t textLength;       // 0 once deleted
+};
+
+// Trigram index over service labels and account names, plus the first one and two characters of
+// every label and every word for queries too short to have a trigram
+struct SearchIndex {
+    std::vector<SearchDoc> docs;
+    std::vector<uint32_t> live;   // Fenwick tree over docs counting the live ones, maps services to documents and back
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings;   // trigram or prefix key -> sorted doc ids
+
+    // Document texts back to back. Edited documents are appended again and the pool is repacked
+    // once half of it is stale
+    std::string text;
+    size_t staleBytes = 0;
+};
+
+struct SearchResult {
+    uint32_t service;
+    int score;
+};
+
+void buildSearchIndex(SearchIndex& index, const Vault& vault);
+
+// Keep the index in step with the vault: a service appended at the end, a service whose
+// accounts changed, and a service deleted from it
+void searchAddService(SearchIndex& index, const Vault& vault, size_t service);
+void searchUpdateService(SearchIndex& index, const Vault& vault, size_t serviceIndex);
+void searchRemoveService(SearchIndex& index, size_t serviceIndex);
+
+// Ranks the services matching query, best first. Services whose label starts with the query come
+// first and are found from their prefix lists, so typing a name stops as soon as maxResults of them
+// are in. Otherwise candidates are every document with all of the query's trigrams, then those
+// missing up to two, then labels starting with the query's first character for typos and skipped
+// letters. One and two character queries match at the start of a word, and anywhere only when
+// those don't fill the results. After
+// SEARCH_MAX_CANDIDATES documents the rest are left unscored, so past the label matches a large
+// result set is the best of the earliest services rather than of all of them
+void searchServices(const SearchIndex& index, std::string_view query, std::vector<SearchResult>& results, size_t maxResults = SEARCH_MAX_RESULTS);
+
+// Fuzzy score of query against a single lowercased field, or -1 if it doesn't match. A contiguous
+// match beats a scattered one, which beats a match with one typo. Typos are two neighbouring
+// characters swapped or one character too many, and only count for queries of four or more
+int fuzzyScore(std::string_view field, std::string_view query);
@@ -0,0 +1,55 @@
+#include "secure_alloc.h"
+
+#include <atomic>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+static std::atomic<uint64_t> allocations{ 0 };
+static std::atomic<uint64_t> releases{ 0 };
+static std::atomic<uint64_t> bytesAllocated{ 0 };
+static std::atomic<uint64_t> bytesLive{ 0 };
+
+void secureWipe(void* data, size_t size) {
+    if (!data || size == 0) return;
+#ifdef _WIN32
+    SecureZeroMemory(data, size);
+#else
+    volatile unsigned char* bytes = static_cast<volatile unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = 0;
+    }
+#endif
+}
+
+void* secureAllocate(size_t size) {
+    void* data = ::operator new(size);
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    bytesLive.fetch_add(size, std::memory_order_relaxed);
+    return data;
+}
+
+void secureRelease(void* data, size_t size) {
+    if (!data) return;
+    secureWipe(data, size);
+    releases.fetch_add(1, std::memory_order_relaxed);
+    bytesLive.fetch_sub(size, std::memory_order_relaxed);
+    ::operator delete(data);
+}
+
+SecureAllocStats secureAllocStats() {
+    return {
+        allocations.load(std::memory_order_relaxed),
+        releases.load(std::memory_order_relaxed),
+        bytesAllocated.load(std::memory_order_relaxed),
+        bytesLive.load(std::memory_order_relaxed),
+    };
+}
+
+void printSecureAllocStats(const SecureAllocStats& stats, std::ostream& out) {
+    out << stats.allocations << " allocations, " << stats.releases << " releases, "
+        << stats.bytesAllocated << " bytes allocated, " << stats.bytesLive << " bytes live" << std::endl;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Overwrites memory in a way the compiler can't drop as a dead store
+void secureWipe(void* data, size_t size);
+
+// Every block handed out for vault data, counted, and wiped before it goes back to the heap.
+// That covers the buffers a container outgrows as well as the ones still in use on close
+void* secureAllocate(size_t size);
+void secureRelease(void* data, size_t size);
+
+struct SecureAllocStats {
+    uint64_t allocations;
+    uint64_t releases;
+    uint64_t bytesAllocated;
+    uint64_t bytesLive;
+};
+
+// Totals since startup, safe to read while the writer thread allocates
+SecureAllocStats secureAllocStats();
+void printSecureAllocStats(const SecureAllocStats& stats, std::ostream& out);
+
+template <typename T>
+struct SecureAllocator {
+    using value_type = T;
+
+    SecureAllocator() = default;
+    template <typename U>
+    SecureAllocator(const SecureAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(secureAllocate(count * sizeof(T)));
+    }
+    void deallocate(T* data, size_t count) {
+        secureRelease(data, count * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const SecureAllocator<T>&, const SecureAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const SecureAllocator<T>&, const SecureAllocator<U>&) { return false; }
+
+using SecureString = std::basic_string<char, std::char_traits<char>, SecureAllocator<char>>;
+template <typename T>
+using SecureVector = std::vector<T, SecureAllocator<T>>;
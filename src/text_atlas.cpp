@@ -0,0 +1,272 @@
+#include "text_atlas.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "frame_stats.h"
+#include "trace.h"
+
+// Index into the baked glyphs, or -1 for a character outside printable ASCII
+static int glyphIndex(Uint32 ch) {
+    if (ch < ATLAS_FIRST_CHAR || ch > ATLAS_LAST_CHAR) {
+        return -1;
+    }
+    return static_cast<int>(ch) - ATLAS_FIRST_CHAR;
+}
+
+// Decodes the UTF-8 character at text[i] and moves i past it. A malformed or cut off sequence
+// decodes as one '?'
+static Uint32 nextCharacter(std::string_view text, size_t& i) {
+    unsigned char lead = static_cast<unsigned char>(text[i++]);
+    if (lead < 0x80) return lead;
+    int extra = lead >= 0xF0 && lead < 0xF5 ? 3 : lead >= 0xE0 && lead < 0xF0 ? 2 : lead >= 0xC2 && lead < 0xE0 ? 1 : 0;
+    if (extra == 0) return '?';
+    Uint32 ch = lead & (0x3F >> extra);
+    for (int k = 0; k < extra; ++k) {
+        if (i >= text.size() || (static_cast<unsigned char>(text[i]) & 0xC0) != 0x80) return '?';
+        ch = (ch << 6) | (static_cast<unsigned char>(text[i++]) & 0x3F);
+    }
+    return ch;
+}
+
+// Finds room for a w x h cell on the current shelf or a new one below it
+static bool placeCell(GlyphAtlas& atlas, int w, int h, SDL_Rect& cell) {
+    if (atlas.penX + w > ATLAS_TEXTURE_WIDTH) {
+        atlas.penX = 0;
+        atlas.penY += atlas.shelfHeight + 1;
+        atlas.shelfHeight = 0;
+    }
+    if (w > ATLAS_TEXTURE_WIDTH || atlas.penY + h > ATLAS_TEXTURE_HEIGHT) return false;
+    cell = { atlas.penX, atlas.penY, w, h };
+    atlas.penX += w + 1;
+    atlas.shelfHeight = std::max(atlas.shelfHeight, h);
+    return true;
+}
+
+// A character outside printable ASCII, rasterized and uploaded into the atlas the first time
+static const Glyph& extraGlyph(GlyphAtlas& atlas, Uint32 ch) {
+    auto found = atlas.extraGlyphs.find(ch);
+    if (found != atlas.extraGlyphs.end()) return found->second;
+
+    TRACE_SCOPE("rasterizeGlyph");
+    Glyph glyph = atlas.glyphs['?' - ATLAS_FIRST_CHAR];
+    int minX = 0, maxX = 0, minY = 0, maxY = 0, advance = 0;
+    if (atlas.font && ch <= 0x10FFFF && TTF_GlyphIsProvided32(atlas.font, ch) &&
+        TTF_GlyphMetrics32(atlas.font, ch, &minX, &maxX, &minY, &maxY, &advance) == 0) {
+        SDL_Color white = { 255, 255, 255, 255 };
+        SDL_Surface* rendered = TTF_RenderGlyph32_Blended(atlas.font, ch, white);
+        ++renderCounters.ttfRenders;
+        SDL_Surface* converted = rendered ? SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_RGBA32, 0) : nullptr;
+        SDL_FreeSurface(rendered);
+        SDL_Rect cell;
+        if (converted && placeCell(atlas, converted->w, converted->h, cell) &&
+            SDL_UpdateTexture(atlas.texture, &cell, converted->pixels, converted->pitch) == 0) {
+            glyph = { cell, (minX < 0) ? minX : 0, advance };
+        }
+        SDL_FreeSurface(converted);
+    }
+    // Stored even when it fell back to '?', so a missing character is only looked up once
+    return atlas.extraGlyphs.emplace(ch, glyph).first->second;
+}
+
+bool createGlyphAtlas(GlyphAtlas& atlas, SDL_Renderer* renderer, TTF_Font* font) {
+    TRACE_SCOPE("createGlyphAtlas");
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Surface* glyphSurfs[ATLAS_GLYPH_COUNT] = {};
+
+    // Shelf-pack the glyph cells row by row, the rest of the texture is left for other characters
+    atlas.font = font;
+    atlas.extraGlyphs.clear();
+    atlas.penX = 0;
+    atlas.penY = 0;
+    atlas.shelfHeight = 0;
+    for (int i = 0; i < ATLAS_GLYPH_COUNT; ++i) {
+        Uint32 ch = static_cast<Uint32>(ATLAS_FIRST_CHAR + i);
+        int minX = 0, maxX = 0, minY = 0, maxY = 0, advance = 0;
+        TTF_GlyphMetrics32(font, ch, &minX, &maxX, &minY, &maxY, &advance);
+
+        Glyph& glyph = atlas.glyphs[i];
+        glyph.advance = advance;
+        glyph.offsetX = (minX < 0) ? minX : 0;
+        glyph.src = { 0, 0, 0, 0 };
+
+        glyphSurfs[i] = TTF_RenderGlyph32_Blended(font, ch, white);
+        ++renderCounters.ttfRenders;
+        if (glyphSurfs[i] && !placeCell(atlas, glyphSurfs[i]->w, glyphSurfs[i]->h, glyph.src)) {
+            SDL_FreeSurface(glyphSurfs[i]);
+            glyphSurfs[i] = nullptr;
+        }
+    }
+
+    atlas.textureWidth = ATLAS_TEXTURE_WIDTH;
+    atlas.textureHeight = ATLAS_TEXTURE_HEIGHT;
+    atlas.lineHeight = TTF_FontHeight(font);
+
+    SDL_Surface* atlasSurf = SDL_CreateRGBSurfaceWithFormat(0, atlas.textureWidth, atlas.textureHeight, 32, SDL_PIXELFORMAT_RGBA32);
+    if (!atlasSurf) {
+        std::cerr << "Failed to create glyph atlas surface: " << SDL_GetError() << std::endl;
+        for (SDL_Surface* surf : glyphSurfs) SDL_FreeSurface(surf);
+        return false;
+    }
+    SDL_FillRect(atlasSurf, nullptr, SDL_MapRGBA(atlasSurf->format, 255, 255, 255, 0));
+
+    for (int i = 0; i < ATLAS_GLYPH_COUNT; ++i) {
+        if (!glyphSurfs[i]) continue;
+        // Copy the glyph alpha as-is instead of blending it onto the empty atlas
+        SDL_SetSurfaceBlendMode(glyphSurfs[i], SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(glyphSurfs[i], nullptr, atlasSurf, &atlas.glyphs[i].src);
+        SDL_FreeSurface(glyphSurfs[i]);
+    }
+
+    // Created in the surface's format rather than from it, so later glyphs can be uploaded as RGBA too
+    atlas.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, atlas.textureWidth, atlas.textureHeight);
+    if (!atlas.texture || SDL_UpdateTexture(atlas.texture, nullptr, atlasSurf->pixels, atlasSurf->pitch) != 0) {
+        std::cerr << "Failed to create glyph atlas texture: " << SDL_GetError() << std::endl;
+        SDL_FreeSurface(atlasSurf);
+        return false;
+    }
+    SDL_FreeSurface(atlasSurf);
+    ++renderCounters.textureCreates;
+    SDL_SetTextureBlendMode(atlas.texture, SDL_BLENDMODE_BLEND);
+
+    for (int a = 0; a < ATLAS_GLYPH_COUNT; ++a) {
+        for (int b = 0; b < ATLAS_GLYPH_COUNT; ++b) {
+            int kern = TTF_GetFontKerningSizeGlyphs32(font, ATLAS_FIRST_CHAR + a, ATLAS_FIRST_CHAR + b);
+            atlas.kerning[a][b] = static_cast<signed char>(std::clamp(kern, -128, 127));
+        }
+    }
+
+    // Room for a few hundred characters up front; longer strings grow the buffers once
+    atlas.vertices.reserve(256 * 4);
+    atlas.indices.reserve(256 * 6);
+    return true;
+}
+
+void destroyGlyphAtlas(GlyphAtlas& atlas) {
+    if (atlas.texture) {
+        SDL_DestroyTexture(atlas.texture);
+        ++renderCounters.textureDestroys;
+        atlas.texture = nullptr;
+    }
+    atlas.extraGlyphs.clear();
+    atlas.vertices.clear();
+    atlas.vertices.shrink_to_fit();
+    atlas.indices.clear();
+    atlas.indices.shrink_to_fit();
+}
+
+int measureText(GlyphAtlas& atlas, std::string_view text) {
+    int width = 0;
+    int prev = -1;
+    for (size_t i = 0; i < text.size();) {
+        Uint32 ch = nextCharacter(text, i);
+        int index = glyphIndex(ch);
+        // Kerning is only known between the baked glyphs
+        if (prev >= 0 && index >= 0) width += atlas.kerning[prev][index];
+        width += index >= 0 ? atlas.glyphs[index].advance : extraGlyph(atlas, ch).advance;
+        prev = index;
+    }
+    return width;
+}
+
+int drawText(SDL_Renderer* renderer, GlyphAtlas& atlas, std::string_view text, int x, int y, SDL_Color color) {
+    if (!atlas.texture || text.empty()) return x;
+
+    atlas.vertices.clear();
+    atlas.indices.clear();
+
+    float invW = 1.0f / static_cast<float>(atlas.textureWidth);
+    float invH = 1.0f / static_cast<float>(atlas.textureHeight);
+    int penX = x;
+    int prev = -1;
+
+    for (size_t i = 0; i < text.size();) {
+        Uint32 ch = nextCharacter(text, i);
+        int index = glyphIndex(ch);
+        const Glyph& glyph = index >= 0 ? atlas.glyphs[index] : extraGlyph(atlas, ch);
+        if (prev >= 0 && index >= 0) penX += atlas.kerning[prev][index];
+        prev = index;
+
+        if (glyph.src.w > 0 && glyph.src.h > 0) {
+            float x0 = static_cast<float>(penX + glyph.offsetX);
+            float y0 = static_cast<float>(y);
+            float x1 = x0 + glyph.src.w;
+            float y1 = y0 + glyph.src.h;
+            float u0 = glyph.src.x * invW;
+            float v0 = glyph.src.y * invH;
+            float u1 = (glyph.src.x + glyph.src.w) * invW;
+            float v1 = (glyph.src.y + glyph.src.h) * invH;
+
+            int base = static_cast<int>(atlas.vertices.size());
+            atlas.vertices.push_back({ { x0, y0 }, color, { u0, v0 } });
+            atlas.vertices.push_back({ { x1, y0 }, color, { u1, v0 } });
+            atlas.vertices.push_back({ { x1, y1 }, color, { u1, v1 } });
+            atlas.vertices.push_back({ { x0, y1 }, color, { u0, v1 } });
+
+            const int quad[6] = { 0, 1, 2, 0, 2, 3 };
+            for (int q : quad) atlas.indices.push_back(base + q);
+        }
+
+        penX += glyph.advance;
+    }
+
+    if (!atlas.indices.empty()) {
+        SDL_RenderGeometry(renderer, atlas.texture,
+                           atlas.vertices.data(), static_cast<int>(atlas.vertices.size()),
+                           atlas.indices.data(), static_cast<int>(atlas.indices.size()));
+    }
+    return penX;
+}
+
+void drawTextCentered(SDL_Renderer* renderer, GlyphAtlas& atlas, std::string_view text, const SDL_Rect& rect, SDL_Color color) {
+    int w = measureText(atlas, text);
+    drawText(renderer, atlas, text,
+             rect.x + (rect.w - w) / 2,
+             rect.y + (rect.h - atlas.lineHeight) / 2,
+             color);
+}
+
+// Returns the length of the next line starting at text[0] that fits into wrapWidth,
+// breaking on spaces when possible. The line's width goes to lineWidth
+static size_t nextWrappedLine(GlyphAtlas& atlas, std::string_view text, int wrapWidth, int& lineWidth) {
+    size_t lineEnd = 0;
+    size_t pos = 0;
+    lineWidth = 0;
+
+    while (pos < text.size()) {
+        size_t wordEnd = text.find(' ', pos);
+        if (wordEnd == std::string_view::npos) wordEnd = text.size();
+
+        int width = measureText(atlas, text.substr(0, wordEnd));
+        if (width > wrapWidth && lineEnd > 0) break;
+
+        lineEnd = wordEnd;
+        lineWidth = width;
+        pos = wordEnd + 1;
+    }
+
+    return lineEnd;
+}
+
+void drawTextWrapped(SDL_Renderer* renderer, GlyphAtlas& atlas, std::string_view text, const SDL_Rect& rect, int wrapWidth, SDL_Color color) {
+    // First pass finds the widest line so the block can be centered like a single surface would be
+    int blockWidth = 0;
+    std::string_view rest = text;
+    while (!rest.empty()) {
+        int lineWidth = 0;
+        size_t len = nextWrappedLine(atlas, rest, wrapWidth, lineWidth);
+        blockWidth = std::max(blockWidth, lineWidth);
+        rest.remove_prefix(std::min(len + 1, rest.size()));
+    }
+
+    int x = rect.x + (rect.w - blockWidth) / 2;
+    int y = rect.y;
+    rest = text;
+    while (!rest.empty()) {
+        int lineWidth = 0;
+        size_t len = nextWrappedLine(atlas, rest, wrapWidth, lineWidth);
+        drawText(renderer, atlas, rest.substr(0, len), x, y, color);
+        y += atlas.lineHeight;
+        rest.remove_prefix(std::min(len + 1, rest.size()));
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Printable ASCII is baked into the atlas up front. Any other character is rasterized into the room
+// left below it the first time it is drawn, and draws as '?' if the font lacks it or the atlas is full
+const int ATLAS_FIRST_CHAR = 32;
+const int ATLAS_LAST_CHAR = 126;
+const int ATLAS_GLYPH_COUNT = ATLAS_LAST_CHAR - ATLAS_FIRST_CHAR + 1;
+const int ATLAS_TEXTURE_WIDTH = 512;
+const int ATLAS_TEXTURE_HEIGHT = 512;
+
+struct Glyph {
+    SDL_Rect src;   // where the glyph cell sits inside the atlas texture
+    int offsetX;    // shift applied to the pen position for glyphs with a negative bearing
+    int advance;
+};
+
+struct GlyphAtlas {
+    TTF_Font* font = nullptr;       // kept for the characters rasterized on demand
+    SDL_Texture* texture = nullptr;
+    int textureWidth = 0;
+    int textureHeight = 0;
+    int lineHeight = 0;
+    Glyph glyphs[ATLAS_GLYPH_COUNT];
+    signed char kerning[ATLAS_GLYPH_COUNT][ATLAS_GLYPH_COUNT];
+    std::unordered_map<Uint32, Glyph> extraGlyphs;   // everything outside printable ASCII drawn so far
+
+    // Shelf packing state, where the next glyph cell goes
+    int penX = 0;
+    int penY = 0;
+    int shelfHeight = 0;
+
+    // Scratch buffers reused by every draw call, so steady-state drawing does not allocate
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+};
+
+// Rasterizes the printable ASCII glyphs of the font once and uploads them into a single texture.
+// The font has to outlive the atlas
+bool createGlyphAtlas(GlyphAtlas& atlas, SDL_Renderer* renderer, TTF_Font* font);
+void destroyGlyphAtlas(GlyphAtlas& atlas);
+
+// Text is UTF-8. Measuring may rasterize characters not drawn before, like drawing does
+int measureText(GlyphAtlas& atlas, std::string_view text);
+
+// Draws text with its top-left corner at (x, y) as one batch of textured quads.
+// Returns the pen position after the last glyph so strings can be chained without concatenating
+int drawText(SDL_Renderer* renderer, GlyphAtlas& atlas, std::string_view text, int x, int y, SDL_Color color);
+void drawTextCentered(SDL_Renderer* renderer, GlyphAtlas& atlas, std::string_view text, const SDL_Rect& rect, SDL_Color color);
+
+// Word-wraps text to wrapWidth and draws the block horizontally centered in rect, starting at rect.y
+void drawTextWrapped(SDL_Renderer* renderer, GlyphAtlas& atlas, std::string_view text, const SDL_Rect& rect, int wrapWidth, SDL_Color color);
@@ -0,0 +1,184 @@
+#include "text_match.h"
+
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TEXT_MATCH_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static int lowestBit(unsigned mask) {
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+}
+#else
+static int lowestBit(unsigned mask) {
+    return __builtin_ctz(mask);
+}
+#endif
+
+static char lowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// needle is already lowercased
+static bool matchesAt(const char* text, const char* needle, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (lowerAscii(text[i]) != needle[i]) return false;
+    }
+    return true;
+}
+
+static size_t scanScalar(std::string_view haystack, const std::string& needle, size_t from) {
+    size_t length = needle.size();
+    char first = needle[0];
+    for (size_t i = from; i + length <= haystack.size(); ++i) {
+        if (lowerAscii(haystack[i]) == first && matchesAt(haystack.data() + i + 1, needle.data() + 1, length - 1)) {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+#ifdef TEXT_MATCH_X86
+
+// Every block compares the first and the last needle byte against all positions at once, and only
+// positions where both agree get the full comparison. Loads stay inside the haystack, the scalar
+// loop finishes the last partial block
+
+static __m128i lowerBlock(__m128i bytes) {
+    // 'A'..'Z' land on the 26 smallest signed bytes after the shift, so one compare finds them
+    __m128i shifted = _mm_add_epi8(bytes, _mm_set1_epi8(static_cast<char>(0x80 - 'A')));
+    __m128i upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(0x80 + 26)));
+    return _mm_or_si128(bytes, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+static size_t scanSse2(std::string_view haystack, const std::string& needle, size_t from) {
+    const char* text = haystack.data();
+    size_t length = needle.size();
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[length - 1]);
+
+    size_t i = from;
+    for (; i + length - 1 + 16 <= haystack.size(); i += 16) {
+        __m128i blockFirst = lowerBlock(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i)));
+        __m128i blockLast = lowerBlock(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + length - 1)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast))));
+        while (mask) {
+            int bit = lowestBit(mask);
+            if (matchesAt(text + i + bit + 1, needle.data() + 1, length - 1)) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return scanScalar(haystack, needle, i);
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TEXT_MATCH_AVX2_TARGET __attribute__((target("avx2")))
+#define TEXT_MATCH_HAS_AVX2 1
+#elif defined(__AVX2__)
+#define TEXT_MATCH_AVX2_TARGET
+#define TEXT_MATCH_HAS_AVX2 1
+#endif
+
+#ifdef TEXT_MATCH_HAS_AVX2
+
+TEXT_MATCH_AVX2_TARGET static __m256i lowerBlock256(__m256i bytes) {
+    __m256i shifted = _mm256_add_epi8(bytes, _mm256_set1_epi8(static_cast<char>(0x80 - 'A')));
+    __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(0x80 + 26)), shifted);
+    return _mm256_or_si256(bytes, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+TEXT_MATCH_AVX2_TARGET static size_t scanAvx2(std::string_view haystack, const std::string& needle, size_t from) {
+    const char* text = haystack.data();
+    size_t length = needle.size();
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[length - 1]);
+
+    size_t i = from;
+    for (; i + length - 1 + 32 <= haystack.size(); i += 32) {
+        __m256i blockFirst = lowerBlock256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i)));
+        __m256i blockLast = lowerBlock256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + length - 1)));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast))));
+        while (mask) {
+            int bit = lowestBit(mask);
+            if (matchesAt(text + i + bit + 1, needle.data() + 1, length - 1)) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return scanSse2(haystack, needle, i);
+}
+
+#endif
+#endif
+
+enum TextMatchKernel { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 };
+
+static TextMatchKernel detectKernel() {
+#if defined(TEXT_MATCH_HAS_AVX2) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+    return KERNEL_SSE2;
+#elif defined(TEXT_MATCH_HAS_AVX2)
+    return KERNEL_AVX2;
+#elif defined(TEXT_MATCH_X86)
+    return KERNEL_SSE2;
+#else
+    return KERNEL_SCALAR;
+#endif
+}
+
+static TextMatchKernel activeKernel() {
+    static const TextMatchKernel kernel = detectKernel();
+    return kernel;
+}
+
+// Lowercases the needle once and handles the cases every kernel shares
+static bool prepareNeedle(std::string_view haystack, std::string_view needle, size_t from, std::string& lowered) {
+    if (needle.empty() || from > haystack.size() || haystack.size() - from < needle.size()) return false;
+    lowered.resize(needle.size());
+    for (size_t i = 0; i < needle.size(); ++i) lowered[i] = lowerAscii(needle[i]);
+    return true;
+}
+
+size_t findText(std::string_view haystack, std::string_view needle, size_t from) {
+    if (needle.empty()) return from <= haystack.size() ? from : std::string_view::npos;
+    std::string lowered;
+    if (!prepareNeedle(haystack, needle, from, lowered)) return std::string_view::npos;
+
+    switch (activeKernel()) {
+#ifdef TEXT_MATCH_HAS_AVX2
+    case KERNEL_AVX2:
+        return scanAvx2(haystack, lowered, from);
+#endif
+#ifdef TEXT_MATCH_X86
+    case KERNEL_SSE2:
+        return scanSse2(haystack, lowered, from);
+#endif
+    default:
+        return scanScalar(haystack, lowered, from);
+    }
+}
+
+size_t findTextScalar(std::string_view haystack, std::string_view needle, size_t from) {
+    if (needle.empty()) return from <= haystack.size() ? from : std::string_view::npos;
+    std::string lowered;
+    if (!prepareNeedle(haystack, needle, from, lowered)) return std::string_view::npos;
+    return scanScalar(haystack, lowered, from);
+}
+
+const char* textMatchKernel() {
+    switch (activeKernel()) {
+    case KERNEL_AVX2: return "avx2";
+    case KERNEL_SSE2: return "sse2";
+    default: return "scalar";
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Case-insensitive substring search over large blocks of text, vectorized with AVX2 or SSE2
+// when the CPU has them. Only ASCII letters fold, everything else has to match byte for byte.
+// Returns the position of the first match at or after from, or std::string_view::npos
+size_t findText(std::string_view haystack, std::string_view needle, size_t from = 0);
+
+// Same search without SIMD, used on other CPUs and for the tail of every scan
+size_t findTextScalar(std::string_view haystack, std::string_view needle, size_t from = 0);
+
+// Name of the kernel findText dispatches to on this machine: "avx2", "sse2" or "scalar"
+const char* textMatchKernel();
@@ -0,0 +1,200 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Slots are atomics so the writer thread in writeTrace can read them while their owner keeps
+// recording; relaxed stores cost the same as plain ones
+struct TraceEvent {
+    std::atomic<const char*> name{ nullptr };
+    std::atomic<uint64_t> start{ 0 };
+    std::atomic<uint64_t> duration{ 0 };
+};
+
+// One thread's ring. Only the owning thread writes, so recording takes no lock
+struct TraceBuffer {
+    std::unique_ptr<TraceEvent[]> events{ new TraceEvent[TRACE_RING_EVENTS] };
+    std::atomic<uint64_t> written{ 0 };
+    std::atomic<bool> owned{ true };
+    std::atomic<const char*> threadName{ nullptr };
+    uint32_t tid = 0;
+};
+
+// Buffers are never freed: a thread that exits hands its buffer to the next new thread, so the
+// short-lived loader threads don't pile up rings
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+};
+
+static std::atomic<bool> tracing{ false };
+
+static TraceRegistry& registry() {
+    static TraceRegistry* instance = new TraceRegistry();   // outlives threads still exiting at shutdown
+    return *instance;
+}
+
+static uint64_t traceNow() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count());
+}
+
+static TraceBuffer* acquireBuffer() {
+    TraceRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const std::unique_ptr<TraceBuffer>& buffer : reg.buffers) {
+        bool expected = false;
+        if (buffer->owned.compare_exchange_strong(expected, true)) {
+            return buffer.get();
+        }
+    }
+    reg.buffers.push_back(std::make_unique<TraceBuffer>());
+    reg.buffers.back()->tid = static_cast<uint32_t>(reg.buffers.size());
+    return reg.buffers.back().get();
+}
+
+// The thread's name is kept here until its first event, so naming a thread doesn't allocate a ring
+struct ThreadTrace {
+    TraceBuffer* buffer = nullptr;
+    const char* name = nullptr;
+
+    ~ThreadTrace() {
+        if (buffer) buffer->owned.store(false);
+    }
+};
+
+static thread_local ThreadTrace threadTrace;
+
+static TraceBuffer& threadBuffer() {
+    if (!threadTrace.buffer) {
+        threadTrace.buffer = acquireBuffer();
+        threadTrace.buffer->threadName.store(threadTrace.name, std::memory_order_relaxed);
+    }
+    return *threadTrace.buffer;
+}
+
+void setTraceEnabled(bool enabled) {
+    traceNow();   // pins the epoch before the first event
+    tracing.store(enabled, std::memory_order_relaxed);
+}
+
+bool traceEnabled() {
+    return tracing.load(std::memory_order_relaxed);
+}
+
+void setTraceThreadName(const char* name) {
+    threadTrace.name = name;
+    if (threadTrace.buffer) {
+        threadTrace.buffer->threadName.store(name, std::memory_order_relaxed);
+    }
+}
+
+TraceScope::TraceScope(const char* name) : name(name), start(0) {
+    if (tracing.load(std::memory_order_relaxed)) {
+        start = traceNow() + 1;   // 0 is reserved for "not recording"
+    }
+}
+
+TraceScope::~TraceScope() {
+    if (start == 0) return;
+    uint64_t end = traceNow();
+    TraceBuffer& buffer = threadBuffer();
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    // Storing written = index claimed this slot. The fence keeps that store ahead of the stores
+    // below for a reader whose copy sees any of them, see copyEvents
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceEvent& event = buffer.events[index % TRACE_RING_EVENTS];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start - 1, std::memory_order_relaxed);
+    event.duration.store(end - (start - 1), std::memory_order_relaxed);
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+struct TraceCopy {
+    const char* name;
+    uint64_t start;
+    uint64_t duration;
+};
+
+// Copies the ring, then drops whatever the owner may have overwritten while it was being read
+static void copyEvents(const TraceBuffer& buffer, std::vector<TraceCopy>& out) {
+    out.clear();
+    uint64_t end = buffer.written.load(std::memory_order_acquire);
+    uint64_t begin = end > TRACE_RING_EVENTS ? end - TRACE_RING_EVENTS : 0;
+    for (uint64_t i = begin; i < end; ++i) {
+        const TraceEvent& event = buffer.events[i % TRACE_RING_EVENTS];
+        out.push_back({ event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed),
+                        event.duration.load(std::memory_order_relaxed) });
+    }
+    // The owner may also be halfway through writing event `after`, which reuses the slot of event
+    // after - TRACE_RING_EVENTS, so that one counts as overwritten too. The fence keeps the copy
+    // above from being read after this load, and pairs with the owner's fence in ~TraceScope
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t after = buffer.written.load(std::memory_order_relaxed);
+    uint64_t overwritten = after + 1 > TRACE_RING_EVENTS ? after + 1 - TRACE_RING_EVENTS : 0;
+    if (overwritten > begin) {
+        out.erase(out.begin(), out.begin() + static_cast<ptrdiff_t>(std::min(overwritten - begin, end - begin)));
+    }
+}
+
+static void writeJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* p = text; *p; ++p) {
+        if (*p == '"' || *p == '\\') out << '\\';
+        out << *p;
+    }
+    out << '"';
+}
+
+// Chrome wants microseconds; the nanoseconds stay as three decimals
+static void writeMicros(std::ostream& out, uint64_t ns) {
+    char fraction[4] = { static_cast<char>('0' + ns % 1000 / 100), static_cast<char>('0' + ns % 100 / 10),
+                         static_cast<char>('0' + ns % 10), 0 };
+    out << ns / 1000 << '.' << fraction;
+}
+
+bool writeTrace(const std::string& filename) {
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "Failed to open trace file: " << filename << std::endl;
+        return false;
+    }
+
+    TraceRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::vector<TraceCopy> events;
+    bool first = true;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (const std::unique_ptr<TraceBuffer>& buffer : reg.buffers) {
+        const char* threadName = buffer->threadName.load(std::memory_order_relaxed);
+        if (threadName) {
+            out << (first ? "\n" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":";
+            writeJsonString(out, threadName);
+            out << "}}";
+            first = false;
+        }
+
+        copyEvents(*buffer, events);
+        for (const TraceCopy& event : events) {
+            if (!event.name) continue;
+            out << (first ? "\n" : ",\n") << "{\"ph\":\"X\",\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":";
+            writeMicros(out, event.start);
+            out << ",\"dur\":";
+            writeMicros(out, event.duration);
+            out << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
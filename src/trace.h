@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Scoped timing events, kept per thread in fixed-size rings and written out as Chrome trace_event
+// JSON (chrome://tracing, Perfetto). While tracing is off a scope costs one relaxed load, and no
+// buffers exist until the first event is recorded
+
+const size_t TRACE_RING_EVENTS = 16384;   // per thread; the oldest events are overwritten first
+
+void setTraceEnabled(bool enabled);
+bool traceEnabled();
+
+// Names the calling thread's track in the trace. name must outlive the trace, like scope names
+void setTraceThreadName(const char* name);
+
+// Writes every thread's buffered events. Safe to call while other threads keep tracing
+bool writeTrace(const std::string& filename);
+
+// Records the time between construction and destruction. name must be a string literal or
+// otherwise live until the trace is written
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
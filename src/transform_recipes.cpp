@@ -0,0 +1,56 @@
+#include "transform_recipes.h"
+
+template <const Recipe& R>
+static KnownRecipe knownRecipeOf(const char* name) {
+    return { name, &R, { R.growth, applyRecipe<R> } };
+}
+
+static const KnownRecipe KNOWN_RECIPES[] = {
+    knownRecipeOf<RECIPE_LEET>("leet"),
+    knownRecipeOf<RECIPE_SHIFT>("shift"),
+    knownRecipeOf<RECIPE_SCRAMBLE>("scramble"),
+};
+
+size_t knownRecipeCount() {
+    return sizeof(KNOWN_RECIPES) / sizeof(KNOWN_RECIPES[0]);
+}
+
+const KnownRecipe& knownRecipe(size_t index) {
+    return KNOWN_RECIPES[index];
+}
+
+const KnownRecipe* findRecipe(std::string_view name) {
+    for (const KnownRecipe& known : KNOWN_RECIPES) {
+        if (name == known.name) return &known;
+    }
+    return nullptr;
+}
+
+static bool sameStep(const TransformStep& step, const RecipeStep& recipeStep) {
+    if (step.kind != recipeStep.kind) return false;
+    switch (step.kind) {
+    case TransformStepKind::Table:
+        return step.period == recipeStep.period &&
+               std::equal(step.tables.begin(), step.tables.end(), recipeStep.tables.begin(),
+                          recipeStep.tables.begin() + recipeStep.period * 256);
+    case TransformStepKind::Insert:
+        return step.position == recipeStep.position &&
+               std::string_view(step.text) == std::string_view(recipeStep.text, recipeStep.textLength);
+    case TransformStepKind::Rotate:
+        return step.amount == recipeStep.amount;
+    }
+    return false;
+}
+
+const SpecializedTransform* findSpecializedTransform(const TransformProgram& program) {
+    for (const KnownRecipe& known : KNOWN_RECIPES) {
+        const Recipe& recipe = *known.recipe;
+        if (program.steps.size() != recipe.count) continue;
+        bool same = true;
+        for (size_t i = 0; i < recipe.count && same; ++i) {
+            same = sameStep(program.steps[i], recipe.steps[i]);
+        }
+        if (same) return &known.specialized;
+    }
+    return nullptr;
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <string_view>
+#include <utility>
+
+#include "password_transform.h"
+
+// The handful of fixed recipes most people use, compiled ahead of time. A recipe is put together
+// from the same stages as a rule file with constexpr functions, so the compiler computes its tables
+// and fuses them the way compileTransform would, and applyRecipe<R> unrolls into straight-line code
+// where every period, offset and amount is a constant. compileTransform hands a program that comes
+// out equal to a known recipe the recipe's specialized function; anything else is interpreted.
+
+// mix tables repeat every MIX_PERIOD bytes, so a mix fuses with a plain sub without growing the period
+const uint32_t MIX_PERIOD = 16;
+const uint8_t PRINTABLE_FIRST = 33;    // '!'
+const uint8_t PRINTABLE_LAST = 126;    // '~'
+
+using RecipeTables = std::array<uint8_t, MIX_PERIOD * 256>;
+
+// FNV-1a of the key seeds splitmix64, which decides every shuffle
+constexpr uint64_t mixNext(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Every position gets its own permutation of the printable characters, so the output stays typeable.
+// The interpreter builds its mix tables with this too, so both paths agree byte for byte
+constexpr RecipeTables mixTables(std::string_view key) {
+    uint64_t seed = 0xCBF29CE484222325ull;
+    for (char c : key) {
+        seed = (seed ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+    }
+
+    RecipeTables tables{};
+    const int printable = PRINTABLE_LAST - PRINTABLE_FIRST + 1;
+    for (uint32_t p = 0; p < MIX_PERIOD; ++p) {
+        for (int c = 0; c < 256; ++c) {
+            tables[p * 256 + c] = static_cast<uint8_t>(c);
+        }
+        for (int i = printable - 1; i > 0; --i) {
+            int j = static_cast<int>(mixNext(seed) % static_cast<uint64_t>(i + 1));
+            uint8_t swapped = tables[p * 256 + PRINTABLE_FIRST + i];
+            tables[p * 256 + PRINTABLE_FIRST + i] = tables[p * 256 + PRINTABLE_FIRST + j];
+            tables[p * 256 + PRINTABLE_FIRST + j] = swapped;
+        }
+    }
+    return tables;
+}
+
+const size_t RECIPE_MAX_STEPS = 6;
+const size_t RECIPE_MAX_TEXT = 16;
+
+// A TransformStep with fixed-size storage, so it can be built and fused at compile time
+struct RecipeStep {
+    TransformStepKind kind = TransformStepKind::Table;
+    uint32_t period = 1;            // at most MIX_PERIOD
+    RecipeTables tables{};
+    int32_t position = 0;
+    char text[RECIPE_MAX_TEXT] = {};
+    size_t textLength = 0;
+    int32_t amount = 0;
+};
+
+struct Recipe {
+    RecipeStep steps[RECIPE_MAX_STEPS] = {};
+    size_t count = 0;
+    size_t growth = 0;              // bytes the inserts add to every password
+};
+
+constexpr RecipeStep subStage(std::string_view from, std::string_view to) {
+    RecipeStep step;
+    for (int c = 0; c < 256; ++c) {
+        step.tables[c] = static_cast<uint8_t>(c);
+    }
+    for (size_t i = 0; i < from.size() && i < to.size(); ++i) {
+        step.tables[static_cast<uint8_t>(from[i])] = static_cast<uint8_t>(to[i]);
+    }
+    return step;
+}
+
+constexpr RecipeStep mixStage(std::string_view key) {
+    RecipeStep step;
+    step.period = MIX_PERIOD;
+    step.tables = mixTables(key);
+    return step;
+}
+
+constexpr RecipeStep insertStage(int32_t position, std::string_view text) {
+    RecipeStep step;
+    step.kind = TransformStepKind::Insert;
+    step.position = position;
+    if (text.size() > RECIPE_MAX_TEXT) throw "recipe insert text too long";
+    for (size_t i = 0; i < text.size(); ++i) {
+        step.text[i] = text[i];
+    }
+    step.textLength = text.size();
+    return step;
+}
+
+constexpr RecipeStep rotateStage(int32_t amount) {
+    RecipeStep step;
+    step.kind = TransformStepKind::Rotate;
+    step.amount = amount;
+    return step;
+}
+
+// Same fusion as the interpreter: a table following a table is folded into it, as long as the
+// fused period still fits RecipeTables. Otherwise the table starts a step of its own
+constexpr void addRecipeStep(Recipe& recipe, const RecipeStep& step) {
+    if (step.kind == TransformStepKind::Table && recipe.count > 0 &&
+        recipe.steps[recipe.count - 1].kind == TransformStepKind::Table &&
+        std::lcm(recipe.steps[recipe.count - 1].period, step.period) <= MIX_PERIOD) {
+        RecipeStep& previous = recipe.steps[recipe.count - 1];
+        uint32_t period = std::lcm(previous.period, step.period);
+        RecipeTables fused{};
+        for (uint32_t p = 0; p < period; ++p) {
+            for (int c = 0; c < 256; ++c) {
+                uint8_t first = previous.tables[(p % previous.period) * 256 + c];
+                fused[p * 256 + c] = step.tables[(p % step.period) * 256 + first];
+            }
+        }
+        previous.period = period;
+        previous.tables = fused;
+        return;
+    }
+    if (recipe.count == RECIPE_MAX_STEPS) throw "too many recipe steps";
+    recipe.steps[recipe.count++] = step;
+    recipe.growth += step.textLength;
+}
+
+template <typename... Stages>
+constexpr Recipe makeRecipe(const Stages&... stages) {
+    Recipe recipe;
+    (addRecipeStep(recipe, stages), ...);
+    return recipe;
+}
+
+template <const Recipe& R, size_t I>
+inline size_t applyRecipeStep(char* data, size_t length) {
+    constexpr const RecipeStep& step = R.steps[I];
+    if constexpr (step.kind == TransformStepKind::Table) {
+        for (size_t i = 0; i < length; ++i) {
+            data[i] = static_cast<char>(step.tables[(i % step.period) * 256 + static_cast<uint8_t>(data[i])]);
+        }
+        return length;
+    } else if constexpr (step.kind == TransformStepKind::Rotate) {
+        if (length < 2) return length;
+        int64_t shift = step.amount % static_cast<int64_t>(length);
+        if (shift < 0) shift += static_cast<int64_t>(length);
+        std::rotate(data, data + shift, data + length);
+        return length;
+    } else {
+        int64_t offset = step.position >= 0 ? step.position : static_cast<int64_t>(length) + 1 + step.position;
+        size_t at = static_cast<size_t>(std::clamp<int64_t>(offset, 0, static_cast<int64_t>(length)));
+        std::memmove(data + at + step.textLength, data + at, length - at);
+        std::memcpy(data + at, step.text, step.textLength);
+        return length + step.textLength;
+    }
+}
+
+template <const Recipe& R, size_t First, size_t... I>
+inline size_t applyRecipeSteps(char* data, size_t length, std::index_sequence<I...>) {
+    ((length = applyRecipeStep<R, First + I>(data, length)), ...);
+    return length;
+}
+
+// out must have room for length + R.growth bytes. Returns the transformed length.
+// A leading table step is applied while copying the password in, saving a pass
+template <const Recipe& R>
+size_t applyRecipe(const char* password, size_t length, char* out) {
+    constexpr const RecipeStep& first = R.steps[0];
+    if constexpr (R.count > 0 && first.kind == TransformStepKind::Table) {
+        for (size_t i = 0; i < length; ++i) {
+            out[i] = static_cast<char>(first.tables[(i % first.period) * 256 + static_cast<uint8_t>(password[i])]);
+        }
+        return applyRecipeSteps<R, 1>(out, length, std::make_index_sequence<R.count - 1>());
+    } else {
+        std::memcpy(out, password, length);
+        return applyRecipeSteps<R, 0>(out, length, std::make_index_sequence<R.count>());
+    }
+}
+
+struct KnownRecipe {
+    const char* name;
+    const Recipe* recipe;
+    SpecializedTransform specialized;
+};
+
+// Recipes a rule file can name with "recipe <name>"
+inline constexpr Recipe RECIPE_LEET = makeRecipe(subStage("aeiostAEIOST", "431057431057"), insertStage(-1, "!"));
+inline constexpr Recipe RECIPE_SHIFT = makeRecipe(
+    subStage("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ", "nopqrstuvwxyzabcdefghijklmNOPQRSTUVWXYZABCDEFGHIJKLM"),
+    rotateStage(3));
+inline constexpr Recipe RECIPE_SCRAMBLE = makeRecipe(mixStage("notebook"), insertStage(0, "#"), rotateStage(-2));
+
+// nullptr when there is no recipe of that name
+const KnownRecipe* findRecipe(std::string_view name);
+
+// The specialized function of the known recipe equal to program, or nullptr
+const SpecializedTransform* findSpecializedTransform(const TransformProgram& program);
+
+size_t knownRecipeCount();
+const KnownRecipe& knownRecipe(size_t index);
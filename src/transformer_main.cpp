@@ -0,0 +1,354 @@
+// App 2 as a filter: copies label;account;password records from save.txt or stdin to stdout with
+// every password run through the transform rules, for migrating exports too big for the GUI.
+//
+//   PasswordTransformer --rules=transform.txt [--input=save.txt] [--threads=N] > transformed.txt
+//
+// The input is cut into blocks of whole lines. The main thread reads blocks (or slices them out
+// of the mapped file), a pool of workers transforms them, and a writer thread puts them out in
+// order. Only a fixed number of blocks exist, so memory stays bounded however big the input is,
+// and reading, transforming and writing all overlap. Lines that are not account records pass
+// through unchanged.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "mapped_file.h"
+#include "password_transform.h"
+#include "secure_alloc.h"
+#include "trace.h"
+
+const size_t BLOCK_BYTES = 1 << 20;
+
+// Where a record's password sits in its block; lines without one have no password
+struct RecordSlice {
+    size_t lineStart;
+    size_t passwordStart;
+    size_t passwordLength;
+    size_t lineEnd;         // one past the newline, if there is one
+    bool hasPassword;
+};
+
+struct Block {
+    uint64_t seq = 0;
+    std::string_view input;         // into the mapping, or into inputBuffer for stdin
+    SecureString inputBuffer;
+    SecureString output;
+    std::vector<RecordSlice> records;
+    std::vector<std::string_view> passwords;
+    TransformBatch batch;
+};
+
+struct Pipeline {
+    std::mutex mutex;
+    std::condition_variable blockFree;
+    std::condition_variable workReady;
+    std::condition_variable blockDone;
+
+    std::vector<Block> blocks;
+    std::vector<Block*> freeBlocks;
+    std::deque<Block*> work;
+    std::vector<Block*> done;           // slot seq % blocks.size(), waiting for the writer
+    uint64_t blocksRead = 0;
+    bool inputDone = false;
+    bool writeFailed = false;
+
+    uint64_t records = 0;
+    uint64_t bytesOut = 0;
+};
+
+// Same rules as loadFromFile: the password is the rest of the line after the second ';', and a
+// line without one only declares a service
+static void sliceRecords(Block& block) {
+    block.records.clear();
+    block.passwords.clear();
+    std::string_view text = block.input;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        const char* newline = static_cast<const char*>(std::memchr(text.data() + pos, '\n', text.size() - pos));
+        size_t lineEnd = newline ? static_cast<size_t>(newline - text.data()) + 1 : text.size();
+        size_t contentEnd = newline ? lineEnd - 1 : lineEnd;
+        if (newline && contentEnd > pos && text[contentEnd - 1] == '\r') --contentEnd;
+
+        RecordSlice record = { pos, 0, 0, lineEnd, false };
+        std::string_view line = text.substr(pos, contentEnd - pos);
+        size_t labelEnd = line.find(';');
+        size_t accountEnd = labelEnd == std::string_view::npos ? labelEnd : line.find(';', labelEnd + 1);
+        if (accountEnd != std::string_view::npos && accountEnd + 1 < line.size()) {
+            record.passwordStart = pos + accountEnd + 1;
+            record.passwordLength = line.size() - accountEnd - 1;
+            record.hasPassword = true;
+            block.passwords.push_back(text.substr(record.passwordStart, record.passwordLength));
+        }
+        block.records.push_back(record);
+        pos = lineEnd;
+    }
+}
+
+static void transformBlock(const TransformProgram& program, Block& block) {
+    TRACE_SCOPE("transform block");
+    sliceRecords(block);
+    transformPasswords(program, block.passwords.data(), block.passwords.size(), block.batch);
+
+    std::string_view text = block.input;
+    block.output.clear();
+    block.output.reserve(text.size() + block.batch.pool.size());
+    size_t password = 0;
+    for (const RecordSlice& record : block.records) {
+        if (!record.hasPassword) {
+            block.output.append(text.data() + record.lineStart, record.lineEnd - record.lineStart);
+            continue;
+        }
+        std::string_view transformed = transformResult(block.batch, password++);
+        size_t passwordEnd = record.passwordStart + record.passwordLength;
+        block.output.append(text.data() + record.lineStart, record.passwordStart - record.lineStart);
+        block.output.append(transformed.data(), transformed.size());
+        block.output.append(text.data() + passwordEnd, record.lineEnd - passwordEnd);
+    }
+}
+
+static void workerLoop(Pipeline& pipeline, const TransformProgram& program) {
+    setTraceThreadName("transform worker");
+    while (true) {
+        Block* block;
+        {
+            std::unique_lock<std::mutex> lock(pipeline.mutex);
+            pipeline.workReady.wait(lock, [&]() { return !pipeline.work.empty() || pipeline.inputDone; });
+            if (pipeline.work.empty()) return;
+            block = pipeline.work.front();
+            pipeline.work.pop_front();
+        }
+
+        transformBlock(program, *block);
+
+        {
+            std::lock_guard<std::mutex> lock(pipeline.mutex);
+            pipeline.records += block->records.size();
+            pipeline.done[block->seq % pipeline.done.size()] = block;
+        }
+        pipeline.blockDone.notify_all();
+    }
+}
+
+static void writerLoop(Pipeline& pipeline) {
+    setTraceThreadName("transform writer");
+    uint64_t next = 0;
+    while (true) {
+        Block* block;
+        {
+            std::unique_lock<std::mutex> lock(pipeline.mutex);
+            Block*& slot = pipeline.done[next % pipeline.done.size()];
+            pipeline.blockDone.wait(lock, [&]() { return slot || (pipeline.inputDone && next == pipeline.blocksRead); });
+            if (!slot) return;
+            block = slot;
+            slot = nullptr;
+        }
+
+        bool ok;
+        {
+            TRACE_SCOPE("write block");
+            ok = std::fwrite(block->output.data(), 1, block->output.size(), stdout) == block->output.size();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pipeline.mutex);
+            pipeline.bytesOut += block->output.size();
+            if (!ok) pipeline.writeFailed = true;
+            pipeline.freeBlocks.push_back(block);
+        }
+        pipeline.blockFree.notify_one();
+        ++next;
+    }
+}
+
+// Waits for a block to fill, or returns nullptr once writing has failed and reading should stop
+static Block* takeFreeBlock(Pipeline& pipeline) {
+    std::unique_lock<std::mutex> lock(pipeline.mutex);
+    pipeline.blockFree.wait(lock, [&]() { return !pipeline.freeBlocks.empty() || pipeline.writeFailed; });
+    if (pipeline.writeFailed) return nullptr;
+    Block* block = pipeline.freeBlocks.back();
+    pipeline.freeBlocks.pop_back();
+    return block;
+}
+
+static void submitBlock(Pipeline& pipeline, Block* block) {
+    {
+        std::lock_guard<std::mutex> lock(pipeline.mutex);
+        block->seq = pipeline.blocksRead++;
+        pipeline.work.push_back(block);
+    }
+    pipeline.workReady.notify_one();
+}
+
+// Blocks are slices of the mapping, nothing is copied on the way in
+static void readMapped(Pipeline& pipeline, const MappedFile& file) {
+    std::string_view text(file.data, file.size);
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.size();
+        if (text.size() - pos > BLOCK_BYTES) {
+            size_t newline = text.find('\n', pos + BLOCK_BYTES);
+            end = newline == std::string_view::npos ? text.size() : newline + 1;
+        }
+        Block* block = takeFreeBlock(pipeline);
+        if (!block) return;
+        block->input = text.substr(pos, end - pos);
+        submitBlock(pipeline, block);
+        pos = end;
+    }
+}
+
+// Reads about BLOCK_BYTES at a time and carries the partial last line over to the next block
+static bool readStream(Pipeline& pipeline, FILE* in) {
+    SecureString carry;
+    bool atEnd = false;
+    while (!atEnd) {
+        Block* block = takeFreeBlock(pipeline);
+        if (!block) return true;
+        SecureString& buffer = block->inputBuffer;
+        buffer.swap(carry);
+        carry.clear();
+
+        size_t lastNewline = std::string::npos;
+        while (lastNewline == std::string::npos && !atEnd) {
+            size_t filled = buffer.size();
+            buffer.resize(filled + BLOCK_BYTES);
+            size_t got = std::fread(&buffer[filled], 1, BLOCK_BYTES, in);
+            buffer.resize(filled + got);
+            if (got < BLOCK_BYTES) {
+                if (std::ferror(in)) return false;
+                atEnd = true;
+            }
+            // A line longer than a block keeps the buffer growing until it ends
+            lastNewline = buffer.rfind('\n');
+        }
+
+        if (!atEnd) {
+            carry.assign(buffer, lastNewline + 1, std::string::npos);
+            buffer.resize(lastNewline + 1);
+        }
+        block->input = buffer;
+        if (buffer.empty()) {
+            std::lock_guard<std::mutex> lock(pipeline.mutex);
+            pipeline.freeBlocks.push_back(block);
+            continue;
+        }
+        submitBlock(pipeline, block);
+    }
+    return true;
+}
+
+static bool flagValue(const std::string& arg, const char* flag, std::string& value) {
+    std::string prefix = std::string(flag) + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string rulesPath;
+    std::string inputPath;
+    size_t threads = std::thread::hardware_concurrency();
+    for (int i = 1; i < argc; ++i) {
+        std::string value;
+        if (flagValue(argv[i], "--rules", value)) rulesPath = value;
+        else if (flagValue(argv[i], "--input", value)) inputPath = value;
+        else if (flagValue(argv[i], "--threads", value)) threads = std::strtoul(value.c_str(), nullptr, 10);
+        else {
+            std::cerr << "Unknown argument: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (rulesPath.empty()) {
+        std::cerr << "Usage: PasswordTransformer --rules=transform.txt [--input=save.txt] [--threads=N] > out.txt" << std::endl;
+        return 1;
+    }
+
+    const char* traceEnv = std::getenv("NOTEBOOK_TRACE");
+    setTraceEnabled(traceEnv != nullptr);
+    setTraceThreadName("transform reader");
+
+    // An identity transform is almost certainly a typo in the path, not something worth a migration
+    TransformProgram program;
+    std::string error;
+    if (!loadTransform(program, rulesPath, error)) return 1;
+    if (program.steps.empty()) {
+        std::cerr << "No transform rules in " << rulesPath << std::endl;
+        return 1;
+    }
+
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    MappedFile file;
+    if (!inputPath.empty() && !mapFile(file, inputPath)) {
+        std::cerr << "Failed to open " << inputPath << std::endl;
+        return 1;
+    }
+
+    // Two blocks per worker keep every worker busy while the reader and the writer each hold one
+    threads = std::max<size_t>(threads, 1);
+    Pipeline pipeline;
+    pipeline.blocks.resize(threads * 2 + 2);
+    pipeline.done.assign(pipeline.blocks.size(), nullptr);
+    for (Block& block : pipeline.blocks) {
+        pipeline.freeBlocks.push_back(&block);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(workerLoop, std::ref(pipeline), std::cref(program));
+    }
+    std::thread writer(writerLoop, std::ref(pipeline));
+
+    bool readOk = true;
+    uint64_t bytesIn = 0;
+    if (!inputPath.empty()) {
+        readMapped(pipeline, file);
+        bytesIn = file.size;
+    } else {
+        readOk = readStream(pipeline, stdin);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pipeline.mutex);
+        pipeline.inputDone = true;
+    }
+    pipeline.workReady.notify_all();
+    pipeline.blockDone.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    writer.join();
+    bool writeOk = !pipeline.writeFailed && std::fflush(stdout) == 0;
+    unmapFile(file);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!readOk) std::cerr << "Failed reading the input" << std::endl;
+    if (!writeOk) std::cerr << "Failed writing the output" << std::endl;
+    std::cerr << pipeline.records << " lines, " << pipeline.bytesOut / (1024 * 1024) << " MB written in "
+              << seconds << " s on " << threads << " threads";
+    if (bytesIn > 0 && seconds > 0) std::cerr << ", " << bytesIn / seconds / (1024 * 1024) << " MB/s in";
+    std::cerr << std::endl;
+
+    if (traceEnv) writeTrace(traceEnv);
+    return readOk && writeOk ? 0 : 1;
+}
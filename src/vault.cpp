@@ -0,0 +1,169 @@
+#include "vault.h"
+
+#include <algorithm>
+
+// Below these sizes compacting isn't worth the copy
+const size_t VAULT_COMPACT_MIN_POOL_BYTES = 64 * 1024;
+const size_t VAULT_COMPACT_MIN_ACCOUNTS = 1024;
+
+static std::string_view poolString(const Vault& vault, PoolString str) {
+    return std::string_view(vault.pool).substr(str.offset, str.length);
+}
+
+// Only after makeRoom said the string fits
+static PoolString appendString(SecureString& pool, std::string_view str) {
+    PoolString stored = { static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(str.size()) };
+    pool.append(str.data(), str.size());
+    return stored;
+}
+
+// Deleted strings are wiped right away instead of lingering in the pool until it is compacted
+static void dropString(Vault& vault, PoolString str) {
+    secureWipe(&vault.pool[str.offset], str.length);
+    vault.stalePoolBytes += str.length;
+}
+
+static void compactIfStale(Vault& vault) {
+    bool stalePool = vault.stalePoolBytes >= VAULT_COMPACT_MIN_POOL_BYTES && vault.stalePoolBytes * 2 >= vault.pool.size();
+    bool staleAccounts = vault.staleAccounts >= VAULT_COMPACT_MIN_ACCOUNTS && vault.staleAccounts * 2 >= vault.accountNames.size();
+    if (stalePool || staleAccounts) {
+        compactVault(vault);
+    }
+}
+
+// Whether bytes more fit in the pool, compacting it if dropping the stale bytes makes the difference
+static bool makeRoom(Vault& vault, size_t bytes) {
+    if (bytes <= VAULT_MAX_POOL_BYTES - vault.pool.size()) return true;
+    if (bytes > VAULT_MAX_POOL_BYTES - (vault.pool.size() - vault.stalePoolBytes)) return false;
+    compactVault(vault);
+    return true;
+}
+
+size_t vaultServiceCount(const Vault& vault) {
+    return vault.labels.size();
+}
+
+std::string_view vaultServiceLabel(const Vault& vault, size_t service) {
+    return poolString(vault, vault.labels[service]);
+}
+
+size_t vaultAccountCount(const Vault& vault, size_t service) {
+    return vault.accountRanges[service].count;
+}
+
+std::string_view vaultAccountName(const Vault& vault, size_t service, size_t account) {
+    return poolString(vault, vault.accountNames[vault.accountRanges[service].first + account]);
+}
+
+std::string_view vaultAccountPassword(const Vault& vault, size_t service, size_t account) {
+    return poolString(vault, vault.passwords[vault.accountRanges[service].first + account]);
+}
+
+bool vaultAddService(Vault& vault, std::string_view label) {
+    if (!makeRoom(vault, label.size())) return false;
+    vault.labels.push_back(appendString(vault.pool, label));
+    vault.accountRanges.push_back({ static_cast<uint32_t>(vault.accountNames.size()), 0 });
+    return true;
+}
+
+bool vaultAddAccount(Vault& vault, size_t service, std::string_view name, std::string_view password) {
+    // Compacting moves the account columns, so room is made before anything points into them
+    if (!makeRoom(vault, name.size() + password.size())) return false;
+    AccountRange& range = vault.accountRanges[service];
+    uint32_t end = static_cast<uint32_t>(vault.accountNames.size());
+
+    // Only the service at the end of the columns can grow in place, any other one moves its
+    // accounts to the end first and leaves its old slots stale
+    if (range.first + range.count != end) {
+        for (uint32_t i = 0; i < range.count; ++i) {
+            vault.accountNames.push_back(vault.accountNames[range.first + i]);
+            vault.passwords.push_back(vault.passwords[range.first + i]);
+        }
+        vault.staleAccounts += range.count;
+        range.first = end;
+    }
+
+    vault.accountNames.push_back(appendString(vault.pool, name));
+    vault.passwords.push_back(appendString(vault.pool, password));
+    ++range.count;
+    compactIfStale(vault);
+    return true;
+}
+
+void vaultDeleteAccount(Vault& vault, size_t service, size_t account) {
+    AccountRange& range = vault.accountRanges[service];
+    size_t slot = range.first + account;
+    dropString(vault, vault.accountNames[slot]);
+    dropString(vault, vault.passwords[slot]);
+
+    auto namesBegin = vault.accountNames.begin() + range.first;
+    auto passwordsBegin = vault.passwords.begin() + range.first;
+    std::copy(namesBegin + account + 1, namesBegin + range.count, namesBegin + account);
+    std::copy(passwordsBegin + account + 1, passwordsBegin + range.count, passwordsBegin + account);
+    --range.count;
+    ++vault.staleAccounts;
+    compactIfStale(vault);
+}
+
+void vaultDeleteService(Vault& vault, size_t service) {
+    AccountRange range = vault.accountRanges[service];
+    dropString(vault, vault.labels[service]);
+    for (uint32_t i = range.first; i < range.first + range.count; ++i) {
+        dropString(vault, vault.accountNames[i]);
+        dropString(vault, vault.passwords[i]);
+    }
+    vault.staleAccounts += range.count;
+
+    vault.labels.erase(vault.labels.begin() + service);
+    vault.accountRanges.erase(vault.accountRanges.begin() + service);
+    compactIfStale(vault);
+}
+
+void vaultAddPlaceholders(Vault& vault, size_t count) {
+    vault.labels.resize(vault.labels.size() + count, PoolString{ 0, 0 });
+    vault.accountRanges.resize(vault.accountRanges.size() + count, AccountRange{ static_cast<uint32_t>(vault.accountNames.size()), 0 });
+}
+
+bool vaultSetServiceLabel(Vault& vault, size_t service, std::string_view label) {
+    if (!makeRoom(vault, label.size())) return false;
+    dropString(vault, vault.labels[service]);
+    vault.labels[service] = appendString(vault.pool, label);
+    compactIfStale(vault);
+    return true;
+}
+
+void reserveVault(Vault& vault, size_t services, size_t accounts, size_t poolBytes) {
+    vault.labels.reserve(services);
+    vault.accountRanges.reserve(services);
+    vault.accountNames.reserve(accounts);
+    vault.passwords.reserve(accounts);
+    vault.pool.reserve(poolBytes);
+}
+
+void clearVault(Vault& vault) {
+    secureWipe(&vault.pool[0], vault.pool.size());
+    vault.pool.clear();
+    vault.labels.clear();
+    vault.accountRanges.clear();
+    vault.accountNames.clear();
+    vault.passwords.clear();
+    vault.stalePoolBytes = 0;
+    vault.staleAccounts = 0;
+}
+
+void compactVault(Vault& vault) {
+    Vault packed;
+    size_t accountCount = vault.accountNames.size() - vault.staleAccounts;
+    reserveVault(packed, vault.labels.size(), accountCount, vault.pool.size() - vault.stalePoolBytes);
+
+    for (size_t i = 0; i < vault.labels.size(); ++i) {
+        packed.labels.push_back(appendString(packed.pool, poolString(vault, vault.labels[i])));
+        AccountRange range = vault.accountRanges[i];
+        packed.accountRanges.push_back({ static_cast<uint32_t>(packed.accountNames.size()), range.count });
+        for (uint32_t a = range.first; a < range.first + range.count; ++a) {
+            packed.accountNames.push_back(appendString(packed.pool, poolString(vault, vault.accountNames[a])));
+            packed.passwords.push_back(appendString(packed.pool, poolString(vault, vault.passwords[a])));
+        }
+    }
+    vault = std::move(packed);
+}
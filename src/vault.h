@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "secure_alloc.h"
+
+// Pool offsets and lengths are 32-bit, so the pool can't grow past this
+const size_t VAULT_MAX_POOL_BYTES = UINT32_MAX;
+
+// A string stored in Vault::pool. Strings are not NUL-terminated
+struct PoolString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+// The service's accounts are [first, first + count) of the account columns
+struct AccountRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+// Column-oriented vault: every string lives in one pool, the per-service and per-account columns
+// hold nothing but offsets, and each service owns a contiguous run of accounts. Edits leave
+// stale pool bytes and account slots behind, which are reclaimed once they make up half the vault.
+// All of it comes from SecureAllocator, so freeing a vault is a few wiped blocks
+struct Vault {
+    SecureString pool;
+
+    // One entry per service
+    SecureVector<PoolString> labels;
+    SecureVector<AccountRange> accountRanges;
+
+    // One entry per account slot
+    SecureVector<PoolString> accountNames;
+    SecureVector<PoolString> passwords;
+
+    size_t stalePoolBytes = 0;
+    size_t staleAccounts = 0;
+};
+
+size_t vaultServiceCount(const Vault& vault);
+std::string_view vaultServiceLabel(const Vault& vault, size_t service);
+size_t vaultAccountCount(const Vault& vault, size_t service);
+std::string_view vaultAccountName(const Vault& vault, size_t service, size_t account);
+std::string_view vaultAccountPassword(const Vault& vault, size_t service, size_t account);
+
+// Views returned by the accessors above are invalidated by any of these. Adding fails and leaves
+// the vault as it was if the strings don't fit in the pool, even once it is compacted
+bool vaultAddService(Vault& vault, std::string_view label);
+bool vaultAddAccount(Vault& vault, size_t service, std::string_view name, std::string_view password);
+void vaultDeleteAccount(Vault& vault, size_t service, size_t account);
+void vaultDeleteService(Vault& vault, size_t service);
+
+// Appends count services with empty labels and no accounts, to be filled in later with
+// vaultSetServiceLabel and vaultAddAccount. Lets the sealed vault decrypt services as they are needed
+void vaultAddPlaceholders(Vault& vault, size_t count);
+bool vaultSetServiceLabel(Vault& vault, size_t service, std::string_view label);
+
+void reserveVault(Vault& vault, size_t services, size_t accounts, size_t poolBytes);
+void clearVault(Vault& vault);
+// Rewrites the pool and the account columns in service order, dropping everything stale
+void compactVault(Vault& vault);
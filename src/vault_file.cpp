@@ -0,0 +1,221 @@
+#include "vault_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "file_util.h"
+#include "trace.h"
+
+static bool inPool(const VaultHeader& header, uint32_t offset, uint32_t length) {
+    return static_cast<uint64_t>(offset) + length <= header.stringPoolSize;
+}
+
+static bool validateVault(const MappedVault& vault) {
+    const VaultHeader& header = *vault.header;
+    uint64_t fileSize = vault.file.size;
+
+    uint64_t serviceBytes = static_cast<uint64_t>(header.serviceCount) * sizeof(VaultServiceRecord);
+    uint64_t accountBytes = static_cast<uint64_t>(header.accountCount) * sizeof(VaultAccountRecord);
+    if (header.serviceTableOffset % alignof(VaultServiceRecord) != 0 ||
+        header.accountTableOffset % alignof(VaultAccountRecord) != 0 ||
+        header.serviceTableOffset > fileSize || serviceBytes > fileSize - header.serviceTableOffset ||
+        header.accountTableOffset > fileSize || accountBytes > fileSize - header.accountTableOffset ||
+        header.stringPoolOffset > fileSize || header.stringPoolSize > fileSize - header.stringPoolOffset ||
+        header.stringPoolSize > VAULT_MAX_POOL_BYTES) {
+        // Pool offsets are 32-bit, and makeRoom relies on no pool being larger than that
+        return false;
+    }
+
+    const VaultServiceRecord* services = reinterpret_cast<const VaultServiceRecord*>(vault.file.data + header.serviceTableOffset);
+    const VaultAccountRecord* accounts = reinterpret_cast<const VaultAccountRecord*>(vault.file.data + header.accountTableOffset);
+
+    uint64_t nextAccount = 0;
+    for (uint32_t i = 0; i < header.serviceCount; ++i) {
+        const VaultServiceRecord& s = services[i];
+        if (!inPool(header, s.labelOffset, s.labelLength) || s.firstAccount != nextAccount) {
+            return false;
+        }
+        nextAccount += s.accountCount;
+    }
+    if (nextAccount != header.accountCount) {
+        return false;
+    }
+    for (uint32_t i = 0; i < header.accountCount; ++i) {
+        const VaultAccountRecord& a = accounts[i];
+        if (!inPool(header, a.nameOffset, a.nameLength) || !inPool(header, a.passwordOffset, a.passwordLength)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool openVault(MappedVault& vault, const std::string& filename) {
+    if (!mapFile(vault.file, filename)) {
+        return false;
+    }
+
+    if (vault.file.size < VAULT_V1_HEADER_SIZE) {
+        std::cerr << "Vault file is truncated: " << filename << std::endl;
+        closeVault(vault);
+        return false;
+    }
+
+    vault.header = reinterpret_cast<const VaultHeader*>(vault.file.data);
+    if (std::memcmp(vault.header->magic, VAULT_MAGIC, sizeof(VAULT_MAGIC)) != 0 ||
+        vault.header->version < 1 || vault.header->version > VAULT_VERSION ||
+        (vault.header->version >= 2 && vault.file.size < sizeof(VaultHeader))) {
+        std::cerr << "Not a supported vault file: " << filename << std::endl;
+        closeVault(vault);
+        return false;
+    }
+    vault.journalSeq = (vault.header->version >= 2) ? vault.header->journalSeq : 0;
+
+    if (!validateVault(vault)) {
+        std::cerr << "Vault file is corrupted: " << filename << std::endl;
+        closeVault(vault);
+        return false;
+    }
+
+    vault.services = reinterpret_cast<const VaultServiceRecord*>(vault.file.data + vault.header->serviceTableOffset);
+    vault.accounts = reinterpret_cast<const VaultAccountRecord*>(vault.file.data + vault.header->accountTableOffset);
+    vault.pool = vault.file.data + vault.header->stringPoolOffset;
+    return true;
+}
+
+void closeVault(MappedVault& vault) {
+    unmapFile(vault.file);
+    vault = MappedVault{};
+}
+
+size_t vaultServiceCount(const MappedVault& vault) {
+    return vault.header ? vault.header->serviceCount : 0;
+}
+
+std::string_view vaultServiceLabel(const MappedVault& vault, size_t service) {
+    const VaultServiceRecord& s = vault.services[service];
+    return { vault.pool + s.labelOffset, s.labelLength };
+}
+
+size_t vaultAccountCount(const MappedVault& vault, size_t service) {
+    return vault.services[service].accountCount;
+}
+
+std::string_view vaultAccountName(const MappedVault& vault, size_t service, size_t account) {
+    const VaultAccountRecord& a = vault.accounts[vault.services[service].firstAccount + account];
+    return { vault.pool + a.nameOffset, a.nameLength };
+}
+
+std::string_view vaultAccountPassword(const MappedVault& vault, size_t service, size_t account) {
+    const VaultAccountRecord& a = vault.accounts[vault.services[service].firstAccount + account];
+    return { vault.pool + a.passwordOffset, a.passwordLength };
+}
+
+bool writeVault(const Vault& vault, const std::string& filename, uint64_t journalSeq) {
+    TRACE_SCOPE("writeVault");
+    // Stale slots and pool bytes are left out, so the file is always the compacted vault
+    size_t serviceCount = vaultServiceCount(vault);
+    uint64_t accountCount = 0;
+    uint64_t poolSize = 0;
+    for (size_t i = 0; i < serviceCount; ++i) {
+        AccountRange range = vault.accountRanges[i];
+        accountCount += range.count;
+        poolSize += vault.labels[i].length;
+        for (uint32_t a = range.first; a < range.first + range.count; ++a) {
+            poolSize += vault.accountNames[a].length + vault.passwords[a].length;
+        }
+    }
+
+    const uint64_t limit = std::numeric_limits<uint32_t>::max();
+    if (serviceCount > limit || accountCount > limit || poolSize > limit) {
+        std::cerr << "Vault is too large for the file format: " << filename << std::endl;
+        return false;
+    }
+
+    VaultHeader header = {};
+    std::memcpy(header.magic, VAULT_MAGIC, sizeof(VAULT_MAGIC));
+    header.version = VAULT_VERSION;
+    header.serviceCount = static_cast<uint32_t>(serviceCount);
+    header.accountCount = static_cast<uint32_t>(accountCount);
+    header.serviceTableOffset = sizeof(VaultHeader);
+    header.accountTableOffset = header.serviceTableOffset + header.serviceCount * sizeof(VaultServiceRecord);
+    header.stringPoolOffset = header.accountTableOffset + header.accountCount * sizeof(VaultAccountRecord);
+    header.stringPoolSize = poolSize;
+    header.journalSeq = journalSeq;
+
+    // The whole image is built in memory and written with a single call
+    SecureVector<char> image(header.stringPoolOffset + poolSize);
+    std::memcpy(image.data(), &header, sizeof(header));
+    VaultServiceRecord* serviceTable = reinterpret_cast<VaultServiceRecord*>(image.data() + header.serviceTableOffset);
+    VaultAccountRecord* accountTable = reinterpret_cast<VaultAccountRecord*>(image.data() + header.accountTableOffset);
+    char* pool = image.data() + header.stringPoolOffset;
+
+    uint32_t poolPos = 0;
+    uint32_t accountPos = 0;
+    auto putString = [&](std::string_view str, uint32_t& offset, uint32_t& length) {
+        offset = poolPos;
+        length = static_cast<uint32_t>(str.size());
+        std::memcpy(pool + poolPos, str.data(), str.size());
+        poolPos += length;
+    };
+
+    for (size_t i = 0; i < serviceCount; ++i) {
+        VaultServiceRecord& record = serviceTable[i];
+        putString(vaultServiceLabel(vault, i), record.labelOffset, record.labelLength);
+        record.firstAccount = accountPos;
+        record.accountCount = static_cast<uint32_t>(vaultAccountCount(vault, i));
+
+        for (size_t a = 0; a < record.accountCount; ++a) {
+            VaultAccountRecord& accountRecord = accountTable[accountPos++];
+            putString(vaultAccountName(vault, i, a), accountRecord.nameOffset, accountRecord.nameLength);
+            putString(vaultAccountPassword(vault, i, a), accountRecord.passwordOffset, accountRecord.passwordLength);
+        }
+    }
+
+    // Written next to the real file and renamed over it, so a torn write is never visible
+    std::string tempFilename = filename + ".tmp";
+    FILE* outFile = std::fopen(tempFilename.c_str(), "wb");
+    if (!outFile) {
+        std::cerr << "Failed to open file for writing: " << tempFilename << std::endl;
+        return false;
+    }
+    bool written = std::fwrite(image.data(), 1, image.size(), outFile) == image.size() && syncFile(outFile);
+    written = (std::fclose(outFile) == 0) && written;
+
+    if (!written || !replaceFile(tempFilename, filename)) {
+        std::cerr << "Failed to write vault: " << filename << std::endl;
+        std::remove(tempFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadVault(Vault& vault, const std::string& filename, uint64_t& journalSeq) {
+    TRACE_SCOPE("loadVault");
+    MappedVault mapped;
+    if (!openVault(mapped, filename)) {
+        return false;
+    }
+    journalSeq = mapped.journalSeq;
+
+    // The file already has the in-memory layout: the pool is copied as one block and the
+    // records only lose the fields the columns don't need
+    const VaultHeader& header = *mapped.header;
+    clearVault(vault);
+    reserveVault(vault, header.serviceCount, header.accountCount, header.stringPoolSize);
+    vault.pool.assign(mapped.pool, header.stringPoolSize);
+    for (uint32_t i = 0; i < header.serviceCount; ++i) {
+        const VaultServiceRecord& s = mapped.services[i];
+        vault.labels.push_back({ s.labelOffset, s.labelLength });
+        vault.accountRanges.push_back({ s.firstAccount, s.accountCount });
+    }
+    for (uint32_t i = 0; i < header.accountCount; ++i) {
+        const VaultAccountRecord& a = mapped.accounts[i];
+        vault.accountNames.push_back({ a.nameOffset, a.nameLength });
+        vault.passwords.push_back({ a.passwordOffset, a.passwordLength });
+    }
+
+    closeVault(mapped);
+    return true;
+}
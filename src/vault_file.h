@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "mapped_file.h"
+#include "vault.h"
+
+// Binary vault layout, all integers little-endian:
+//   VaultHeader | VaultServiceRecord[serviceCount] | VaultAccountRecord[accountCount] | string pool
+// Services own the contiguous account range [firstAccount, firstAccount + accountCount), and the
+// ranges follow each other in service order.
+// Strings are (offset, length) pairs into the pool and are not NUL-terminated.
+// Version 1 headers end before journalSeq
+const char VAULT_MAGIC[4] = { 'S', 'P', 'V', 'T' };
+const uint32_t VAULT_VERSION = 2;
+const size_t VAULT_V1_HEADER_SIZE = 48;
+
+struct VaultHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t serviceCount;
+    uint32_t accountCount;
+    uint64_t serviceTableOffset;
+    uint64_t accountTableOffset;
+    uint64_t stringPoolOffset;
+    uint64_t stringPoolSize;
+    uint64_t journalSeq;    // last journal record already folded into this file
+};
+
+struct VaultServiceRecord {
+    uint32_t labelOffset;
+    uint32_t labelLength;
+    uint32_t firstAccount;
+    uint32_t accountCount;
+};
+
+struct VaultAccountRecord {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t passwordOffset;
+    uint32_t passwordLength;
+};
+
+// A vault file mapped into memory. Strings are read straight out of the mapping
+struct MappedVault {
+    MappedFile file;
+    const VaultHeader* header = nullptr;
+    const VaultServiceRecord* services = nullptr;
+    const VaultAccountRecord* accounts = nullptr;
+    const char* pool = nullptr;
+    uint64_t journalSeq = 0;
+};
+
+// Maps and validates the vault, every record is bounds-checked once here so the accessors don't have to
+bool openVault(MappedVault& vault, const std::string& filename);
+void closeVault(MappedVault& vault);
+
+size_t vaultServiceCount(const MappedVault& vault);
+std::string_view vaultServiceLabel(const MappedVault& vault, size_t service);
+size_t vaultAccountCount(const MappedVault& vault, size_t service);
+std::string_view vaultAccountName(const MappedVault& vault, size_t service, size_t account);
+std::string_view vaultAccountPassword(const MappedVault& vault, size_t service, size_t account);
+
+// Serializes the whole vault into a temp file, syncs it and renames it over filename
+bool writeVault(const Vault& vault, const std::string& filename, uint64_t journalSeq);
+// Copies a mapped vault into vault, sizing every column up front
+bool loadVault(Vault& vault, const std::string& filename, uint64_t& journalSeq);
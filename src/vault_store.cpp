@@ -0,0 +1,381 @@
+#include "vault_store.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "file_util.h"
+#include "legacy_save.h"
+#include "trace.h"
+#include "vault_file.h"
+
+StorePaths storePaths(const std::string& directory) {
+    std::string prefix = directory;
+    if (!prefix.empty() && prefix.back() != '/' && prefix.back() != '\\') {
+        prefix += '/';
+    }
+    return { prefix + PATH_SAVE, prefix + PATH_CORRUPT_SAVE, prefix + PATH_JOURNAL,
+             prefix + PATH_OLD_JOURNAL, prefix + PATH_LEGACY_SAVE, prefix + PATH_LEGACY_BACKUP,
+             prefix + PATH_TRANSFORM };
+}
+
+// Renames filename to aside if it exists. Refuses to replace an earlier aside copy
+static bool moveAside(const std::string& filename, const std::string& aside) {
+    if (!fileExists(filename)) return true;
+    if (fileExists(aside) || std::rename(filename.c_str(), aside.c_str()) != 0) {
+        std::cerr << "Failed to move " << filename << " aside to " << aside << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool moveJournalsAside(const StorePaths& paths) {
+    return moveAside(paths.oldJournal, paths.oldJournal + ".corrupt") && moveAside(paths.journal, paths.journal + ".corrupt");
+}
+
+// Keeps the unreadable vault and the journals that belong to it instead of overwriting them
+static bool moveDamagedAside(const StorePaths& paths) {
+    return moveAside(paths.save, paths.corruptSave) && moveJournalsAside(paths);
+}
+
+const size_t NO_CHUNK = static_cast<size_t>(-1);
+
+static void setChunks(VaultStore& store, bool resident) {
+    store.chunks.resize(store.sealed.chunks.size());
+    for (size_t i = 0; i < store.chunks.size(); ++i) {
+        const SealedChunkEntry& entry = store.sealed.chunks[i];
+        store.chunks[i] = { i, entry.serviceCount, entry, resident, false };
+    }
+    store.nextChunkId = store.chunks.size();
+    store.chunkStartsStale = true;
+}
+
+static void refreshChunkStarts(VaultStore& store) {
+    if (!store.chunkStartsStale) return;
+    store.chunkStarts.resize(store.chunks.size());
+    size_t first = 0;
+    for (size_t i = 0; i < store.chunks.size(); ++i) {
+        store.chunkStarts[i] = first;
+        first += store.chunks[i].serviceCount;
+    }
+    store.chunkStartsStale = false;
+}
+
+static size_t chunkOfService(VaultStore& store, size_t service) {
+    refreshChunkStarts(store);
+    return std::upper_bound(store.chunkStarts.begin(), store.chunkStarts.end(), service) - store.chunkStarts.begin() - 1;
+}
+
+// Needs chunkStarts to be up to date
+static bool loadChunk(VaultStore& store, size_t chunk) {
+    if (store.chunks[chunk].resident) return true;
+    TRACE_SCOPE("loadChunk");
+    size_t first = store.chunkStarts[chunk];
+    const StoreChunk& stored = store.chunks[chunk];
+    SecureVector<char> plain;
+    if (!readSealedChunk(store.sealed, stored.entry, plain)) {
+        return false;
+    }
+    if (!unpackSealedChunk(plain, stored.serviceCount, store.vault, first)) {
+        std::cerr << "Vault chunk at slot " << stored.entry.firstSlot << " is malformed" << std::endl;
+        return false;
+    }
+    store.chunks[chunk].resident = true;
+    ++store.chunksDecrypted;
+    return true;
+}
+
+static bool loadAllChunks(VaultStore& store) {
+    refreshChunkStarts(store);
+    bool ok = true;
+    for (size_t i = 0; i < store.chunks.size(); ++i) {
+        ok = loadChunk(store, i) && ok;
+    }
+    return ok;
+}
+
+bool storeLoadService(VaultStore& store, size_t service) {
+    if (service >= vaultServiceCount(store.vault)) return false;
+    return loadChunk(store, chunkOfService(store, service));
+}
+
+OpenStoreResult openStore(VaultStore& store, std::string_view passphrase, const std::string& directory, bool setAsideDamaged) {
+    TRACE_SCOPE("openStore");
+    store.paths = storePaths(directory);
+    const StorePaths& paths = store.paths;
+    uint64_t vaultSeq = 0;
+    bool sealed = false;
+    bool plaintext = false;       // loaded from a plaintext save.vault or save.txt
+    SealedKey key;
+
+    if (fileExists(paths.save) && isSealedVault(paths.save)) {
+        switch (openSealedVault(store.sealed, paths.save, passphrase)) {
+        case SealedOpenResult::WrongPassphrase:
+            return OpenStoreResult::WrongPassphrase;
+        case SealedOpenResult::Unreadable:
+            return OpenStoreResult::Failed;
+        case SealedOpenResult::Damaged:
+            if (!setAsideDamaged) return OpenStoreResult::Damaged;
+            if (!moveDamagedAside(paths)) return OpenStoreResult::Failed;
+            break;
+        case SealedOpenResult::Opened:
+            sealed = true;
+            key = store.sealed.key;
+            vaultSeq = store.sealed.journalSeq;
+            break;
+        }
+    } else if (fileExists(paths.save)) {
+        plaintext = loadVault(store.vault, paths.save, vaultSeq);
+        if (!plaintext) {
+            clearVault(store.vault);
+            if (!setAsideDamaged) return OpenStoreResult::Damaged;
+            if (!moveDamagedAside(paths)) return OpenStoreResult::Failed;
+        }
+    } else if (fileExists(paths.legacySave)) {
+        // Encrypting part of it would delete the rest along with the plaintext, so it stays as it is
+        if (!loadFromFile(store.vault, paths.legacySave)) {
+            return OpenStoreResult::Failed;
+        }
+        plaintext = true;
+    }
+
+    if (sealed) {
+        size_t services = 0;
+        for (const SealedChunkEntry& chunk : store.sealed.chunks) {
+            services += chunk.serviceCount;
+        }
+        vaultAddPlaceholders(store.vault, services);
+        setChunks(store, false);
+    } else if (!deriveSealedKey(key, passphrase)) {
+        return OpenStoreResult::Failed;
+    }
+
+    // A journal that survived means the last session ended before it was folded in. Its records
+    // name services by index, so replaying needs the whole vault
+    bool hadJournal = fileExists(paths.oldJournal) || fileExists(paths.journal);
+    uint64_t lastSeq = vaultSeq;
+    if (hadJournal) {
+        if (!loadAllChunks(store)) {
+            closeSealedVault(store.sealed);
+            return OpenStoreResult::Failed;
+        }
+        const AeadKey* journalKey = sealed ? &key.key : nullptr;
+        const uint8_t* fileId = store.sealed.header.fileId;
+        if (!replayJournal(paths.oldJournal, vaultSeq, store.vault, lastSeq, journalKey, fileId) ||
+            !replayJournal(paths.journal, vaultSeq, store.vault, lastSeq, journalKey, fileId)) {
+            std::cerr << "Journal replay stopped early, keeping the journals as *.corrupt" << std::endl;
+            if (!moveJournalsAside(paths)) {
+                closeSealedVault(store.sealed);
+                return OpenStoreResult::Failed;
+            }
+        }
+    }
+
+    // Anything but a sealed vault without a journal is written out as a new sealed vault
+    if (!sealed || hadJournal) {
+        if (!createSealedVault(store.sealed, paths.save, key, store.vault, lastSeq)) {
+            return OpenStoreResult::Failed;
+        }
+        std::remove(paths.oldJournal.c_str());
+        std::remove(paths.journal.c_str());
+        setChunks(store, true);
+    }
+    if (plaintext) {
+        // The passwords are sealed now, so the plaintext copies go
+        std::remove(paths.legacySave.c_str());
+        std::remove(paths.legacyBackup.c_str());
+        std::cerr << "Encrypted the plaintext vault into " << paths.save << std::endl;
+    }
+    std::cerr << "Unlocked " << vaultServiceCount(store.vault) << " services in " << store.chunks.size()
+              << " chunks" << std::endl;
+
+    bool writing = startWriter(store.writer, store.sealed);
+    bool journaling = openJournal(store.journal, paths.journal, lastSeq + 1, &store.sealed.key.key, store.sealed.header.fileId);
+    return writing && journaling ? OpenStoreResult::Opened : OpenStoreResult::OpenedWithoutJournal;
+}
+
+// Serializes the chunks edited since the last request. Neighbouring edited chunks are packed
+// together, so chunks that split as they grew merge again. The rest go by id only, so the UI
+// thread only pays for what changed
+static bool buildSaveRequest(VaultStore& store, SaveRequest& request) {
+    TRACE_SCOPE("buildSaveRequest");
+    std::vector<StoreChunk> chunks;
+    chunks.reserve(store.chunks.size());
+    std::vector<SealedChunkPlain> packed;
+    size_t first = 0;
+    for (size_t i = 0; i < store.chunks.size();) {
+        const StoreChunk& chunk = store.chunks[i];
+        if (!chunk.dirty) {
+            request.chunks.push_back({ chunk.id, chunk.serviceCount, {} });
+            chunks.push_back(chunk);
+            first += chunk.serviceCount;
+            ++i;
+            continue;
+        }
+        size_t count = 0;
+        for (; i < store.chunks.size() && store.chunks[i].dirty; ++i) {
+            count += store.chunks[i].serviceCount;
+        }
+        packed.clear();
+        if (!packSealedChunks(store.vault, first, count, packed)) {
+            std::cerr << "Vault chunk is too large to save" << std::endl;
+            return false;
+        }
+        for (SealedChunkPlain& plain : packed) {
+            uint64_t id = store.nextChunkId++;
+            request.chunks.push_back({ id, plain.serviceCount, std::move(plain.data) });
+            chunks.push_back({ id, plain.serviceCount, {}, true, false });
+        }
+        first += count;
+    }
+    store.chunks = std::move(chunks);
+    store.chunkStartsStale = true;
+    return true;
+}
+
+// Rotates the journal and hands the edited chunks to the writer thread, so the UI only pays for
+// serializing what changed
+static void startCompaction(VaultStore& store) {
+    if (!writerIdle(store.writer)) return;
+    // Left behind by a compaction that failed to write the vault; its records are still needed
+    if (fileExists(store.paths.oldJournal)) return;
+
+    uint64_t seq = store.journal.nextSeq - 1;
+    closeJournal(store.journal);
+    bool rotated = std::rename(store.paths.journal.c_str(), store.paths.oldJournal.c_str()) == 0;
+    openJournal(store.journal, store.paths.journal, seq + 1, &store.sealed.key.key, store.sealed.header.fileId);
+    if (!rotated) {
+        // The records are still in the journal, which now counts from zero, so closeStore mustn't remove it
+        store.unjournaledEdits = true;
+        return;
+    }
+
+    SaveRequest request;
+    if (!buildSaveRequest(store, request)) return;
+    request.journalSeq = seq;
+    request.obsoleteFiles = { store.paths.oldJournal };
+    queueSave(store.writer, std::move(request));
+}
+
+void closeStore(VaultStore& store) {
+    TRACE_SCOPE("closeStore");
+    waitForWriter(store.writer);
+
+    uint64_t lastSeq = store.journal.nextSeq - 1;
+    bool pending = store.journal.recordCount > 0 || store.unjournaledEdits || fileExists(store.paths.oldJournal);
+    closeJournal(store.journal);
+    if (!pending) {
+        std::remove(store.paths.journal.c_str());
+    } else {
+        SaveRequest request;
+        bool queued = buildSaveRequest(store, request);
+        if (queued) {
+            request.journalSeq = lastSeq;
+            request.obsoleteFiles = { store.paths.oldJournal, store.paths.journal };
+            queueSave(store.writer, std::move(request));
+        }
+        if (!queued || !waitForWriter(store.writer)) {
+            std::cerr << "Failed to save vault, journaled edits stay in " << store.paths.journal << std::endl;
+        }
+    }
+    stopWriter(store.writer);
+    std::cerr << "Decrypted " << store.chunksDecrypted << " vault chunks this session, the vault has "
+              << store.chunks.size() << std::endl;
+    closeSealedVault(store.sealed);
+}
+
+static void journal(VaultStore& store, JournalRecord& record) {
+    if (!appendJournal(store.journal, record)) {
+        // The edit is still applied in memory and gets saved when the store is closed
+        store.unjournaledEdits = true;
+        return;
+    }
+    if (store.journal.recordCount >= JOURNAL_COMPACT_RECORDS) {
+        startCompaction(store);
+    }
+}
+
+// Decrypts the chunk holding service and marks it for the next save. Returns its index
+static size_t touchChunk(VaultStore& store, size_t service) {
+    size_t chunk = chunkOfService(store, service);
+    if (!loadChunk(store, chunk)) return NO_CHUNK;
+    store.chunks[chunk].dirty = true;
+    return chunk;
+}
+
+void storeAddService(VaultStore& store, const std::string& label) {
+    // New services join the last chunk, which splits when it is saved if they no longer fit
+    size_t services = vaultServiceCount(store.vault);
+    if (services == 0) {
+        store.chunks.push_back({ store.nextChunkId++, 0, {}, true, true });
+        store.chunkStartsStale = true;
+    } else if (touchChunk(store, services - 1) == NO_CHUNK) {
+        return;
+    }
+
+    JournalRecord record;
+    record.op = JOURNAL_ADD_SERVICE;
+    record.text1 = label;
+    if (!applyJournalRecord(store.vault, record)) return;
+    ++store.chunks.back().serviceCount;
+    if (store.searchBuilt) {
+        searchAddService(store.search, store.vault, vaultServiceCount(store.vault) - 1);
+    }
+    journal(store, record);
+}
+
+void storeAddAccount(VaultStore& store, size_t service, const std::string& name, const std::string& password) {
+    if (service >= vaultServiceCount(store.vault) || touchChunk(store, service) == NO_CHUNK) return;
+    JournalRecord record;
+    record.op = JOURNAL_ADD_ACCOUNT;
+    record.service = static_cast<uint32_t>(service);
+    record.text1 = name;
+    record.text2 = password;
+    if (!applyJournalRecord(store.vault, record)) return;
+    if (store.searchBuilt) {
+        searchUpdateService(store.search, store.vault, service);
+    }
+    journal(store, record);
+}
+
+void storeDeleteAccount(VaultStore& store, size_t service, size_t account) {
+    if (service >= vaultServiceCount(store.vault) || touchChunk(store, service) == NO_CHUNK) return;
+    JournalRecord record;
+    record.op = JOURNAL_DELETE_ACCOUNT;
+    record.service = static_cast<uint32_t>(service);
+    record.account = static_cast<uint32_t>(account);
+    if (!applyJournalRecord(store.vault, record)) return;
+    if (store.searchBuilt) {
+        searchUpdateService(store.search, store.vault, service);
+    }
+    journal(store, record);
+}
+
+void storeDeleteService(VaultStore& store, size_t service) {
+    size_t chunk = service < vaultServiceCount(store.vault) ? touchChunk(store, service) : NO_CHUNK;
+    if (chunk == NO_CHUNK) return;
+    JournalRecord record;
+    record.op = JOURNAL_DELETE_SERVICE;
+    record.service = static_cast<uint32_t>(service);
+    if (!applyJournalRecord(store.vault, record)) return;
+    // An emptied chunk simply drops out of the next directory
+    if (--store.chunks[chunk].serviceCount == 0) {
+        store.chunks.erase(store.chunks.begin() + chunk);
+    }
+    store.chunkStartsStale = true;
+    if (store.searchBuilt) {
+        searchRemoveService(store.search, service);
+    }
+    journal(store, record);
+}
+
+void storeSearch(VaultStore& store, std::string_view query, std::vector<SearchResult>& results) {
+    if (!store.searchBuilt && !query.empty()) {
+        // Chunks that fail to authenticate stay placeholders and never match
+        loadAllChunks(store);
+        buildSearchIndex(store.search, store.vault);
+        store.searchBuilt = true;
+    }
+    searchServices(store.search, query, results);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "journal.h"
+#include "sealed_vault.h"
+#include "search.h"
+#include "vault.h"
+#include "vault_writer.h"
+
+const char PATH_SAVE[] = "save.vault";
+const char PATH_CORRUPT_SAVE[] = "save.vault.corrupt";
+const char PATH_JOURNAL[] = "save.journal";
+const char PATH_OLD_JOURNAL[] = "save.journal.old";
+const char PATH_LEGACY_SAVE[] = "save.txt";
+const char PATH_LEGACY_BACKUP[] = "save.txt.bak";
+const char PATH_TRANSFORM[] = "transform.txt";
+
+// Where one store keeps its files, all inside the directory passed to openStore
+struct StorePaths {
+    std::string save;
+    std::string corruptSave;
+    std::string journal;
+    std::string oldJournal;
+    std::string legacySave;
+    std::string legacyBackup;
+    std::string transform;      // password transform rules for the Copy button, see password_transform.h
+};
+
+StorePaths storePaths(const std::string& directory);
+
+// Journal records after which the journal is folded back into save.vault in the background
+const size_t JOURNAL_COMPACT_RECORDS = 256;
+
+// A run of consecutive services that is sealed as one chunk of save.vault
+struct StoreChunk {
+    uint64_t id = 0;                  // names the chunk to the writer
+    uint32_t serviceCount = 0;
+    SealedChunkEntry entry = {};      // where it was when the store was opened, for decrypting it
+    bool resident = false;            // decrypted into the vault
+    bool dirty = false;               // edited since it was last handed to the writer
+};
+
+// The vault plus everything needed to persist edits to it as they happen. All mutations
+// go through the store* functions so each one is journaled before it returns.
+//
+// Only the chunks something has asked for are decrypted. The services of the others are empty
+// placeholders in the vault until storeLoadService or the first search brings them in
+struct VaultStore {
+    Vault vault;
+    SealedVault sealed;               // read handle on save.vault as it was unlocked
+    std::vector<StoreChunk> chunks;   // in service order
+    std::vector<size_t> chunkStarts;  // first service of each chunk, rebuilt when stale
+    bool chunkStartsStale = true;
+    uint64_t nextChunkId = 0;
+    size_t chunksDecrypted = 0;
+    SearchIndex search;               // built by the first query, then follows every mutation
+    bool searchBuilt = false;
+    Journal journal;
+    bool unjournaledEdits = false;    // edits the journal failed to take, only closeStore saves them
+    VaultWriter writer;
+    StorePaths paths;
+};
+
+enum class OpenStoreResult {
+    Opened,
+    OpenedWithoutJournal,             // edits will only be saved on exit
+    WrongPassphrase,
+    Damaged,                          // save.vault failed to authenticate or load, nothing was touched
+    Failed                            // nothing could be opened or created, the files are left as they were
+};
+
+// Unlocks save.vault in directory, the working directory if empty, with passphrase. Without a
+// sealed vault one is created with that passphrase, importing a plaintext save.vault or save.txt
+// and removing the plaintext. A journal left behind by a crash is replayed and folded in.
+// A damaged save.vault is only renamed to save.vault.corrupt, along with its journals, and
+// replaced by an empty vault when setAsideDamaged is set, after the user agreed to it
+OpenStoreResult openStore(VaultStore& store, std::string_view passphrase, const std::string& directory = "",
+                          bool setAsideDamaged = false);
+// Folds the remaining journal into save.vault on the writer thread and waits for it to finish
+void closeStore(VaultStore& store);
+
+// Decrypts the chunk holding service unless it already is. Returns false if it fails to authenticate
+bool storeLoadService(VaultStore& store, size_t service);
+
+// Each edit decrypts the chunk it touches first, and is dropped if that chunk fails to authenticate
+void storeAddService(VaultStore& store, const std::string& label);
+void storeAddAccount(VaultStore& store, size_t service, const std::string& name, const std::string& password);
+void storeDeleteAccount(VaultStore& store, size_t service, size_t account);
+void storeDeleteService(VaultStore& store, size_t service);
+
+// Services matching query, best first. An empty query matches nothing. The first query decrypts
+// the whole vault to build the index
+void storeSearch(VaultStore& store, std::string_view query, std::vector<SearchResult>& results);
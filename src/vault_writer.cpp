@@ -0,0 +1,134 @@
+#include "vault_writer.h"
+
+#include <cstdio>
+#include <iostream>
+#include <utility>
+
+#include "trace.h"
+
+// Chunks the writer has committed before go into the directory as they are, the rest are sealed
+// from plains. On failure every plaintext goes back into plains for the next attempt
+static bool commitRequest(VaultWriter& writer, const SaveRequest& request,
+                          std::unordered_map<uint64_t, SecureVector<char>>& plains) {
+    TRACE_SCOPE("commitRequest");
+    std::vector<SealedChunkUpdate> updates(request.chunks.size());
+    bool complete = true;
+    for (size_t i = 0; i < request.chunks.size() && complete; ++i) {
+        const SaveChunk& chunk = request.chunks[i];
+        updates[i].serviceCount = chunk.serviceCount;
+        auto committed = writer.committed.find(chunk.id);
+        auto plain = plains.find(chunk.id);
+        if (committed != writer.committed.end()) {
+            updates[i].entry = committed->second;
+        } else if (plain != plains.end()) {
+            updates[i].plain = std::move(plain->second);
+        } else {
+            std::cerr << "Nothing to save for vault chunk " << chunk.id << std::endl;
+            complete = false;
+        }
+    }
+
+    if (complete && commitSealedVault(writer.sealed, updates, request.journalSeq)) {
+        writer.committed.clear();
+        for (size_t i = 0; i < updates.size(); ++i) {
+            writer.committed[request.chunks[i].id] = updates[i].entry;
+        }
+        return true;
+    }
+    for (size_t i = 0; i < updates.size(); ++i) {
+        if (!updates[i].plain.empty()) {
+            plains[request.chunks[i].id] = std::move(updates[i].plain);
+        }
+    }
+    std::cerr << "Failed to write vault: " << writer.sealed.filename << std::endl;
+    return false;
+}
+
+static void writerLoop(VaultWriter& writer) {
+    setTraceThreadName("vault writer");
+    std::unique_lock<std::mutex> lock(writer.mutex);
+    while (true) {
+        writer.wake.wait(lock, [&]() { return writer.hasPending || writer.stopping; });
+        if (!writer.hasPending) break;
+
+        SaveRequest request = std::move(writer.pending);
+        writer.pending = SaveRequest{};
+        writer.hasPending = false;
+        writer.busy = true;
+        std::unordered_map<uint64_t, SecureVector<char>> plains = std::move(writer.unsaved);
+        writer.unsaved.clear();
+        lock.unlock();
+
+        // Plaintexts of chunks this request replaced are dropped with plains once it is committed
+        bool ok = commitRequest(writer, request, plains);
+        if (ok) {
+            for (const auto& file : request.obsoleteFiles) {
+                std::remove(file.c_str());
+            }
+        }
+
+        lock.lock();
+        if (!ok) {
+            for (auto& plain : plains) {
+                writer.unsaved[plain.first] = std::move(plain.second);
+            }
+        }
+        writer.busy = false;
+        writer.lastSaveOk = ok;
+        writer.idle.notify_all();
+    }
+}
+
+bool startWriter(VaultWriter& writer, const SealedVault& source) {
+    // Without a handle every commit fails, but edits still reach the journal
+    bool opened = reopenSealedVault(writer.sealed, source, true);
+    writer.committed.clear();
+    for (size_t i = 0; i < source.chunks.size(); ++i) {
+        writer.committed[i] = source.chunks[i];
+    }
+    writer.stopping = false;
+    writer.thread = std::thread(writerLoop, std::ref(writer));
+    return opened;
+}
+
+void stopWriter(VaultWriter& writer) {
+    {
+        std::lock_guard<std::mutex> lock(writer.mutex);
+        writer.stopping = true;
+    }
+    writer.wake.notify_one();
+    if (writer.thread.joinable()) {
+        writer.thread.join();
+    }
+    closeSealedVault(writer.sealed);
+}
+
+void queueSave(VaultWriter& writer, SaveRequest request) {
+    {
+        std::lock_guard<std::mutex> lock(writer.mutex);
+        for (SaveChunk& chunk : request.chunks) {
+            if (!chunk.plain.empty()) {
+                writer.unsaved[chunk.id] = std::move(chunk.plain);
+                chunk.plain = SecureVector<char>();
+            }
+        }
+        // The newer request contains everything the replaced one did, including what it made obsolete
+        for (auto& file : writer.pending.obsoleteFiles) {
+            request.obsoleteFiles.push_back(std::move(file));
+        }
+        writer.pending = std::move(request);
+        writer.hasPending = true;
+    }
+    writer.wake.notify_one();
+}
+
+bool writerIdle(VaultWriter& writer) {
+    std::lock_guard<std::mutex> lock(writer.mutex);
+    return !writer.busy && !writer.hasPending;
+}
+
+bool waitForWriter(VaultWriter& writer) {
+    std::unique_lock<std::mutex> lock(writer.mutex);
+    writer.idle.wait(lock, [&]() { return !writer.busy && !writer.hasPending; });
+    return writer.lastSaveOk;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "sealed_vault.h"
+
+// One chunk of the vault as it should be saved. Chunks are named by ids the store hands out, and
+// a chunk's plaintext is only sent once: later requests name it by id alone
+struct SaveChunk {
+    uint64_t id = 0;
+    uint32_t serviceCount = 0;
+    SecureVector<char> plain;         // empty if an earlier request already brought it
+};
+
+struct SaveRequest {
+    std::vector<SaveChunk> chunks;    // the whole vault, in service order
+    uint64_t journalSeq = 0;
+    std::vector<std::string> obsoleteFiles;   // removed once the request is safely on disk
+};
+
+// Dedicated thread that seals changed chunks into the vault with commitSealedVault, so the UI
+// thread never waits on the disk or the cipher. Only the newest queued request is written
+struct VaultWriter {
+    SealedVault sealed;               // writable handle of its own
+    std::unordered_map<uint64_t, SealedChunkEntry> committed;
+    std::unordered_map<uint64_t, SecureVector<char>> unsaved;   // plaintexts not committed yet
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+
+    SaveRequest pending;
+    bool hasPending = false;
+    bool busy = false;
+    bool stopping = false;
+    bool lastSaveOk = true;
+};
+
+// Takes over source's committed chunks as ids 0 to n - 1
+bool startWriter(VaultWriter& writer, const SealedVault& source);
+// Writes whatever is still queued, then joins the thread
+void stopWriter(VaultWriter& writer);
+
+// Queues a request, replacing one that hasn't been picked up yet
+void queueSave(VaultWriter& writer, SaveRequest request);
+bool writerIdle(VaultWriter& writer);
+// Blocks until everything queued is written. Returns whether the last write succeeded
+bool waitForWriter(VaultWriter& writer);
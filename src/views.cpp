@@ -0,0 +1,171 @@
+#include "views.h"
+
+#include "trace.h"
+
+MainLayout mainLayout() {
+    int spacing = 10;
+    int buttonHeight = 50;
+    int buttonWidth = static_cast<int>(WINDOW_WIDTH * 0.5);
+    int xStart = static_cast<int>(WINDOW_WIDTH * 0.1);
+    int yStart = static_cast<int>(WINDOW_HEIGHT * 0.1);
+    int scrollAreaHeight = WINDOW_HEIGHT - 100;
+
+    MainLayout layout;
+    layout.serviceList = { xStart, buttonWidth, yStart, buttonHeight, spacing, yStart, scrollAreaHeight };
+    layout.searchRect = { xStart, 15, buttonWidth, 40 };
+    layout.addServiceBtn = { WINDOW_WIDTH - 160, WINDOW_HEIGHT - 70, 140, 50 };
+    layout.servicesLabel = { xStart + buttonWidth + 20, yStart };
+    return layout;
+}
+
+size_t listRowCount(const Vault& vault, std::string_view query, const std::vector<SearchResult>& results) {
+    return query.empty() ? vaultServiceCount(vault) : results.size();
+}
+
+size_t listRowService(std::string_view query, const std::vector<SearchResult>& results, size_t row) {
+    return query.empty() ? row : results[row].service;
+}
+
+void drawMainFrame(SDL_Renderer* renderer, GlyphAtlas& atlas, LabelCache& labels, const MainLayout& layout,
+                   const Vault& vault, std::string_view query, const std::vector<SearchResult>& results, int scrollOffset) {
+    TRACE_SCOPE("drawMainFrame");
+    SDL_SetRenderDrawColor(renderer, 25, 25, 25, 255);
+    SDL_RenderClear(renderer);
+
+    // Draw search bar
+    SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
+    SDL_RenderFillRect(renderer, &layout.searchRect);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderDrawRect(renderer, &layout.searchRect);
+    if (query.empty()) {
+        drawCachedText(renderer, labels, atlas, "Search", layout.searchRect.x + 5, layout.searchRect.y + 8, { 150, 150, 150, 255 });
+    } else {
+        drawText(renderer, atlas, query, layout.searchRect.x + 5, layout.searchRect.y + 8, { 255, 255, 255, 255 });
+    }
+
+    // Draw "Services" label
+    drawCachedText(renderer, labels, atlas, "Services", layout.servicesLabel.x, layout.servicesLabel.y, { 255, 255, 255, 255 });
+
+    VisibleRange visible = visibleRows(layout.serviceList, listRowCount(vault, query, results), scrollOffset);
+    for (size_t row = visible.first; row < visible.last; ++row) {
+        size_t i = listRowService(query, results, row);
+        SDL_Rect btnRect = rowRect(layout.serviceList, row, scrollOffset);
+        SDL_SetRenderDrawColor(renderer, 70, 130, 180, 255);
+        SDL_RenderFillRect(renderer, &btnRect);
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderDrawRect(renderer, &btnRect);
+
+        // Draw label text
+        std::string_view label = vaultServiceLabel(vault, i);
+        if (!label.empty()) {
+            drawCachedTextCentered(renderer, labels, atlas, label, btnRect, { 255, 255, 255, 255 });
+        }
+    }
+
+    // Draw Add Service Button
+    SDL_SetRenderDrawColor(renderer, 34, 139, 34, 255);
+    SDL_RenderFillRect(renderer, &layout.addServiceBtn);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderDrawRect(renderer, &layout.addServiceBtn);
+
+    drawCachedTextCentered(renderer, labels, atlas, "Add Service", layout.addServiceBtn, { 255, 255, 255, 255 });
+}
+
+DetailsLayout detailsLayout() {
+    const int blockHeight = 120;
+    const int spacing = 10;
+    int paddingY = 20;
+    int paddingX = 50;
+    int btnHeight = 50;
+    int btnWidth = 300;
+
+    DetailsLayout layout;
+    layout.accountList = { 50, 300, 80, blockHeight, spacing, 0, WINDOW_HEIGHT };
+    layout.addAccountBtn = { paddingX, WINDOW_HEIGHT - paddingY - btnHeight, btnWidth, btnHeight };
+    layout.deleteServiceBtn = { layout.addAccountBtn.x, layout.addAccountBtn.y - layout.addAccountBtn.h - paddingY,
+                                layout.addAccountBtn.w, layout.addAccountBtn.h };
+    return layout;
+}
+
+SDL_Rect accountDeleteButton(const SDL_Rect& blockRect) {
+    return { blockRect.x + 30, blockRect.y + 70, 80, 30 };
+}
+
+SDL_Rect accountCopyButton(const SDL_Rect& blockRect) {
+    return { blockRect.x + 150, blockRect.y + 70, 80, 30 };
+}
+
+void drawDetailsFrame(SDL_Renderer* renderer, GlyphAtlas& atlas, LabelCache& labels, const DetailsLayout& layout,
+                      const Vault& vault, size_t service, int scrollOffset, int copiedIndex,
+                      std::string_view transformError) {
+    TRACE_SCOPE("drawDetailsFrame");
+    SDL_Color white = { 255, 255, 255, 255 };
+    SDL_Color grey = { 140, 140, 140, 255 };
+    bool copyEnabled = transformError.empty();
+
+    // Background
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
+    SDL_RenderFillRect(renderer, nullptr);
+
+    // Title
+    int titleX = drawCachedText(renderer, labels, atlas, "Service: ", 60, 30, white);
+    drawCachedText(renderer, labels, atlas, vaultServiceLabel(vault, service), titleX, 30, white);
+    if (!copyEnabled) {
+        SDL_Color red = { 255, 110, 110, 255 };
+        drawCachedText(renderer, labels, atlas, transformError, 60, 52, red);
+    }
+
+    // Add Account button
+    SDL_SetRenderDrawColor(renderer, 34, 139, 34, 255);
+    SDL_RenderFillRect(renderer, &layout.addAccountBtn);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderDrawRect(renderer, &layout.addAccountBtn);
+
+    drawCachedTextCentered(renderer, labels, atlas, "Add Account", layout.addAccountBtn, white);
+
+    if (vaultAccountCount(vault, service) > 0) {
+        VisibleRange visible = visibleRows(layout.accountList, vaultAccountCount(vault, service), scrollOffset);
+        for (size_t i = visible.first; i < visible.last; ++i) {
+            SDL_Rect blockRect = rowRect(layout.accountList, i, scrollOffset);
+            SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
+            SDL_RenderFillRect(renderer, &blockRect);
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+            SDL_RenderDrawRect(renderer, &blockRect);
+
+            int accX = drawCachedText(renderer, labels, atlas, "Account: ", blockRect.x + 10, blockRect.y + 10, white);
+            drawCachedText(renderer, labels, atlas, vaultAccountName(vault, service, i), accX, blockRect.y + 10, white);
+
+            int passX = drawCachedText(renderer, labels, atlas, "Password: ", blockRect.x + 10, blockRect.y + 35, white);
+            // Straight from the atlas, so no copy of the password outlives this frame in the label cache
+            drawText(renderer, atlas, vaultAccountPassword(vault, service, i), passX, blockRect.y + 35, white);
+
+            SDL_Rect deleteBtn = accountDeleteButton(blockRect);
+            SDL_SetRenderDrawColor(renderer, 200, 50, 50, 255);
+            SDL_RenderFillRect(renderer, &deleteBtn);
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+            SDL_RenderDrawRect(renderer, &deleteBtn);
+
+            drawCachedTextCentered(renderer, labels, atlas, "Delete", deleteBtn, white);
+
+            // Greyed out while the transform rules are broken, since clicking it does nothing
+            SDL_Rect copyBtn = accountCopyButton(blockRect);
+            if (copyEnabled) SDL_SetRenderDrawColor(renderer, 50, 150, 200, 255);
+            else SDL_SetRenderDrawColor(renderer, 70, 70, 70, 255);
+            SDL_RenderFillRect(renderer, &copyBtn);
+            if (copyEnabled) SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+            else SDL_SetRenderDrawColor(renderer, 110, 110, 110, 255);
+            SDL_RenderDrawRect(renderer, &copyBtn);
+
+            const char* copyText = (static_cast<int>(i) == copiedIndex) ? "Copied!" : "Copy";
+            drawCachedTextCentered(renderer, labels, atlas, copyText, copyBtn, copyEnabled ? white : grey);
+        }
+    } else {
+        // Delete Service button (no accounts case)
+        SDL_SetRenderDrawColor(renderer, 200, 50, 50, 255);
+        SDL_RenderFillRect(renderer, &layout.deleteServiceBtn);
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        SDL_RenderDrawRect(renderer, &layout.deleteServiceBtn);
+
+        drawCachedTextCentered(renderer, labels, atlas, "Delete Service", layout.deleteServiceBtn, white);
+    }
+}
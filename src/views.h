@@ -0,0 +1,52 @@
+#pragma once
+
+#include <SDL.h>
+#include <string_view>
+#include <vector>
+
+#include "label_cache.h"
+#include "search.h"
+#include "text_atlas.h"
+#include "vault.h"
+#include "virtual_list.h"
+
+const int WINDOW_WIDTH = 400;
+const int WINDOW_HEIGHT = 700;
+
+// Where everything on the main screen sits
+struct MainLayout {
+    VirtualList serviceList;
+    SDL_Rect searchRect;
+    SDL_Rect addServiceBtn;
+    SDL_Point servicesLabel;
+};
+
+MainLayout mainLayout();
+
+// With an empty query the list shows every service, otherwise the ranked matches
+size_t listRowCount(const Vault& vault, std::string_view query, const std::vector<SearchResult>& results);
+size_t listRowService(std::string_view query, const std::vector<SearchResult>& results, size_t row);
+
+// Draws one frame of the main screen, without presenting it
+void drawMainFrame(SDL_Renderer* renderer, GlyphAtlas& atlas, LabelCache& labels, const MainLayout& layout,
+                   const Vault& vault, std::string_view query, const std::vector<SearchResult>& results, int scrollOffset);
+
+// Where everything in the service details popup sits
+struct DetailsLayout {
+    VirtualList accountList;
+    SDL_Rect addAccountBtn;
+    SDL_Rect deleteServiceBtn;
+};
+
+DetailsLayout detailsLayout();
+
+// Delete and Copy buttons of an account block, shared by drawing and hit-testing so they always agree
+SDL_Rect accountDeleteButton(const SDL_Rect& blockRect);
+SDL_Rect accountCopyButton(const SDL_Rect& blockRect);
+
+// Draws one frame of the details popup over whatever is on screen. The Copy button of account
+// copiedIndex reads "Copied!", -1 for none. A transformError disables every Copy button and is
+// shown under the title
+void drawDetailsFrame(SDL_Renderer* renderer, GlyphAtlas& atlas, LabelCache& labels, const DetailsLayout& layout,
+                      const Vault& vault, size_t service, int scrollOffset, int copiedIndex,
+                      std::string_view transformError = {});
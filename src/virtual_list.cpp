@@ -0,0 +1,49 @@
+#include "virtual_list.h"
+
+#include <algorithm>
+#include <climits>
+
+static long long floorDiv(long long a, long long b) {
+    long long q = a / b;
+    if ((a % b != 0) && ((a < 0) != (b < 0))) --q;
+    return q;
+}
+
+VisibleRange visibleRows(const VirtualList& list, size_t count, int scrollOffset) {
+    long long stride = list.rowHeight + list.spacing;
+    long long origin = static_cast<long long>(list.top) - scrollOffset;
+
+    // Row i is visible when origin + i * stride + rowHeight >= viewTop and origin + i * stride <= viewBottom
+    long long first = floorDiv(list.viewTop - origin - list.rowHeight + stride - 1, stride);
+    long long last = floorDiv(list.viewBottom - origin, stride) + 1;
+
+    first = std::clamp(first, 0LL, static_cast<long long>(count));
+    last = std::clamp(last, first, static_cast<long long>(count));
+    return { static_cast<size_t>(first), static_cast<size_t>(last) };
+}
+
+SDL_Rect rowRect(const VirtualList& list, size_t index, int scrollOffset) {
+    long long y = list.top + static_cast<long long>(index) * (list.rowHeight + list.spacing) - scrollOffset;
+    return { list.x, static_cast<int>(y), list.width, list.rowHeight };
+}
+
+size_t hitTestRow(const VirtualList& list, size_t count, int scrollOffset, int x, int y) {
+    if (x < list.x || x > list.x + list.width) return NO_ROW;
+    if (y < list.viewTop || y > list.viewBottom) return NO_ROW;
+
+    long long stride = list.rowHeight + list.spacing;
+    long long offset = static_cast<long long>(y) - list.top + scrollOffset;
+    long long index = floorDiv(offset, stride);
+    if (index < 0 || index >= static_cast<long long>(count)) return NO_ROW;
+
+    // Points in the spacing below a row belong to no row at all
+    if (offset - index * stride > list.rowHeight) return NO_ROW;
+    return static_cast<size_t>(index);
+}
+
+int maxScrollOffset(const VirtualList& list, size_t count) {
+    if (count == 0) return 0;
+    long long contentBottom = list.top + static_cast<long long>(count) * (list.rowHeight + list.spacing) - list.spacing;
+    long long overflow = contentBottom - list.viewBottom;
+    return static_cast<int>(std::clamp(overflow, 0LL, static_cast<long long>(INT_MAX)));
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <SDL.h>
+#include <cstddef>
+
+// Fixed-height rows stacked vertically. Only the rows overlapping the view band are ever
+// laid out or hit-tested, so the cost of a frame does not depend on how many rows exist
+struct VirtualList {
+    int x, width;
+    int top;                    // y of the first row when scrollOffset is 0
+    int rowHeight;
+    int spacing;
+    int viewTop, viewBottom;    // vertical band the rows are visible in
+};
+
+// Half-open range [first, last) of the rows that overlap the view band
+struct VisibleRange {
+    size_t first;
+    size_t last;
+};
+
+const size_t NO_ROW = static_cast<size_t>(-1);
+
+VisibleRange visibleRows(const VirtualList& list, size_t count, int scrollOffset);
+SDL_Rect rowRect(const VirtualList& list, size_t index, int scrollOffset);
+
+// Returns the visible row under (x, y), or NO_ROW
+size_t hitTestRow(const VirtualList& list, size_t count, int scrollOffset, int x, int y);
+
+// Largest scrollOffset that still keeps the last row inside the view band
+int maxScrollOffset(const VirtualList& list, size_t count);
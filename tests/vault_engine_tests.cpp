@@ -0,0 +1,721 @@
+// Tests of the vault engine, run with ctest. Each test stops at its first failed CHECK and the
+// run fails if any test did.
+//
+//   vault_engine_tests [name substring]
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "byte_map.h"
+#include "crypto.h"
+#include "journal.h"
+#include "password_transform.h"
+#include "sealed_vault.h"
+#include "search.h"
+#include "transform_recipes.h"
+#include "vault.h"
+#include "vault_store.h"
+
+static bool currentFailed = false;
+
+#define CHECK(cond)                                                                       \
+    do {                                                                                  \
+        if (!(cond)) {                                                                    \
+            std::fprintf(stderr, "  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            currentFailed = true;                                                         \
+            return;                                                                       \
+        }                                                                                 \
+    } while (0)
+
+static const char TEST_PASSPHRASE[] = "test passphrase";
+// Enough to exercise PBKDF2 without making every test wait a second for it
+const uint32_t TEST_KDF_ITERATIONS = 1000;
+
+// An empty directory of its own for every test, since the store always uses the same file names
+static std::string testDirectory(const char* name) {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / (std::string("vault_engine_tests_") + name);
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    return directory.string();
+}
+
+static bool writeSealedStore(const std::string& directory, const Vault& vault) {
+    SealedKey key;
+    SealedVault sealed;
+    bool ok = deriveSealedKey(key, TEST_PASSPHRASE, TEST_KDF_ITERATIONS) &&
+              createSealedVault(sealed, storePaths(directory).save, key, vault, 0);
+    closeSealedVault(sealed);
+    return ok;
+}
+
+// Closes the store on the way out of a test, a CHECK that returns early included, since a store
+// destroyed with its writer thread still running aborts the whole run
+struct TestStore {
+    VaultStore store;
+    bool open = false;
+
+    OpenStoreResult openIn(const std::string& directory, std::string_view passphrase = TEST_PASSPHRASE,
+                           bool setAsideDamaged = false) {
+        OpenStoreResult result = openStore(store, passphrase, directory, setAsideDamaged);
+        open = result == OpenStoreResult::Opened || result == OpenStoreResult::OpenedWithoutJournal;
+        return result;
+    }
+
+    void close() {
+        if (open) closeStore(store);
+        open = false;
+    }
+
+    ~TestStore() { close(); }
+};
+
+static bool loadWholeStore(VaultStore& store) {
+    for (size_t i = 0; i < vaultServiceCount(store.vault); ++i) {
+        if (!storeLoadService(store, i)) return false;
+    }
+    return true;
+}
+
+// Edits the journal never took are still in memory and must reach save.vault on close
+static void testUnjournaledEditsAreSaved() {
+    std::string directory = testDirectory("unjournaled");
+    Vault empty;
+    CHECK(writeSealedStore(directory, empty));
+    {
+        TestStore edited;
+        CHECK(edited.openIn(directory) == OpenStoreResult::Opened);
+        closeJournal(edited.store.journal);
+        storeAddService(edited.store, "Mail");
+        storeAddAccount(edited.store, 0, "me@example.com", "hunter2");
+        storeAddService(edited.store, "Bank");
+    }
+    TestStore reopened;
+    CHECK(reopened.openIn(directory) == OpenStoreResult::Opened);
+    CHECK(loadWholeStore(reopened.store));
+    CHECK(vaultServiceCount(reopened.store.vault) == 2);
+    CHECK(vaultServiceLabel(reopened.store.vault, 1) == "Bank");
+    CHECK(vaultAccountPassword(reopened.store.vault, 0, 0) == "hunter2");
+}
+
+#ifdef __linux__
+// The same with a journal whose writes fail, like on a full disk
+static void testFullJournalEditsAreSaved() {
+    std::string directory = testDirectory("full_journal");
+    Vault empty;
+    CHECK(writeSealedStore(directory, empty));
+    {
+        TestStore edited;
+        CHECK(edited.openIn(directory) == OpenStoreResult::Opened);
+        Journal& journal = edited.store.journal;
+        uint64_t nextSeq = journal.nextSeq;
+        closeJournal(journal);
+        CHECK(openJournal(journal, "/dev/full", nextSeq, &edited.store.sealed.key.key, edited.store.sealed.header.fileId));
+        storeAddService(edited.store, "Mail");
+        CHECK(!journal.file);
+        storeAddService(edited.store, "Bank");
+    }
+    TestStore reopened;
+    CHECK(reopened.openIn(directory) == OpenStoreResult::Opened);
+    CHECK(loadWholeStore(reopened.store));
+    CHECK(vaultServiceCount(reopened.store.vault) == 2);
+    CHECK(vaultServiceLabel(reopened.store.vault, 0) == "Mail");
+}
+#endif
+
+// "d3 1a 8d" -> its bytes, so test vectors can be pasted the way the RFCs print them
+static std::vector<uint8_t> hexBytes(const char* hex) {
+    std::vector<uint8_t> bytes;
+    int high = -1;
+    for (const char* p = hex; *p; ++p) {
+        int nibble = *p >= '0' && *p <= '9' ? *p - '0' : *p >= 'a' && *p <= 'f' ? *p - 'a' + 10 : -1;
+        if (nibble < 0) continue;
+        if (high < 0) {
+            high = nibble;
+        } else {
+            bytes.push_back(static_cast<uint8_t>(high << 4 | nibble));
+            high = -1;
+        }
+    }
+    return bytes;
+}
+
+static std::vector<uint8_t> textBytes(const char* text) {
+    return std::vector<uint8_t>(text, text + std::strlen(text));
+}
+
+static void flipFileByte(const std::string& filename, uint64_t offset) {
+    std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(static_cast<std::streamoff>(offset));
+    char byte = 0;
+    file.get(byte);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.put(static_cast<char>(byte ^ 0x01));
+}
+
+// RFC 8439 section 2.8.2
+static void testAeadRfc8439() {
+    AeadKey key;
+    for (size_t i = 0; i < AEAD_KEY_SIZE; ++i) key.bytes[i] = static_cast<uint8_t>(0x80 + i);
+    std::vector<uint8_t> nonce = hexBytes("07 00 00 00 40 41 42 43 44 45 46 47");
+    std::vector<uint8_t> aad = hexBytes("50 51 52 53 c0 c1 c2 c3 c4 c5 c6 c7");
+    std::vector<uint8_t> data = textBytes("Ladies and Gentlemen of the class of '99: If I could offer you only one tip for "
+                                          "the future, sunscreen would be it.");
+    std::vector<uint8_t> plain = data;
+    std::vector<uint8_t> expected = hexBytes(
+        "d3 1a 8d 34 64 8e 60 db 7b 86 af bc 53 ef 7e c2 a4 ad ed 51 29 6e 08 fe a9 e2 b5 a7 36 ee 62 d6"
+        "3d be a4 5e 8c a9 67 12 82 fa fb 69 da 92 72 8b 1a 71 de 0a 9e 06 0b 29 05 d6 a5 b6 7e cd 3b 36"
+        "92 dd bd 7f 2d 77 8b 8c 98 03 ae e3 28 09 1b 58 fa b3 24 e4 fa d6 75 94 55 85 80 8b 48 31 d7 bc"
+        "3f f4 de f0 8e 4b 7a 9d e5 76 d2 65 86 ce c6 4b 61 16");
+    std::vector<uint8_t> expectedTag = hexBytes("1a e1 0b 59 4f 09 e2 6a 7e 90 2e cb d0 60 06 91");
+
+    uint8_t tag[AEAD_TAG_SIZE];
+    aeadSeal(key, nonce.data(), aad.data(), aad.size(), data.data(), data.size(), tag);
+    CHECK(data == expected);
+    CHECK(std::memcmp(tag, expectedTag.data(), AEAD_TAG_SIZE) == 0);
+    CHECK(aeadOpen(key, nonce.data(), aad.data(), aad.size(), data.data(), data.size(), tag));
+    CHECK(data == plain);
+}
+
+// One flipped bit anywhere the tag covers fails to open and leaves the data as it was
+static void testAeadRejectsTampering() {
+    AeadKey key;
+    CHECK(randomBytes(key.bytes, sizeof(key.bytes)));
+    uint8_t nonce[AEAD_NONCE_SIZE] = { 1, 2, 3 };
+    std::vector<uint8_t> aad = textBytes("CHNK header");
+    std::vector<uint8_t> plain = textBytes("me@example.com hunter2");
+    std::vector<uint8_t> sealed = plain;
+    uint8_t tag[AEAD_TAG_SIZE];
+    aeadSeal(key, nonce, aad.data(), aad.size(), sealed.data(), sealed.size(), tag);
+    CHECK(sealed != plain);
+
+    for (size_t i = 0; i < sealed.size(); ++i) {
+        std::vector<uint8_t> data = sealed;
+        data[i] ^= 0x01;
+        std::vector<uint8_t> before = data;
+        CHECK(!aeadOpen(key, nonce, aad.data(), aad.size(), data.data(), data.size(), tag));
+        CHECK(data == before);
+    }
+    for (size_t i = 0; i < AEAD_TAG_SIZE; ++i) {
+        uint8_t badTag[AEAD_TAG_SIZE];
+        std::memcpy(badTag, tag, sizeof(badTag));
+        badTag[i] ^= 0x80;
+        std::vector<uint8_t> data = sealed;
+        CHECK(!aeadOpen(key, nonce, aad.data(), aad.size(), data.data(), data.size(), badTag));
+    }
+    std::vector<uint8_t> badAad = aad;
+    badAad.back() ^= 0x01;
+    std::vector<uint8_t> data = sealed;
+    CHECK(!aeadOpen(key, nonce, badAad.data(), badAad.size(), data.data(), data.size(), tag));
+    AeadKey otherKey = key;
+    otherKey.bytes[0] ^= 0x01;
+    CHECK(!aeadOpen(otherKey, nonce, aad.data(), aad.size(), data.data(), data.size(), tag));
+    CHECK(aeadOpen(key, nonce, aad.data(), aad.size(), data.data(), data.size(), tag));
+    CHECK(data == plain);
+}
+
+// FIPS 180-2 examples and RFC 4231 test case 2
+static void testSha256AndHmac() {
+    uint8_t digest[SHA256_SIZE];
+    sha256("", 0, digest);
+    CHECK(std::vector<uint8_t>(digest, digest + SHA256_SIZE) ==
+          hexBytes("e3b0c442 98fc1c14 9afbf4c8 996fb924 27ae41e4 649b934c a495991b 7852b855"));
+    sha256("abc", 3, digest);
+    CHECK(std::vector<uint8_t>(digest, digest + SHA256_SIZE) ==
+          hexBytes("ba7816bf 8f01cfea 414140de 5dae2223 b00361a3 96177a9c b410ff61 f20015ad"));
+    const char* twoBlocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    sha256(twoBlocks, std::strlen(twoBlocks), digest);
+    CHECK(std::vector<uint8_t>(digest, digest + SHA256_SIZE) ==
+          hexBytes("248d6a61 d20638b8 e5c02693 0c3e6039 a33ce459 64ff2167 f6ecedd4 19db06c1"));
+
+    const char* data = "what do ya want for nothing?";
+    hmacSha256("Jefe", 4, data, std::strlen(data), digest);
+    CHECK(std::vector<uint8_t>(digest, digest + SHA256_SIZE) ==
+          hexBytes("5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"));
+}
+
+// RFC 7914 section 11
+static void testPbkdf2Rfc7914() {
+    uint8_t out[64];
+    pbkdf2Sha256("passwd", reinterpret_cast<const uint8_t*>("salt"), 4, 1, out, sizeof(out));
+    CHECK(std::vector<uint8_t>(out, out + sizeof(out)) == hexBytes(
+        "55 ac 04 6e 56 e3 08 9f ec 16 91 c2 25 44 b6 05 f9 41 85 21 6d de 04 65 e6 8b 9d 57 c2 0d ac bc"
+        "49 ca 9c cc f1 79 b6 45 99 16 64 b3 9d 77 ef 31 7c 71 b8 45 b1 e3 0b d5 09 11 20 41 d3 a1 97 83"));
+    pbkdf2Sha256("Password", reinterpret_cast<const uint8_t*>("NaCl"), 4, 80000, out, sizeof(out));
+    CHECK(std::vector<uint8_t>(out, out + sizeof(out)) == hexBytes(
+        "4d dc d8 f6 0b 98 be 21 83 0c ee 5e f2 27 01 f9 64 1a 44 18 d0 4c 04 14 ae ff 08 87 6b 34 ab 56"
+        "a1 d4 25 a1 22 58 33 54 9a db 84 1b 51 c9 b3 17 6a 27 2b de bb a1 d0 78 47 8f 62 b3 97 f3 3c 8d"));
+}
+
+// Enough services for several chunks, one of them too big for a single slot
+static void makeTestVault(Vault& vault) {
+    for (int i = 0; i < 400; ++i) {
+        vaultAddService(vault, "Service " + std::to_string(i));
+        vaultAddAccount(vault, i, "user" + std::to_string(i) + "@example.com", "password " + std::to_string(i * 7919));
+    }
+    for (int a = 0; a < 300; ++a) {
+        vaultAddAccount(vault, 123, "bulk" + std::to_string(a) + "@example.com", std::string(40, static_cast<char>('a' + a % 26)));
+    }
+}
+
+static bool sameVault(const Vault& a, const Vault& b) {
+    if (vaultServiceCount(a) != vaultServiceCount(b)) return false;
+    for (size_t i = 0; i < vaultServiceCount(a); ++i) {
+        if (vaultServiceLabel(a, i) != vaultServiceLabel(b, i) || vaultAccountCount(a, i) != vaultAccountCount(b, i)) return false;
+        for (size_t j = 0; j < vaultAccountCount(a, i); ++j) {
+            if (vaultAccountName(a, i, j) != vaultAccountName(b, i, j) ||
+                vaultAccountPassword(a, i, j) != vaultAccountPassword(b, i, j)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Everything written comes back, through a commit of edits and a reopen
+static void testSealedStoreRoundTrip() {
+    std::string directory = testDirectory("round_trip");
+    Vault expected;
+    makeTestVault(expected);
+    CHECK(writeSealedStore(directory, expected));
+    {
+        TestStore store;
+        CHECK(store.openIn(directory) == OpenStoreResult::Opened);
+        CHECK(store.store.chunks.size() > 1);
+        CHECK(loadWholeStore(store.store));
+        CHECK(sameVault(store.store.vault, expected));
+        storeAddAccount(store.store, 5, "new@example.com", "new password");
+        storeDeleteService(store.store, 300);
+        storeAddService(store.store, "Last");
+    }
+    vaultAddAccount(expected, 5, "new@example.com", "new password");
+    vaultDeleteService(expected, 300);
+    vaultAddService(expected, "Last");
+
+    TestStore reopened;
+    CHECK(reopened.openIn(directory) == OpenStoreResult::Opened);
+    CHECK(loadWholeStore(reopened.store));
+    CHECK(sameVault(reopened.store.vault, expected));
+}
+
+static void testWrongPassphrase() {
+    std::string directory = testDirectory("wrong_passphrase");
+    Vault vault;
+    makeTestVault(vault);
+    CHECK(writeSealedStore(directory, vault));
+    SealedVault sealed;
+    CHECK(openSealedVault(sealed, storePaths(directory).save, "not the passphrase") == SealedOpenResult::WrongPassphrase);
+    closeSealedVault(sealed);
+    TestStore store;
+    CHECK(store.openIn(directory, "not the passphrase") == OpenStoreResult::WrongPassphrase);
+}
+
+// A chunk altered on disk fails to authenticate instead of decrypting to garbage
+static void testTamperedChunkFails() {
+    std::string directory = testDirectory("tampered_chunk");
+    Vault vault;
+    makeTestVault(vault);
+    CHECK(writeSealedStore(directory, vault));
+    std::string filename = storePaths(directory).save;
+
+    SealedVault sealed;
+    CHECK(openSealedVault(sealed, filename, TEST_PASSPHRASE) == SealedOpenResult::Opened);
+    CHECK(sealed.chunks.size() > 1);
+    SealedChunkEntry chunk = sealed.chunks[1];
+    SecureVector<char> plain;
+    CHECK(readSealedChunk(sealed, chunk, plain));
+    closeSealedVault(sealed);
+
+    flipFileByte(filename, SEALED_SLOTS_OFFSET + static_cast<uint64_t>(chunk.firstSlot) * SEALED_SLOT_SIZE + 100);
+    CHECK(openSealedVault(sealed, filename, TEST_PASSPHRASE) == SealedOpenResult::Opened);
+    bool read = readSealedChunk(sealed, sealed.chunks[1], plain);
+    bool readOther = readSealedChunk(sealed, sealed.chunks[0], plain);
+    closeSealedVault(sealed);
+    CHECK(!read);
+    CHECK(readOther);
+}
+
+// A torn write of the newer root leaves the older one in charge; with both gone the vault is damaged
+static void testTornRootFallsBack() {
+    std::string directory = testDirectory("torn_root");
+    Vault vault;
+    makeTestVault(vault);
+    CHECK(writeSealedStore(directory, vault));
+    {
+        TestStore store;
+        CHECK(store.openIn(directory) == OpenStoreResult::Opened);
+        storeAddService(store.store, "Committed");
+    }
+    std::string filename = storePaths(directory).save;
+    SealedVault sealed;
+    CHECK(openSealedVault(sealed, filename, TEST_PASSPHRASE) == SealedOpenResult::Opened);
+    uint64_t generation = sealed.generation;
+    int root = sealed.root;
+    closeSealedVault(sealed);
+    CHECK(generation >= 2);
+
+    flipFileByte(filename, SEALED_ROOT_OFFSETS[root] + sizeof(uint64_t) + 2 * sizeof(uint32_t));
+    CHECK(openSealedVault(sealed, filename, TEST_PASSPHRASE) == SealedOpenResult::Opened);
+    uint64_t olderGeneration = sealed.generation;
+    int olderRoot = sealed.root;
+    closeSealedVault(sealed);
+    CHECK(olderGeneration == generation - 1);
+    CHECK(olderRoot == 1 - root);
+
+    flipFileByte(filename, SEALED_ROOT_OFFSETS[olderRoot] + sizeof(uint64_t) + 2 * sizeof(uint32_t));
+    CHECK(openSealedVault(sealed, filename, TEST_PASSPHRASE) == SealedOpenResult::Damaged);
+    closeSealedVault(sealed);
+}
+
+// A vault that fails to authenticate is only replaced once setting it aside was asked for, and
+// not at all when that rename fails
+static void testDamagedVaultIsKept() {
+    std::string directory = testDirectory("damaged_vault");
+    StorePaths paths = storePaths(directory);
+    Vault vault;
+    makeTestVault(vault);
+    CHECK(writeSealedStore(directory, vault));
+    for (uint64_t root : SEALED_ROOT_OFFSETS) {
+        flipFileByte(paths.save, root + sizeof(uint64_t) + 2 * sizeof(uint32_t));
+    }
+    std::ofstream(paths.journal) << "journal of the damaged vault";
+    {
+        TestStore store;
+        CHECK(store.openIn(directory) == OpenStoreResult::Damaged);
+    }
+    CHECK(isSealedVault(paths.save));
+    CHECK(!std::filesystem::exists(paths.corruptSave));
+    CHECK(std::filesystem::exists(paths.journal));
+
+    std::ofstream(paths.corruptSave) << "an earlier damaged vault";
+    {
+        TestStore store;
+        CHECK(store.openIn(directory, TEST_PASSPHRASE, true) == OpenStoreResult::Failed);
+    }
+    CHECK(isSealedVault(paths.save));
+
+    std::filesystem::remove(paths.corruptSave);
+    TestStore store;
+    CHECK(store.openIn(directory, TEST_PASSPHRASE, true) == OpenStoreResult::Opened);
+    CHECK(vaultServiceCount(store.store.vault) == 0);
+    CHECK(isSealedVault(paths.corruptSave));
+    CHECK(std::filesystem::exists(paths.journal + ".corrupt"));
+}
+
+// A vault this build can't read says nothing about its contents, so it is left alone
+static void testUnsupportedVaultFails() {
+    std::string directory = testDirectory("unsupported_vault");
+    StorePaths paths = storePaths(directory);
+    Vault vault;
+    makeTestVault(vault);
+    CHECK(writeSealedStore(directory, vault));
+    flipFileByte(paths.save, offsetof(SealedHeader, version));
+    {
+        TestStore store;
+        CHECK(store.openIn(directory) == OpenStoreResult::Failed);
+        CHECK(store.openIn(directory, TEST_PASSPHRASE, true) == OpenStoreResult::Failed);
+    }
+    CHECK(isSealedVault(paths.save));
+    CHECK(!std::filesystem::exists(paths.corruptSave));
+}
+
+// Replay applies the intact records and stops at a half-written last one, sealed or not
+static void replayTornJournal(bool sealedRecords) {
+    std::string directory = testDirectory(sealedRecords ? "torn_sealed_journal" : "torn_plain_journal");
+    std::string filename = directory + "/journal.bin";
+    AeadKey key;
+    CHECK(randomBytes(key.bytes, sizeof(key.bytes)));
+    uint8_t fileId[JOURNAL_FILE_ID_SIZE] = { 7 };
+    const AeadKey* journalKey = sealedRecords ? &key : nullptr;
+    const uint8_t* journalFileId = sealedRecords ? fileId : nullptr;
+
+    Journal journal;
+    CHECK(openJournal(journal, filename, 1, journalKey, journalFileId));
+    for (const char* label : { "Mail", "Bank", "Forum" }) {
+        JournalRecord record;
+        record.op = JOURNAL_ADD_SERVICE;
+        record.text1 = label;
+        CHECK(appendJournal(journal, record));
+    }
+    closeJournal(journal);
+    std::filesystem::resize_file(filename, std::filesystem::file_size(filename) - 3);
+
+    Vault vault;
+    uint64_t lastSeq = 0;
+    CHECK(replayJournal(filename, 0, vault, lastSeq, journalKey, journalFileId));
+    CHECK(lastSeq == 2);
+    CHECK(vaultServiceCount(vault) == 2);
+    CHECK(vaultServiceLabel(vault, 1) == "Bank");
+
+    // Records already folded into the vault are skipped
+    Vault newer;
+    lastSeq = 1;
+    CHECK(replayJournal(filename, 1, newer, lastSeq, journalKey, journalFileId));
+    CHECK(vaultServiceCount(newer) == 1);
+    CHECK(vaultServiceLabel(newer, 0) == "Bank");
+}
+
+static void testTornJournalTail() {
+    replayTornJournal(false);
+    if (currentFailed) return;
+    replayTornJournal(true);
+}
+
+// A sealed record opened with another vault's file id stops the replay like a torn one
+static void testJournalOfAnotherVault() {
+    std::string directory = testDirectory("foreign_journal");
+    std::string filename = directory + "/journal.bin";
+    AeadKey key;
+    CHECK(randomBytes(key.bytes, sizeof(key.bytes)));
+    uint8_t fileId[JOURNAL_FILE_ID_SIZE] = { 1 };
+    uint8_t otherFileId[JOURNAL_FILE_ID_SIZE] = { 2 };
+    Journal journal;
+    CHECK(openJournal(journal, filename, 1, &key, fileId));
+    JournalRecord record;
+    record.text1 = "Mail";
+    CHECK(appendJournal(journal, record));
+    closeJournal(journal);
+
+    Vault vault;
+    uint64_t lastSeq = 0;
+    CHECK(replayJournal(filename, 0, vault, lastSeq, &key, otherFileId));
+    CHECK(vaultServiceCount(vault) == 0);
+}
+
+static bool topResultIs(const SearchIndex& index, const char* query, size_t service) {
+    std::vector<SearchResult> results;
+    searchServices(index, query, results);
+    return !results.empty() && results[0].service == service;
+}
+
+// Swapped, missing and extra letters still find the service, even when no trigram survives them
+static void testSearchFindsTypos() {
+    Vault vault;
+    for (const char* label : { "Bank", "Mail", "Github", "Forum" }) {
+        vaultAddService(vault, label);
+    }
+    vaultAddAccount(vault, 0, "savings@example.com", "pw");
+    SearchIndex index;
+    buildSearchIndex(index, vault);
+    CHECK(topResultIs(index, "mial", 1));
+    CHECK(topResultIs(index, "mil", 1));
+    CHECK(topResultIs(index, "maill", 1));
+    CHECK(topResultIs(index, "githbu", 2));
+    CHECK(topResultIs(index, "savnigs", 0));
+    std::vector<SearchResult> results;
+    searchServices(index, "qqqq", results);
+    CHECK(results.empty());
+}
+
+// One and two character queries fall back to matching inside words when too few words start with them
+static void testSearchFindsShortSubstrings() {
+    Vault vault;
+    for (const char* label : { "Bank", "Gmail", "Forum", "Shop" }) {
+        vaultAddService(vault, label);
+    }
+    vaultAddAccount(vault, 2, "admin", "pw");
+    SearchIndex index;
+    buildSearchIndex(index, vault);
+    CHECK(topResultIs(index, "ma", 1));
+    CHECK(topResultIs(index, "mi", 2));
+    // An edited service's text moves to the end of the pool, out of order with its neighbours
+    vaultSetServiceLabel(vault, 0, "Hotmail");
+    searchUpdateService(index, vault, 0);
+    std::vector<SearchResult> results;
+    searchServices(index, "ma", results);
+    CHECK(results.size() == 2);
+    searchServices(index, "ho", results);
+    CHECK(results.size() == 2);
+    CHECK(results[0].service == 0 && results[1].service == 3);
+    CHECK(topResultIs(index, "tm", 0));
+    searchServices(index, "zq", results);
+    CHECK(results.empty());
+}
+
+// Once there are more label matches than results, the earliest are returned ahead of account matches
+static void testSearchRanksLabelPrefixesFirst() {
+    Vault vault;
+    vaultAddService(vault, "Forum");
+    vaultAddAccount(vault, 0, "mail@example.com", "pw");
+    for (int i = 0; i < 5000; ++i) {
+        vaultAddService(vault, "Mail-" + std::to_string(i));
+    }
+    SearchIndex index;
+    buildSearchIndex(index, vault);
+    for (std::string query : { "m", "ma", "mail", "mail-1" }) {
+        std::vector<SearchResult> results;
+        searchServices(index, query, results, 10);
+        CHECK(results.size() == 10);
+        for (size_t i = 0; i < results.size(); ++i) {
+            std::string label(vaultServiceLabel(vault, results[i].service));
+            label[0] = 'm';
+            CHECK(label.compare(0, query.size(), query) == 0);
+            CHECK(i == 0 || results[i - 1].service < results[i].service);
+        }
+    }
+    CHECK(topResultIs(index, "mail-1", 2));
+}
+
+static size_t serviceLabeled(const Vault& vault, std::string_view label) {
+    for (size_t i = 0; i < vaultServiceCount(vault); ++i) {
+        if (vaultServiceLabel(vault, i) == label) return i;
+    }
+    return SIZE_MAX;
+}
+
+// Deleting services renumbers the ones after them without touching their documents
+static void testSearchFollowsRemovals() {
+    Vault vault;
+    for (int i = 0; i < 300; ++i) {
+        vaultAddService(vault, "svc" + std::to_string(i));
+    }
+    SearchIndex index;
+    buildSearchIndex(index, vault);
+    for (size_t service : { 250, 100, 0, 7, 7, 7 }) {
+        vaultDeleteService(vault, service);
+        searchRemoveService(index, service);
+    }
+    vaultSetServiceLabel(vault, 10, "renamed");
+    searchUpdateService(index, vault, 10);
+    vaultAddService(vault, "svc-new");
+    searchAddService(index, vault, vaultServiceCount(vault) - 1);
+
+    for (const char* query : { "svc1", "svc25", "svc-new", "renamed", "s" }) {
+        std::vector<SearchResult> results;
+        searchServices(index, query, results);
+        CHECK(!results.empty());
+        for (const SearchResult& result : results) {
+            CHECK(result.service < vaultServiceCount(vault));
+            CHECK(fuzzyScore(vaultServiceLabel(vault, result.service), query) >= 0);
+        }
+    }
+    CHECK(serviceLabeled(vault, "svc9") == SIZE_MAX);
+    CHECK(topResultIs(index, "svc11", serviceLabeled(vault, "svc11")));
+    CHECK(topResultIs(index, "svc299", serviceLabeled(vault, "svc299")));
+    CHECK(topResultIs(index, "svc-new", vaultServiceCount(vault) - 1));
+    CHECK(topResultIs(index, "renamed", 10));
+}
+
+// Every kernel the CPU has must agree with the scalar loop, on full tables, on tables that leave
+// most rows alone, and on every tail length past the last whole vector
+static void testByteMapKernelsAgree() {
+    std::mt19937 random(2024);
+    std::vector<std::vector<uint8_t>> tables(2, std::vector<uint8_t>(256));
+    for (size_t i = 0; i < 256; ++i) {
+        tables[0][i] = static_cast<uint8_t>(random());
+        tables[1][i] = static_cast<uint8_t>(i);
+    }
+    for (int i = 0; i < 5; ++i) {
+        tables[1][random() % 256] = static_cast<uint8_t>(random());
+    }
+    std::vector<char> input(1001);
+    for (char& c : input) c = static_cast<char>(random());
+
+    ByteMapKernel selected = byteMapKernel();
+    bool agree = true;
+    for (ByteMapKernel kernel : { ByteMapKernel::Ssse3, ByteMapKernel::Avx2, ByteMapKernel::Avx512Vbmi }) {
+        if (!byteMapKernelSupported(kernel)) continue;
+        for (const std::vector<uint8_t>& table : tables) {
+            for (size_t length = 0; length < 1000 && agree; ++length) {
+                // Starting one byte in, so the vector loads aren't aligned either
+                std::vector<char> expected(input.begin() + 1, input.begin() + 1 + length);
+                std::vector<char> actual(input.begin(), input.begin() + 1 + length);
+                setByteMapKernel(ByteMapKernel::Scalar);
+                mapBytes(table.data(), expected.data(), length);
+                setByteMapKernel(kernel);
+                mapBytes(table.data(), actual.data() + 1, length);
+                agree = std::equal(expected.begin(), expected.end(), actual.begin() + 1) && actual[0] == input[0];
+                if (!agree) {
+                    std::fprintf(stderr, "  %s differs from scalar at length %zu\n", byteMapKernelName(kernel), length);
+                }
+            }
+        }
+    }
+    setByteMapKernel(selected);
+    CHECK(agree);
+}
+
+// Each known recipe's specialized code must give what the interpreter gives for the same steps
+static void testRecipesMatchInterpreter() {
+    std::mt19937 random(7);
+    std::vector<std::string> passwords(200);
+    for (size_t i = 0; i < passwords.size(); ++i) {
+        passwords[i].resize(i % 40);
+        for (char& c : passwords[i]) {
+            // Mostly printable, like real passwords, with the odd byte the mix tables leave alone
+            c = static_cast<char>(random() % 8 == 0 ? random() : PRINTABLE_FIRST + random() % (PRINTABLE_LAST - PRINTABLE_FIRST + 1));
+        }
+    }
+    for (size_t r = 0; r < knownRecipeCount(); ++r) {
+        const KnownRecipe& recipe = knownRecipe(r);
+        TransformProgram program;
+        std::string error;
+        CHECK(compileTransform(program, std::string("recipe ") + recipe.name, error));
+        CHECK(program.specialized != nullptr);
+        const SpecializedTransform* specialized = program.specialized;
+        SecureString expected;
+        SecureString actual;
+        for (const std::string& password : passwords) {
+            program.specialized = nullptr;
+            transformPassword(program, password, expected);
+            program.specialized = specialized;
+            transformPassword(program, password, actual);
+            if (expected != actual) {
+                std::fprintf(stderr, "  recipe %s differs for a password of %zu bytes\n", recipe.name, password.size());
+            }
+            CHECK(expected == actual);
+        }
+    }
+}
+
+struct TestCase {
+    const char* name;
+    std::function<void()> run;
+};
+
+int main(int argc, char** argv) {
+    std::vector<TestCase> tests = {
+        { "AeadRfc8439", testAeadRfc8439 },
+        { "AeadRejectsTampering", testAeadRejectsTampering },
+        { "Sha256AndHmac", testSha256AndHmac },
+        { "Pbkdf2Rfc7914", testPbkdf2Rfc7914 },
+        { "SealedStoreRoundTrip", testSealedStoreRoundTrip },
+        { "WrongPassphrase", testWrongPassphrase },
+        { "TamperedChunkFails", testTamperedChunkFails },
+        { "TornRootFallsBack", testTornRootFallsBack },
+        { "DamagedVaultIsKept", testDamagedVaultIsKept },
+        { "UnsupportedVaultFails", testUnsupportedVaultFails },
+        { "TornJournalTail", testTornJournalTail },
+        { "JournalOfAnotherVault", testJournalOfAnotherVault },
+        { "UnjournaledEditsAreSaved", testUnjournaledEditsAreSaved },
+        { "SearchFindsTypos", testSearchFindsTypos },
+        { "SearchFindsShortSubstrings", testSearchFindsShortSubstrings },
+        { "SearchRanksLabelPrefixesFirst", testSearchRanksLabelPrefixesFirst },
+        { "SearchFollowsRemovals", testSearchFollowsRemovals },
+        { "ByteMapKernelsAgree", testByteMapKernelsAgree },
+        { "RecipesMatchInterpreter", testRecipesMatchInterpreter },
+#ifdef __linux__
+        { "FullJournalEditsAreSaved", testFullJournalEditsAreSaved },
+#endif
+    };
+
+    int failed = 0;
+    int ran = 0;
+    for (const TestCase& test : tests) {
+        if (argc > 1 && !std::strstr(test.name, argv[1])) continue;
+        currentFailed = false;
+        test.run();
+        ++ran;
+        std::printf("%s %s\n", currentFailed ? "FAIL" : "ok  ", test.name);
+        failed += currentFailed ? 1 : 0;
+    }
+    std::printf("%d of %d tests failed\n", failed, ran);
+    return failed == 0 ? 0 : 1;
+}